@@ -0,0 +1,128 @@
+#pragma once
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+/**
+ * @brief Online convergence diagnostics of one Markov chain by the method of batch means. The draws are grouped into consecutive batches whose sums are kept; once max_batches batches are full,
+ * neighbouring batches are merged and the batch size doubles, so between max_batches / 2 and max_batches batches are always held in a fixed amount of memory and each draw costs O(num_params).
+ * The variance of the batch means, times the batch size, estimates the asymptotic variance of the chain mean. Divided by the variance of the draws it gives the integrated autocorrelation time tau,
+ * from which the effective sample size is n / tau and the Monte Carlo standard error of the mean sqrt(asymptotic variance / n). Every member is a plain value so the state can be checkpointed raw.
+ *
+ * @tparam REAL: type representing real numbers; usually float or double.
+ * @tparam num_params: number of parameters that are being used to fit the model.
+*/
+template<typename REAL, std::size_t num_params>
+class BatchMeans
+{
+public:
+    static constexpr std::size_t max_batches = 64;
+
+    void add(const std::array<REAL, num_params> &params){
+        count++;
+        for (std::size_t i = 0; i < num_params; i++){
+            double delta = params[i] - mean[i];
+            mean[i] += delta / count;
+            sum_squares[i] += delta * (params[i] - mean[i]);
+            current_sum[i] += params[i];
+        }
+        if (++current_count < batch_size){
+            return;
+        }
+        batch_sums[num_batches++] = current_sum;
+        current_sum = {};
+        current_count = 0;
+        if (num_batches == max_batches){
+            for (std::size_t b = 0; b < max_batches / 2; b++){
+                for (std::size_t i = 0; i < num_params; i++){
+                    batch_sums[b][i] = batch_sums[2 * b][i] + batch_sums[2 * b + 1][i];
+                }
+            }
+            num_batches = max_batches / 2;
+            batch_size *= 2;
+        }
+    }
+
+    /**
+     * @brief: true once batches have been merged at least once, so that there are enough batches, each at least two draws long, for the estimates to mean something.
+    */
+    bool ready() const {
+        return batch_size > 1;
+    }
+    std::uint64_t get_count() const {
+        return count;
+    }
+
+    /**
+     * @brief: Integrated autocorrelation time of every parameter, 1 for independent draws. A parameter whose draws never change, e.g. in a stuck chain, has an infinite time and so an effective
+     * sample size of 0.
+    */
+    std::array<REAL, num_params> autocorrelation_times() const {
+        std::array<REAL, num_params> times{};
+        std::array<double, num_params> variance = asymptotic_variances();
+        for (std::size_t i = 0; i < num_params; i++){
+            double draw_variance = count > 1 ? sum_squares[i] / (count - 1) : 0;
+            if (draw_variance > 0){
+                times[i] = static_cast<REAL>(variance[i] / draw_variance);
+            }
+            else{
+                times[i] = count > 1 ? std::numeric_limits<REAL>::infinity() : 1;
+            }
+        }
+        return times;
+    }
+
+    std::array<REAL, num_params> effective_sample_sizes() const {
+        std::array<REAL, num_params> sizes = autocorrelation_times();
+        for (std::size_t i = 0; i < num_params; i++){
+            sizes[i] = count / sizes[i];
+        }
+        return sizes;
+    }
+
+    /**
+     * @brief: Monte Carlo standard error of the chain mean of every parameter.
+    */
+    std::array<REAL, num_params> standard_errors() const {
+        std::array<REAL, num_params> errors{};
+        std::array<double, num_params> variance = asymptotic_variances();
+        for (std::size_t i = 0; i < num_params; i++){
+            errors[i] = static_cast<REAL>(count > 0 ? std::sqrt(variance[i] / count) : 0);
+        }
+        return errors;
+    }
+
+private:
+    std::uint64_t count = 0;
+    std::array<double, num_params> mean{};
+    std::array<double, num_params> sum_squares{};
+    std::uint64_t batch_size = 1;
+    std::uint64_t current_count = 0;
+    std::array<double, num_params> current_sum{};
+    std::size_t num_batches = 0;
+    std::array<std::array<double, num_params>, max_batches> batch_sums{};
+
+    /**
+     * @brief: Batch size times the sample variance of the batch means, for every parameter.
+    */
+    std::array<double, num_params> asymptotic_variances() const {
+        std::array<double, num_params> variance{};
+        if (num_batches < 2){
+            return variance;
+        }
+        for (std::size_t i = 0; i < num_params; i++){
+            double batch_mean = 0;
+            for (std::size_t b = 0; b < num_batches; b++){
+                batch_mean += batch_sums[b][i] / batch_size / num_batches;
+            }
+            double spread = 0;
+            for (std::size_t b = 0; b < num_batches; b++){
+                double deviation = batch_sums[b][i] / batch_size - batch_mean;
+                spread += deviation * deviation;
+            }
+            variance[i] = batch_size * spread / (num_batches - 1);
+        }
+        return variance;
+    }
+};
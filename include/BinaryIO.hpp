@@ -0,0 +1,90 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <fstream>
+#include <functional>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+
+/**
+ * @brief Helpers for the binary result and checkpoint files written by the samplers. Values are stored in native byte order, so the files are meant to be read back on the same kind of machine.
+*/
+namespace binary_io{
+    template<typename T>
+    void write_value(std::ostream &file, const T &value){
+        file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template<typename T>
+    T read_value(std::istream &file){
+        T value{};
+        file.read(reinterpret_cast<char*>(&value), sizeof(T));
+        return value;
+    }
+
+    /**
+     * @brief: Writes the elements of a vector without its size, which the reader must already know.
+    */
+    template<typename T>
+    void write_values(std::ostream &file, const std::vector<T> &values){
+        file.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+    }
+
+    /**
+     * @brief: Reads values.size() elements into values.
+    */
+    template<typename T>
+    void read_values(std::istream &file, std::vector<T> &values){
+        file.read(reinterpret_cast<char*>(values.data()), values.size() * sizeof(T));
+    }
+
+    inline void write_string(std::ostream &file, const std::string &text){
+        write_value<std::uint64_t>(file, text.size());
+        file.write(text.data(), text.size());
+    }
+
+    inline std::string read_string(std::istream &file){
+        std::uint64_t length = read_value<std::uint64_t>(file);
+        if (!file || length > (std::uint64_t(1) << 32)){
+            throw std::runtime_error("Error - Corrupt string length in binary file.");
+        }
+        std::string text(length, '\0');
+        file.read(&text[0], length);
+        return text;
+    }
+
+    /**
+     * @brief: 64 bit FNV-1a hash of text, the same on every run and build, for recording in a file header which model or setting it was written with.
+    */
+    inline std::uint64_t hash_string(const std::string &text){
+        std::uint64_t hash = 14695981039346656037ull;
+        for (char c: text){
+            hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+        }
+        return hash;
+    }
+
+    /**
+     * @brief Writes a file through write_func to filepath + ".tmp" and renames it over filepath once complete, so a process stopped part way through never leaves a truncated file behind.
+     * @param filepath: File to create or replace.
+     * @param write_func: Writes the contents to the stream it is given.
+    */
+    inline void write_file_atomically(const std::string &filepath, const std::function<void(std::ofstream&)> &write_func){
+        std::string temporary_path = filepath + ".tmp";
+        {
+            std::ofstream file(temporary_path, std::ios::binary | std::ios::trunc);
+            if (!file){
+                throw std::runtime_error("Unable to open file for writing: " + temporary_path);
+            }
+            write_func(file);
+            file.flush();
+            if (!file){
+                throw std::runtime_error("Unable to write file: " + temporary_path);
+            }
+        }
+        if (std::rename(temporary_path.c_str(), filepath.c_str()) != 0){
+            throw std::runtime_error("Unable to replace file: " + filepath);
+        }
+    }
+}
@@ -0,0 +1,475 @@
+#pragma once
+#include <array>
+#include <vector>
+#include <string>
+#include <cmath>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+/**
+ * @brief Model function given as text at run time, e.g. "a*x^b + c", parsed once into a register based bytecode program. Names are x, the parameter names and the functions exp, log and sqrt,
+ * with + - * / ^, unary minus and brackets; ^ binds tightest and is right associative. Everything that does not depend on x is computed once per parameter vector into scalar slots, whole
+ * number powers up to 16 become multiplications, and the instructions left run over blocks of block_rows observations at a time, so the cost of interpreting an instruction is shared by the
+ * block and the arithmetic of every instruction is a simple loop the compiler vectorises.
+ * A single observation can also be evaluated with any number type, REAL, Interval or Dual, so the same model serves as the model function, interval model and gradient model of a sampler.
+ *
+ * @tparam REAL: type representing real numbers; usually float or double.
+ * @tparam num_params: number of parameters that are being used to fit the model.
+*/
+template<typename REAL, std::size_t num_params>
+class BytecodeModel
+{
+    public:
+    /**
+     * @brief Constructor that parses and compiles the expression.
+     * @param expression: Text of the model, e.g. "a*x^3 + b*x^2 + c*x + d".
+     * @param names: Name of every parameter as used in the expression.
+    */
+    BytecodeModel(const std::string &expression, const std::array<std::string, num_params> &names) : expression(expression), names(names){
+        slot_values.assign(num_params, 0);
+        constant_slots.assign(num_params, false);
+        position = 0;
+        result = parse_sum();
+        skip_spaces();
+        if (position != expression.size()){
+            throw_parse_error("Unexpected '" + std::string(1, expression[position]) + "'");
+        }
+        if (slot_values.size() > max_slots || num_registers > max_registers){
+            throw std::domain_error("Error - The model expression is too long.");
+        }
+    }
+
+    /**
+     * @brief The model at one parameter vector with everything independent of x already computed, so that evaluating an observation only runs the block program. Made by prepare and
+     * valid while the model is.
+     * @tparam T: number type of the parameters and observations, REAL, Interval or Dual.
+    */
+    template<typename T>
+    class Prepared;
+
+    /**
+     * @brief: Runs the scalar program once for the parameter vector. Loops over observations at a fixed parameter vector, such as the interval bound of a box or the gradient of the log
+     * likelihood, use this rather than operator(), which runs the scalar program again for every observation.
+    */
+    template<typename T>
+    Prepared<T> prepare(const std::array<T, num_params> &params) const {
+        Prepared<T> prepared;
+        prepared.model = this;
+        compute_slots(params, prepared.slots);
+        return prepared;
+    }
+
+    /**
+     * @brief: Model output for one observation, with every value of type T.
+    */
+    template<typename T>
+    T operator()(T x, const std::array<T, num_params> &params) const {
+        return prepare(params)(x);
+    }
+
+    /**
+     * @brief: Model outputs for count observations, block_rows at a time. Matches operator() for every observation.
+     * @param inputs: Independent variable of every observation.
+     * @param outputs: Set to the model output of every observation.
+    */
+    void evaluate(const std::array<REAL, num_params> &params, const REAL *inputs, REAL *outputs, std::size_t count) const {
+        std::array<REAL, max_slots> slots;
+        compute_slots(params, slots);
+        std::array<REAL, max_registers * block_rows> registers; // left uninitialised, every register is written before it is read
+        for (std::size_t start = 0; start < count; start += block_rows){
+            std::size_t rows = std::min(block_rows, count - start);
+            auto source = [&](const Operand &operand){
+                return operand.kind == OperandKind::input ? Source{inputs + start, 0} : operand.kind == OperandKind::scalar ? Source{nullptr, slots[operand.index]}
+                                                                                                                               : Source{registers.data() + operand.index * block_rows, 0};
+            };
+            for (const Instruction &instruction: block_program){
+                run_block(instruction.op, registers.data() + instruction.destination * block_rows, source(instruction.left), source(instruction.right), rows);
+            }
+            Source output = source(result);
+            if (output.values){
+                std::memcpy(outputs + start, output.values, rows * sizeof(REAL));
+            }
+            else{
+                std::fill(outputs + start, outputs + start + rows, output.scalar);
+            }
+        }
+    }
+
+    const std::string& get_expression() const {
+        return expression;
+    }
+    /**
+     * @brief: Number of instructions run for every block of observations, after everything independent of x has been moved out.
+    */
+    std::size_t get_num_block_instructions() const {
+        return block_program.size();
+    }
+    /**
+     * @brief: Whether the expression uses the parameter. A parameter it does not use keeps a flat marginal distribution.
+    */
+    bool uses_param(std::size_t param_idx) const {
+        return used_params[param_idx];
+    }
+
+    private:
+    static constexpr std::size_t block_rows = 256; // a register holds 2 kB in double, so the registers of a typical model stay in the L1 cache
+    static constexpr std::size_t max_slots = 64;
+    static constexpr std::size_t max_registers = 16;
+    static constexpr int max_integer_power = 16;
+
+    enum class OpCode : std::uint8_t{
+        add, subtract, multiply, divide, negate, square, power, exp, log, sqrt
+    };
+    enum class OperandKind : std::uint8_t{
+        input, // the observation's x
+        scalar, // a parameter, constant or value computed from them, the same for every observation
+        block // a register holding one value per observation of the block
+    };
+    struct Operand{
+        OperandKind kind;
+        std::uint16_t index;
+    };
+    /**
+     * @brief: destination = left op right, unary operations ignore right. Scalar instructions write to a slot and block instructions to a register.
+    */
+    struct Instruction{
+        OpCode op;
+        std::uint16_t destination;
+        Operand left;
+        Operand right;
+    };
+    struct Source{
+        const REAL *values; // nullptr for a scalar
+        REAL scalar;
+    };
+
+    std::string expression;
+    std::array<std::string, num_params> names;
+    std::array<bool, num_params> used_params{};
+    std::vector<REAL> slot_values; // parameters, then constants and scalar temporaries
+    std::vector<bool> constant_slots;
+    std::vector<Instruction> scalar_program;
+    std::vector<Instruction> block_program;
+    std::vector<std::uint16_t> free_registers;
+    std::size_t num_registers = 0;
+    Operand result;
+    std::size_t position;
+
+    /**
+     * @brief: Fills the parameter and constant slots and runs the scalar program, leaving every value that does not depend on x in slots.
+    */
+    template<typename T>
+    void compute_slots(const std::array<T, num_params> &params, std::array<T, max_slots> &slots) const {
+        for (std::size_t s = 0; s < slot_values.size(); s++){
+            slots[s] = s < num_params ? params[s] : T(slot_values[s]);
+        }
+        for (const Instruction &instruction: scalar_program){
+            slots[instruction.destination] = apply(instruction.op, slots[instruction.left.index], slots[instruction.right.index]);
+        }
+    }
+
+    // pow, exp, log and sqrt are called unqualified so that argument dependent lookup picks up the overloads of non built in REAL types such as Interval and Dual.
+    template<typename T>
+    static T apply(OpCode op, const T &left, const T &right){
+        using std::pow;
+        using std::exp;
+        using std::log;
+        using std::sqrt;
+        switch (op){
+            case OpCode::add: return left + right;
+            case OpCode::subtract: return left - right;
+            case OpCode::multiply: return left * right;
+            case OpCode::divide: return left / right;
+            case OpCode::negate: return -left;
+            case OpCode::square: return left * left;
+            case OpCode::power: return pow(left, right);
+            case OpCode::exp: return exp(left);
+            case OpCode::log: return log(left);
+            case OpCode::sqrt: return sqrt(left);
+        }
+        return left;
+    }
+
+    /**
+     * @brief: Runs one instruction over a block. Every operation has its own loop so the arithmetic ones vectorise. At most one operand is a scalar as scalar only work is done beforehand.
+    */
+    static void run_block(OpCode op, REAL *destination, const Source &left, const Source &right, std::size_t rows){
+        switch (op){
+            case OpCode::add: return binary_loop(destination, left, right, rows, [](REAL a, REAL b){ return a + b; });
+            case OpCode::subtract: return binary_loop(destination, left, right, rows, [](REAL a, REAL b){ return a - b; });
+            case OpCode::multiply: return binary_loop(destination, left, right, rows, [](REAL a, REAL b){ return a * b; });
+            case OpCode::divide: return binary_loop(destination, left, right, rows, [](REAL a, REAL b){ return a / b; });
+            case OpCode::power: return binary_loop(destination, left, right, rows, [](REAL a, REAL b){ return std::pow(a, b); });
+            case OpCode::negate: return unary_loop(destination, left, rows, [](REAL a){ return -a; });
+            case OpCode::square: return unary_loop(destination, left, rows, [](REAL a){ return a * a; });
+            case OpCode::exp: return unary_loop(destination, left, rows, [](REAL a){ return std::exp(a); });
+            case OpCode::log: return unary_loop(destination, left, rows, [](REAL a){ return std::log(a); });
+            case OpCode::sqrt: return unary_loop(destination, left, rows, [](REAL a){ return std::sqrt(a); });
+        }
+    }
+
+    template<typename Function>
+    static void binary_loop(REAL *destination, const Source &left, const Source &right, std::size_t rows, Function function){
+        if (!left.values){
+            for (std::size_t i = 0; i < rows; i++){
+                destination[i] = function(left.scalar, right.values[i]);
+            }
+        }
+        else if (!right.values){
+            for (std::size_t i = 0; i < rows; i++){
+                destination[i] = function(left.values[i], right.scalar);
+            }
+        }
+        else{
+            for (std::size_t i = 0; i < rows; i++){
+                destination[i] = function(left.values[i], right.values[i]);
+            }
+        }
+    }
+
+    template<typename Function>
+    static void unary_loop(REAL *destination, const Source &operand, std::size_t rows, Function function){
+        for (std::size_t i = 0; i < rows; i++){
+            destination[i] = function(operand.values[i]);
+        }
+    }
+
+    [[noreturn]] void throw_parse_error(const std::string &message) const {
+        throw std::domain_error("Error - " + message + " at position " + std::to_string(position + 1) + " of the model expression \"" + expression + "\".");
+    }
+
+    void skip_spaces(){
+        while (position < expression.size() && std::isspace(static_cast<unsigned char>(expression[position]))){
+            position++;
+        }
+    }
+
+    bool accept(char symbol){
+        skip_spaces();
+        if (position < expression.size() && expression[position] == symbol){
+            position++;
+            return true;
+        }
+        return false;
+    }
+
+    Operand constant(REAL value){
+        slot_values.push_back(value);
+        constant_slots.push_back(true);
+        return {OperandKind::scalar, static_cast<std::uint16_t>(slot_values.size() - 1)};
+    }
+
+    bool is_constant(const Operand &operand) const {
+        return operand.kind == OperandKind::scalar && constant_slots[operand.index];
+    }
+
+    void release(const Operand &operand){
+        if (operand.kind == OperandKind::block){
+            free_registers.push_back(operand.index);
+        }
+    }
+
+    /**
+     * @brief: Emits left op right. Constants are folded, scalar operands give a scalar instruction and anything depending on x a block instruction, into a register freed by the operands if
+     * they are done with.
+    */
+    Operand emit(OpCode op, Operand left, Operand right, bool release_left = true, bool release_right = true){
+        bool unary = op == OpCode::negate || op == OpCode::square || op == OpCode::exp || op == OpCode::log || op == OpCode::sqrt;
+        if (is_constant(left) && (unary || is_constant(right))){
+            return constant(apply(op, slot_values[left.index], slot_values[right.index]));
+        }
+        if (left.kind == OperandKind::scalar && (unary || right.kind == OperandKind::scalar)){
+            slot_values.push_back(0);
+            constant_slots.push_back(false);
+            Operand destination{OperandKind::scalar, static_cast<std::uint16_t>(slot_values.size() - 1)};
+            scalar_program.push_back({op, destination.index, left, unary ? left : right});
+            return destination;
+        }
+        std::uint16_t destination; // taken before the operands are freed, so no instruction writes over its own operands and the loops need no overlap checks
+        if (free_registers.empty()){
+            destination = static_cast<std::uint16_t>(num_registers++);
+        }
+        else{
+            destination = free_registers.back();
+            free_registers.pop_back();
+        }
+        if (release_left){
+            release(left);
+        }
+        if (release_right && !unary){
+            release(right);
+        }
+        block_program.push_back({op, destination, left, unary ? left : right});
+        return {OperandKind::block, destination};
+    }
+
+    /**
+     * @brief: base^exponent for a whole number exponent, by squaring and multiplying from the highest bit down.
+    */
+    Operand integer_power(Operand base, int exponent){
+        if (exponent == 1){
+            return base;
+        }
+        int bit = 1;
+        while (2 * bit <= exponent){
+            bit *= 2;
+        }
+        Operand power = base;
+        bool owns_power = false; // base is kept until the last multiplication
+        for (bit /= 2; bit > 0; bit /= 2){
+            power = emit(OpCode::square, power, power, owns_power);
+            owns_power = true;
+            if (exponent & bit){
+                power = emit(OpCode::multiply, power, base, true, false);
+            }
+        }
+        release(base);
+        return power;
+    }
+
+    Operand parse_sum(){
+        Operand left = parse_product();
+        while (true){
+            if (accept('+')){
+                left = emit(OpCode::add, left, parse_product());
+            }
+            else if (accept('-')){
+                left = emit(OpCode::subtract, left, parse_product());
+            }
+            else{
+                return left;
+            }
+        }
+    }
+
+    Operand parse_product(){
+        Operand left = parse_unary();
+        while (true){
+            if (accept('*')){
+                left = emit(OpCode::multiply, left, parse_unary());
+            }
+            else if (accept('/')){
+                left = emit(OpCode::divide, left, parse_unary());
+            }
+            else{
+                return left;
+            }
+        }
+    }
+
+    Operand parse_unary(){
+        if (accept('-')){
+            Operand operand = parse_unary();
+            return emit(OpCode::negate, operand, operand);
+        }
+        accept('+');
+        return parse_power();
+    }
+
+    Operand parse_power(){
+        Operand base = parse_primary();
+        if (!accept('^')){
+            return base;
+        }
+        Operand exponent = parse_unary(); // right associative, and -x^2 is -(x^2) while x^-2 is allowed
+        if (is_constant(exponent)){
+            REAL value = slot_values[exponent.index];
+            if (value >= 1 && value <= max_integer_power && value == std::floor(value)){
+                return integer_power(base, static_cast<int>(value));
+            }
+        }
+        return emit(OpCode::power, base, exponent);
+    }
+
+    Operand parse_primary(){
+        skip_spaces();
+        if (position >= expression.size()){
+            throw_parse_error("Missing value");
+        }
+        if (accept('(')){
+            Operand inner = parse_sum();
+            if (!accept(')')){
+                throw_parse_error("Missing )");
+            }
+            return inner;
+        }
+        const char *start = expression.c_str() + position;
+        if (std::isdigit(static_cast<unsigned char>(*start)) || *start == '.'){
+            char *end;
+            double value = std::strtod(start, &end);
+            if (end == start){
+                throw_parse_error("Invalid number");
+            }
+            position += end - start;
+            return constant(static_cast<REAL>(value));
+        }
+        if (!std::isalpha(static_cast<unsigned char>(*start)) && *start != '_'){
+            throw_parse_error("Unexpected '" + std::string(1, *start) + "'");
+        }
+        std::size_t name_start = position;
+        while (position < expression.size() && (std::isalnum(static_cast<unsigned char>(expression[position])) || expression[position] == '_')){
+            position++;
+        }
+        std::string name = expression.substr(name_start, position - name_start);
+        for (std::size_t j = 0; j < num_params; j++){
+            if (name == names[j]){
+                used_params[j] = true;
+                return {OperandKind::scalar, static_cast<std::uint16_t>(j)};
+            }
+        }
+        if (name == "x"){
+            return {OperandKind::input, 0};
+        }
+        OpCode function;
+        if (name == "exp"){
+            function = OpCode::exp;
+        }
+        else if (name == "log"){
+            function = OpCode::log;
+        }
+        else if (name == "sqrt"){
+            function = OpCode::sqrt;
+        }
+        else{
+            position = name_start;
+            throw_parse_error("Unknown name '" + name + "'");
+        }
+        if (!accept('(')){
+            throw_parse_error("Missing ( after " + name);
+        }
+        Operand argument = parse_sum();
+        if (!accept(')')){
+            throw_parse_error("Missing )");
+        }
+        return emit(function, argument, argument);
+    }
+};
+
+template<typename REAL, std::size_t num_params>
+template<typename T>
+class BytecodeModel<REAL, num_params>::Prepared
+{
+    public:
+    /**
+     * @brief: Model output for one observation.
+    */
+    T operator()(T x) const {
+        std::array<T, max_registers> registers;
+        auto value = [&](const Operand &operand) -> const T& {
+            return operand.kind == OperandKind::input ? x : operand.kind == OperandKind::scalar ? slots[operand.index] : registers[operand.index];
+        };
+        for (const Instruction &instruction: model -> block_program){
+            registers[instruction.destination] = apply(instruction.op, value(instruction.left), value(instruction.right));
+        }
+        return value(model -> result);
+    }
+
+    private:
+    friend class BytecodeModel;
+    const BytecodeModel *model;
+    std::array<T, max_slots> slots;
+};
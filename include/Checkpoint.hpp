@@ -0,0 +1,77 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+/**
+ * @brief Thrown by a sampler that has written a checkpoint because a stop was requested with request_checkpoint_stop. Sampling the same configuration again with the same checkpoint file resumes the run.
+*/
+class SamplingInterrupted : public std::runtime_error
+{
+    public:
+    using std::runtime_error::runtime_error;
+};
+
+/**
+ * @brief: Flag polled by samplers with checkpoints enabled. Lock free, so it can be set from a signal handler.
+*/
+inline std::atomic<bool>& checkpoint_stop_flag(){
+    static std::atomic<bool> flag(false);
+    return flag;
+}
+
+/**
+ * @brief: Asks the running sampler to write a checkpoint at its next opportunity and throw SamplingInterrupted. Safe to call from a SIGTERM handler so a batch job that is preempted keeps its progress.
+*/
+inline void request_checkpoint_stop(){
+    checkpoint_stop_flag().store(true);
+}
+
+/**
+ * @brief When a sampler should write its next checkpoint: once interval_seconds of wall time or interval_iterations iterations have passed since the last one, or a stop has been requested.
+ * An interval of 0 turns that criterion off.
+*/
+class CheckpointSchedule
+{
+    public:
+    CheckpointSchedule() = default;
+    CheckpointSchedule(double interval_seconds, std::uint64_t interval_iterations) : seconds(interval_seconds), iterations(interval_iterations) {}
+
+    /**
+     * @brief: Starts the clock and iteration count from the given iteration, at the start of sampling and after every checkpoint.
+    */
+    void reset(std::uint64_t iteration){
+        last_time = std::chrono::steady_clock::now();
+        last_iteration = iteration;
+    }
+
+    /**
+     * @brief: true if a checkpoint should be written now that iteration iterations have been done. Reads the clock, so callers poll it every few thousand iterations rather than every one.
+    */
+    bool due(std::uint64_t iteration) const {
+        if (checkpoint_stop_flag().load(std::memory_order_relaxed)){
+            return true;
+        }
+        if (iterations != 0 && iteration - last_iteration >= iterations){
+            return true;
+        }
+        return seconds > 0 && std::chrono::duration<double>(std::chrono::steady_clock::now() - last_time).count() >= seconds;
+    }
+
+    /**
+     * @brief: Throws SamplingInterrupted, clearing the request, if a stop was requested. Called straight after a checkpoint has been written.
+    */
+    static void stop_if_requested(const std::string &checkpoint_file){
+        if (checkpoint_stop_flag().exchange(false)){
+            throw SamplingInterrupted("Sampling interrupted - progress saved to checkpoint file " + checkpoint_file);
+        }
+    }
+
+    private:
+    double seconds = 0;
+    std::uint64_t iterations = 0;
+    std::chrono::steady_clock::time_point last_time = std::chrono::steady_clock::now();
+    std::uint64_t last_iteration = 0;
+};
@@ -0,0 +1,117 @@
+#pragma once
+#include <array>
+#include <cmath>
+
+/**
+ * @brief Forward mode dual number: a value together with its gradient with respect to num_vars variables. Arithmetic on duals applies the chain rule alongside each operation,
+ * so a model function instantiated with Dual<REAL, num_params> returns the model output and its exact gradient with respect to the parameters in one evaluation, without any derivative being written by hand.
+ * Constants, such as the independent variable x, are duals with a zero gradient.
+ *
+ * @tparam REAL: type representing real numbers; usually float or double.
+ * @tparam num_vars: number of variables the gradient is taken with respect to.
+*/
+template<typename REAL, std::size_t num_vars>
+class Dual
+{
+public:
+    Dual(REAL value = 0) : value(value), gradient{} {}
+    Dual(REAL value, const std::array<REAL, num_vars> &gradient) : value(value), gradient(gradient) {}
+
+    /**
+     * @brief: The variable with index idx at the given value, i.e. with a gradient that is 1 in entry idx and 0 elsewhere.
+    */
+    static Dual variable(REAL value, std::size_t idx){
+        Dual result(value);
+        result.gradient[idx] = 1;
+        return result;
+    }
+
+    friend Dual operator+(const Dual &a, const Dual &b){
+        Dual result(a.value + b.value);
+        for (std::size_t i = 0; i < num_vars; i++){
+            result.gradient[i] = a.gradient[i] + b.gradient[i];
+        }
+        return result;
+    }
+    friend Dual operator-(const Dual &a, const Dual &b){
+        Dual result(a.value - b.value);
+        for (std::size_t i = 0; i < num_vars; i++){
+            result.gradient[i] = a.gradient[i] - b.gradient[i];
+        }
+        return result;
+    }
+    friend Dual operator-(const Dual &a){
+        Dual result(-a.value);
+        for (std::size_t i = 0; i < num_vars; i++){
+            result.gradient[i] = -a.gradient[i];
+        }
+        return result;
+    }
+    friend Dual operator*(const Dual &a, const Dual &b){
+        Dual result(a.value * b.value);
+        for (std::size_t i = 0; i < num_vars; i++){
+            result.gradient[i] = a.gradient[i] * b.value + a.value * b.gradient[i];
+        }
+        return result;
+    }
+    friend Dual operator/(const Dual &a, const Dual &b){
+        Dual result(a.value / b.value);
+        for (std::size_t i = 0; i < num_vars; i++){
+            result.gradient[i] = (a.gradient[i] - result.value * b.gradient[i]) / b.value;
+        }
+        return result;
+    }
+    Dual& operator+=(const Dual &other){
+        return *this = *this + other;
+    }
+    Dual& operator-=(const Dual &other){
+        return *this = *this - other;
+    }
+    Dual& operator*=(const Dual &other){
+        return *this = *this * other;
+    }
+    Dual& operator/=(const Dual &other){
+        return *this = *this / other;
+    }
+
+    /**
+     * @brief: base^exponent. The log(base) term of the derivative is only formed when the exponent has a gradient, so constant exponents work for negative bases.
+    */
+    friend Dual pow(const Dual &base, const Dual &exponent){
+        Dual result(std::pow(base.value, exponent.value));
+        REAL base_factor = exponent.value * std::pow(base.value, exponent.value - 1);
+        bool variable_exponent = false;
+        for (std::size_t i = 0; i < num_vars; i++){
+            variable_exponent = variable_exponent || exponent.gradient[i] != 0;
+        }
+        REAL exponent_factor = variable_exponent ? result.value * std::log(base.value) : 0;
+        for (std::size_t i = 0; i < num_vars; i++){
+            result.gradient[i] = base_factor * base.gradient[i] + (exponent.gradient[i] != 0 ? exponent_factor * exponent.gradient[i] : 0);
+        }
+        return result;
+    }
+    friend Dual exp(const Dual &a){
+        Dual result(std::exp(a.value));
+        for (std::size_t i = 0; i < num_vars; i++){
+            result.gradient[i] = result.value * a.gradient[i];
+        }
+        return result;
+    }
+    friend Dual log(const Dual &a){
+        Dual result(std::log(a.value));
+        for (std::size_t i = 0; i < num_vars; i++){
+            result.gradient[i] = a.gradient[i] / a.value;
+        }
+        return result;
+    }
+    friend Dual sqrt(const Dual &a){
+        Dual result(std::sqrt(a.value));
+        for (std::size_t i = 0; i < num_vars; i++){
+            result.gradient[i] = a.gradient[i] / (2 * result.value);
+        }
+        return result;
+    }
+
+    REAL value;
+    std::array<REAL, num_vars> gradient;
+};
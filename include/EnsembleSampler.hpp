@@ -0,0 +1,215 @@
+#pragma once
+#include "Sampler.hpp"
+#include "ThreadPool.hpp"
+#include "Random.hpp"
+
+/**
+ * @brief Derived class template from base abstract class template that samples with the affine invariant ensemble sampler of Goodman and Weare (the stretch move used by emcee).
+ * An ensemble of walkers moves together: a walker proposes a point on the line through itself and a walker drawn from the other half of the ensemble, stretched by a random factor z.
+ * Because the proposals are built from the spread of the ensemble itself, the sampler is unaffected by the scale of the parameters and by linear correlations between them.
+ * The walkers of one half do not depend on each other, so the half is split into one share per thread and the proposals of a share are evaluated as one batch, reading the observations
+ * once per share. Every walker position after every update is counted into the marginal distribution.
+ *
+ * @tparam REAL: type representing real numbers; usually float or double.
+ *
+ * @tparam num_params: number of parameters that are being used to fit the model.
+*/
+template<typename REAL, std::size_t num_params>
+class EnsembleSampler : public Sampler<REAL, num_params>{
+    public:
+    /**
+     * @brief Constructor for EnsembleSampler. Calls the constructor of base abstract sampler class.
+     * @param filepath: Filepath of the data that is fitted to the provided function.
+     * @param func: Function that is used to fit the data. Takes the independent variable and parameter array.
+     * @param names: The names of each of the parameters.
+     * @param min_values: The minimum value of each parameter in the space.
+     * @param max_values: The maximum value of each parameter in the space.
+     * @param sample_points: The number of points sampled over all walkers. Each update of the ensemble samples one point per walker.
+     * @param num_walkers: Number of walkers, an even number of at least 2 * num_params. (optional: default = 32)
+     * @param stretch: Largest stretch factor a, z is drawn from g(z) ~ 1/sqrt(z) on [1/a, a]. (optional: default = 2)
+     * @param num_bins: The number of bins used to sample each parameter. (optional: default = 100)
+     * @param rigidity: The flexibility of the Observations object when it reads data. (optional: default = false)
+    */
+    EnsembleSampler(const std::string &filepath, const std::function<REAL(REAL,std::array<REAL,num_params>&)> &func,
+    std::array<std::string,num_params> names, std::array<REAL,num_params> min_values, std::array<REAL, num_params> max_values,
+    uint sample_points = 100000, uint num_walkers = 32, REAL stretch = 2,
+    uint num_bins = 100, const bool rigidity = false) : Sampler<REAL, num_params>(filepath, func, names, min_values, max_values, num_bins, rigidity)
+    {
+        if (num_walkers < 2 * num_params || num_walkers % 2 != 0){
+            throw std::domain_error("Error - The number of walkers must be even and at least twice the number of parameters.");
+        }
+        if (!(stretch > 1)){
+            throw std::domain_error("Error - The stretch factor must be greater than 1.");
+        }
+        if (sample_points > 1000000000){
+            std::cerr << "Warning: The number of points to be sampled exceeds 1,000,000,000. This amount is excessively high and may take a while. Please make sure you want to keep sampling!" << std::endl;
+        }
+        num_sample_points = sample_points;
+        this -> num_walkers = num_walkers;
+        this -> stretch = stretch;
+    }
+
+    /**
+     * @brief: Places the walkers uniformly at random in the parameter space and updates the two halves of the ensemble in turn, sample_points / num_walkers times. Walker k draws from its own generator,
+     * Xoshiro256::stream(42, k), so the result does not depend on the number of threads. A stretch move to Y = X_j + z (X_k - X_j) is accepted with probability min(1, z^(num_params - 1) L(Y) / L(X_k))
+     * and a move outside the parameter space is rejected.
+    */
+    void sample() override {
+        if (this -> been_sampled){
+            throw std::logic_error("Error - Procedure aborted as this EnsembleSampler instance has already sampled the data points.");
+        }
+        if (this -> uses_checkpoints()){
+            throw std::logic_error("Error - Checkpoints are not available for the ensemble sampler.");
+        }
+        const std::array<ParamInfo<REAL>, num_params>& params_info = this -> get_params_info();
+        uint number_bins = this -> get_bins();
+        std::vector<Walker> walkers(num_walkers);
+        std::vector<Xoshiro256> generators = Xoshiro256::streams(42, num_walkers);
+        for (uint k = 0; k < num_walkers; k++){
+            walkers[k].generator = generators[k];
+            for (std::size_t i = 0; i < num_params; i++){
+                walkers[k].unit_hypercube[i] = unit_uniform<REAL>(walkers[k].generator);
+            }
+        }
+        uint half = num_walkers / 2;
+        uint num_shares = std::min(num_threads, half);
+        ThreadPool pool(num_shares);
+        pool.parallel_for(num_shares, [&](uint, std::uint64_t share){
+            std::vector<std::array<REAL, num_params>> params_batch;
+            std::vector<REAL> log_likelihoods;
+            for (uint k = share * num_walkers / num_shares; k < (share + 1) * num_walkers / num_shares; k++){
+                params_batch.push_back(to_params(walkers[k].unit_hypercube, params_info));
+            }
+            this -> batch_log_likelihood(params_batch, log_likelihoods);
+            for (uint k = share * num_walkers / num_shares, idx = 0; idx < log_likelihoods.size(); k++, idx++){
+                walkers[k].log_likelihood = log_likelihoods[idx];
+            }
+        });
+        add_to_marginals(walkers, number_bins);
+
+        accepted_moves = 0;
+        uint num_updates = std::max(num_sample_points / num_walkers, 1u);
+        for (uint update = 0; update < num_updates; update++){
+            for (uint moving = 0; moving < 2; moving++){ // walkers [moving * half, moving * half + half) move using the other half as the complementary ensemble.
+                uint first_walker = moving * half;
+                uint first_partner = half - first_walker;
+                pool.parallel_for(num_shares, [&](uint, std::uint64_t share){
+                    stretch_moves(walkers, first_walker + share * half / num_shares, first_walker + (share + 1) * half / num_shares, first_partner, params_info);
+                });
+            }
+            add_to_marginals(walkers, number_bins);
+        }
+        for (const Walker &walker: walkers){
+            accepted_moves += walker.accepted;
+        }
+        total_moves = static_cast<std::uint64_t>(num_updates) * num_walkers;
+        this -> normalise_marginal_distribution();
+        this -> been_sampled = true;
+        this -> set_extra_settings({{"N_sample", std::to_string(num_sample_points)}, {"walkers", std::to_string(num_walkers)}});
+    }
+
+    /**
+     * @brief Sets the number of threads the walkers of each half of the ensemble are spread across.
+     * @param threads: Number of threads. (default = 1)
+    */
+    void set_num_threads(uint threads){
+        if (threads == 0){
+            throw std::domain_error("Error - Number of threads cannot be 0.");
+        }
+        num_threads = threads;
+    }
+    uint get_num_threads() const {
+        return num_threads;
+    }
+    uint get_num_walkers() const {
+        return num_walkers;
+    }
+
+    /**
+     * @brief: Fraction of the stretch moves of the last sample that were accepted. Between about 0.2 and 0.5 is healthy.
+    */
+    REAL get_acceptance_rate() const {
+        return total_moves == 0 ? 0 : static_cast<REAL>(accepted_moves) / total_moves;
+    }
+
+    private:
+    uint num_sample_points;
+    uint num_walkers;
+    REAL stretch;
+    uint num_threads = 1;
+    std::uint64_t accepted_moves = 0;
+    std::uint64_t total_moves = 0;
+
+    struct Walker{
+        Xoshiro256 generator;
+        std::array<REAL, num_params> unit_hypercube;
+        REAL log_likelihood = 0;
+        std::uint64_t accepted = 0;
+    };
+
+    static std::array<REAL, num_params> to_params(const std::array<REAL, num_params> &unit_hypercube, const std::array<ParamInfo<REAL>, num_params>& params_info){
+        std::array<REAL, num_params> params;
+        for (std::size_t i = 0; i < num_params; i++){
+            params[i] = params_info[i].min + unit_hypercube[i] * params_info[i].width;
+        }
+        return params;
+    }
+
+    /**
+     * @brief: A stretch move drawn for one walker, waiting for the log likelihood of its proposal.
+    */
+    struct StretchMove{
+        uint walker;
+        std::array<REAL, num_params> proposal;
+        REAL log_threshold; // log u - (num_params - 1) log z, the proposal is accepted if its log likelihood ratio beats it
+    };
+
+    /**
+     * @brief Moves the walkers [first_walker, last_walker) with stretch moves about partners drawn uniformly from the other half of the ensemble. Every walker draws its move first and the proposals
+     * inside the parameter space are then evaluated as one batch. Only reads the other half, so the walkers of one half can move at the same time.
+     * @param walkers: The whole ensemble.
+     * @param first_walker: Index of the first walker to move.
+     * @param last_walker: One past the index of the last walker to move.
+     * @param first_partner: Index of the first walker of the other half.
+    */
+    void stretch_moves(std::vector<Walker> &walkers, uint first_walker, uint last_walker, uint first_partner, const std::array<ParamInfo<REAL>, num_params>& params_info){
+        uint half = num_walkers / 2;
+        std::vector<StretchMove> moves;
+        std::vector<std::array<REAL, num_params>> params_batch;
+        for (uint k = first_walker; k < last_walker; k++){
+            Walker &walker = walkers[k];
+            const Walker &partner = walkers[first_partner + std::min(static_cast<uint>(unit_uniform<REAL>(walker.generator) * half), half - 1)];
+            REAL root_z = 1 / std::sqrt(stretch) + (std::sqrt(stretch) - 1 / std::sqrt(stretch)) * unit_uniform<REAL>(walker.generator); // sqrt(z) is uniform on [1/sqrt(a), sqrt(a)]
+            REAL z = root_z * root_z;
+            StretchMove move{k, {}, std::log(unit_uniform<REAL>(walker.generator)) - static_cast<REAL>((num_params - 1.0) * std::log(z))};
+            bool inside = true;
+            for (std::size_t i = 0; i < num_params && inside; i++){
+                move.proposal[i] = partner.unit_hypercube[i] + z * (walker.unit_hypercube[i] - partner.unit_hypercube[i]);
+                inside = move.proposal[i] >= 0 && move.proposal[i] < 1; // outside the parameter space the posterior is 0
+            }
+            if (inside){
+                moves.push_back(move);
+                params_batch.push_back(to_params(move.proposal, params_info));
+            }
+        }
+        std::vector<REAL> log_likelihoods;
+        this -> batch_log_likelihood(params_batch, log_likelihoods);
+        for (std::size_t idx = 0; idx < moves.size(); idx++){
+            Walker &walker = walkers[moves[idx].walker];
+            if (log_likelihoods[idx] - walker.log_likelihood > moves[idx].log_threshold){
+                walker.unit_hypercube = moves[idx].proposal;
+                walker.log_likelihood = log_likelihoods[idx];
+                walker.accepted++;
+            }
+        }
+    }
+
+    void add_to_marginals(const std::vector<Walker> &walkers, uint number_bins){
+        for (const Walker &walker: walkers){
+            for (std::size_t i = 0; i < num_params; i++){
+                uint bin_number = static_cast<uint>(std::floor(walker.unit_hypercube[i] * number_bins));
+                this -> marginal_distribution[i][bin_number]++;
+            }
+        }
+    }
+};
@@ -0,0 +1,330 @@
+#pragma once
+#include "Sampler.hpp"
+#include "Random.hpp"
+
+/**
+ * @brief Derived class template from base abstract class template that samples with Hamiltonian Monte Carlo using the No-U-Turn Sampler of Hoffman and Gelman (their algorithm 6).
+ * The chain moves along trajectories of simulated Hamiltonian dynamics in the unit hypercube, driven by the gradient of the log likelihood, and each trajectory is doubled until it starts to turn back
+ * on itself, so there is no trajectory length to tune. The step size is tuned during warm up by dual averaging towards a target acceptance statistic. Gradients come from the model function
+ * instantiated on dual numbers, set with Sampler::set_gradient_model, so no derivative has to be written by hand. The walls of the parameter space reflect the trajectory.
+ * Long trajectories take the chain across the posterior in one iteration, so far fewer likelihood evaluations are needed per effective sample than with random walk Metropolis, especially in higher dimensions.
+ *
+ * @tparam REAL: type representing real numbers; usually float or double.
+ *
+ * @tparam num_params: number of parameters that are being used to fit the model.
+*/
+template<typename REAL, std::size_t num_params>
+class HamiltonianSampler : public Sampler<REAL, num_params>{
+    public:
+    /**
+     * @brief Constructor for HamiltonianSampler. Calls the constructor of base abstract sampler class.
+     * @param filepath: Filepath of the data that is fitted to the provided function.
+     * @param func: Function that is used to fit the data. Takes the independent variable and parameter array.
+     * @param names: The names of each of the parameters.
+     * @param min_values: The minimum value of each parameter in the space.
+     * @param max_values: The maximum value of each parameter in the space.
+     * @param sample_points: The number of iterations after warm up, each of which is counted into the marginal distribution.
+     * @param warm_up_iterations: Iterations before those in which the step size is tuned. They are not counted. (optional: default = 1000)
+     * @param target_acceptance: Mean acceptance statistic the step size is tuned towards. (optional: default = 0.8)
+     * @param max_tree_depth: Trajectories are at most 2^max_tree_depth steps long. (optional: default = 10)
+     * @param num_bins: The number of bins used to sample each parameter. (optional: default = 100)
+     * @param rigidity: The flexibility of the Observations object when it reads data. (optional: default = false)
+    */
+    HamiltonianSampler(const std::string &filepath, const std::function<REAL(REAL,std::array<REAL,num_params>&)> &func,
+    std::array<std::string,num_params> names, std::array<REAL,num_params> min_values, std::array<REAL, num_params> max_values,
+    uint sample_points = 10000, uint warm_up_iterations = 1000, REAL target_acceptance = 0.8, uint max_tree_depth = 10,
+    uint num_bins = 100, const bool rigidity = false) : Sampler<REAL, num_params>(filepath, func, names, min_values, max_values, num_bins, rigidity)
+    {
+        if (!(target_acceptance > 0 && target_acceptance < 1)){
+            throw std::domain_error("Error - The target acceptance must be between 0 and 1.");
+        }
+        if (max_tree_depth == 0 || max_tree_depth > 30){
+            throw std::domain_error("Error - The maximum tree depth must be between 1 and 30.");
+        }
+        if (sample_points > 100000000){
+            std::cerr << "Warning: The number of points to be sampled exceeds 100,000,000. Every one of them takes many gradient evaluations so this may take a while. Please make sure you want to keep sampling!" << std::endl;
+        }
+        num_sample_points = sample_points;
+        this -> warm_up_iterations = warm_up_iterations;
+        this -> target_acceptance = target_acceptance;
+        this -> max_tree_depth = max_tree_depth;
+    }
+
+    /**
+     * @brief: Runs the warm up and then the counted iterations from a uniformly random starting point drawn from a Xoshiro256 generator seeded with 42. Needs a gradient model.
+    */
+    void sample() override {
+        if (this -> been_sampled){
+            throw std::logic_error("Error - Procedure aborted as this HamiltonianSampler instance has already sampled the data points.");
+        }
+        if (!this -> has_gradient_model()){
+            throw std::logic_error("Error - The Hamiltonian sampler needs a gradient model. Call set_gradient_model first.");
+        }
+        if (this -> uses_checkpoints()){
+            throw std::logic_error("Error - Checkpoints are not available for the Hamiltonian sampler.");
+        }
+        Xoshiro256 generator(42);
+        momentum_normals = NormalBlock<REAL>();
+        uint number_bins = this -> get_bins();
+        gradient_evaluations = 0;
+        divergences = 0;
+
+        PhasePoint current;
+        for (std::size_t i = 0; i < num_params; i++){
+            current.position[i] = unit_uniform<REAL>(generator);
+        }
+        evaluate(current);
+
+        // dual averaging of the log step size, constants from Hoffman and Gelman
+        REAL step = initial_step_size(current, generator);
+        const double mu = std::log(10 * step);
+        const double gamma = 0.05;
+        const double t0 = 10;
+        const double kappa = 0.75;
+        double mean_statistic_error = 0;
+        double log_averaged_step = 0;
+        std::uint64_t total_depth = 0;
+
+        for (uint m = 1; m <= warm_up_iterations + num_sample_points; m++){
+            double acceptance_statistic = transition(current, step, generator);
+            if (m <= warm_up_iterations){
+                double weight = 1 / (m + t0);
+                mean_statistic_error = (1 - weight) * mean_statistic_error + weight * (target_acceptance - acceptance_statistic);
+                double log_step = mu - std::sqrt(static_cast<double>(m)) / gamma * mean_statistic_error;
+                double average_weight = std::pow(static_cast<double>(m), -kappa);
+                log_averaged_step = average_weight * log_step + (1 - average_weight) * log_averaged_step;
+                step = static_cast<REAL>(m == warm_up_iterations ? std::exp(log_averaged_step) : std::exp(log_step));
+            }
+            else{
+                total_depth += last_tree_depth;
+                for (std::size_t i = 0; i < num_params; i++){
+                    uint bin_number = std::min(static_cast<uint>(std::floor(current.position[i] * number_bins)), number_bins - 1);
+                    this -> marginal_distribution[i][bin_number]++;
+                }
+            }
+        }
+        step_size = step;
+        mean_tree_depth = num_sample_points == 0 ? 0 : static_cast<REAL>(total_depth) / num_sample_points;
+        this -> normalise_marginal_distribution();
+        this -> been_sampled = true;
+        this -> set_extra_settings({{"N_sample", std::to_string(num_sample_points)}, {"NUTS", std::to_string(warm_up_iterations)}});
+    }
+
+    /**
+     * @brief: Step size in the unit hypercube chosen by the warm up.
+    */
+    REAL get_step_size() const {
+        return step_size;
+    }
+    /**
+     * @brief: Number of log likelihood gradient evaluations of the last sample, including the warm up. Each costs about num_params + 1 log likelihood evaluations.
+    */
+    std::uint64_t get_num_gradient_evaluations() const {
+        return gradient_evaluations;
+    }
+    /**
+     * @brief: Number of trajectories stopped because the energy error exploded, a sign the step size is too large for part of the posterior.
+    */
+    std::uint64_t get_num_divergences() const {
+        return divergences;
+    }
+    REAL get_mean_tree_depth() const {
+        return mean_tree_depth;
+    }
+
+    private:
+    uint num_sample_points;
+    uint warm_up_iterations;
+    REAL target_acceptance;
+    uint max_tree_depth;
+    REAL step_size = 0;
+    REAL mean_tree_depth = 0;
+    uint last_tree_depth = 0;
+    std::uint64_t gradient_evaluations = 0;
+    std::uint64_t divergences = 0;
+    NormalBlock<REAL> momentum_normals; // momenta of the current run, drawn a block at a time
+    static constexpr double max_energy_error = 1000; // Delta_max, beyond which a trajectory is treated as divergent
+
+    /**
+     * @brief: Position in the unit hypercube and momentum, with the log likelihood and its gradient with respect to the position at that point.
+    */
+    struct PhasePoint{
+        std::array<REAL, num_params> position{};
+        std::array<REAL, num_params> momentum{};
+        std::array<REAL, num_params> gradient{};
+        REAL log_likelihood = 0;
+
+        double hamiltonian_log_density() const { // -H = log likelihood - |momentum|^2 / 2
+            double kinetic = 0;
+            for (std::size_t i = 0; i < num_params; i++){
+                kinetic += momentum[i] * momentum[i];
+            }
+            return log_likelihood - kinetic / 2;
+        }
+    };
+
+    /**
+     * @brief: Result of building a subtree: its two ends, the point proposed from it, the number of points inside the slice, whether to continue and the summed acceptance statistics.
+    */
+    struct Subtree{
+        PhasePoint minus;
+        PhasePoint plus;
+        PhasePoint proposal;
+        std::uint64_t num_valid = 0;
+        bool keep_going = true;
+        double acceptance_sum = 0;
+        std::uint64_t num_steps = 0;
+    };
+
+    void evaluate(PhasePoint &point){
+        const std::array<ParamInfo<REAL>, num_params>& params_info = this -> get_params_info();
+        std::array<REAL, num_params> params;
+        for (std::size_t i = 0; i < num_params; i++){
+            params[i] = params_info[i].min + point.position[i] * params_info[i].width;
+        }
+        point.log_likelihood = this -> log_likelihood_gradient(params, point.gradient);
+        for (std::size_t i = 0; i < num_params; i++){
+            point.gradient[i] *= params_info[i].width; // chain rule to unit hypercube coordinates
+        }
+        gradient_evaluations++;
+    }
+
+    /**
+     * @brief: One leapfrog step of size step. A position that leaves the unit hypercube is reflected back in with its momentum reversed, which keeps the dynamics reversible and volume preserving.
+    */
+    PhasePoint leapfrog(const PhasePoint &point, REAL step){
+        PhasePoint next = point;
+        for (std::size_t i = 0; i < num_params; i++){
+            next.momentum[i] += step / 2 * next.gradient[i];
+            next.position[i] += step * next.momentum[i];
+            while (next.position[i] < 0 || next.position[i] > 1){
+                next.position[i] = next.position[i] < 0 ? -next.position[i] : 2 - next.position[i];
+                next.momentum[i] = -next.momentum[i];
+            }
+        }
+        evaluate(next);
+        for (std::size_t i = 0; i < num_params; i++){
+            next.momentum[i] += step / 2 * next.gradient[i];
+        }
+        return next;
+    }
+
+    static bool no_u_turn(const PhasePoint &minus, const PhasePoint &plus){
+        double minus_projection = 0;
+        double plus_projection = 0;
+        for (std::size_t i = 0; i < num_params; i++){
+            double span = plus.position[i] - minus.position[i];
+            minus_projection += span * minus.momentum[i];
+            plus_projection += span * plus.momentum[i];
+        }
+        return minus_projection >= 0 && plus_projection >= 0;
+    }
+
+    /**
+     * @brief Builds a subtree of 2^depth leapfrog steps from point in the given direction.
+     * @param point: Edge of the trajectory the subtree grows from.
+     * @param log_slice: Log of the slice variable; points with a lower -H are outside the slice.
+     * @param direction: +1 forwards in time, -1 backwards.
+     * @param depth: Depth of the subtree.
+     * @param step: Step size.
+     * @param initial_log_density: -H at the start of the trajectory, for the acceptance statistic.
+    */
+    Subtree build_tree(const PhasePoint &point, double log_slice, int direction, uint depth, REAL step, double initial_log_density, Xoshiro256 &generator){
+        if (depth == 0){
+            Subtree leaf;
+            leaf.proposal = leapfrog(point, direction * step);
+            leaf.minus = leaf.proposal;
+            leaf.plus = leaf.proposal;
+            double log_density = leaf.proposal.hamiltonian_log_density();
+            leaf.num_valid = log_slice <= log_density ? 1 : 0;
+            leaf.keep_going = log_density > log_slice - max_energy_error;
+            if (!leaf.keep_going){
+                divergences++;
+            }
+            leaf.acceptance_sum = std::isnan(log_density) ? 0 : std::min(1.0, std::exp(log_density - initial_log_density));
+            leaf.num_steps = 1;
+            return leaf;
+        }
+        Subtree tree = build_tree(point, log_slice, direction, depth - 1, step, initial_log_density, generator);
+        if (!tree.keep_going){
+            return tree;
+        }
+        Subtree extension = build_tree(direction == -1 ? tree.minus : tree.plus, log_slice, direction, depth - 1, step, initial_log_density, generator);
+        if (direction == -1){
+            tree.minus = extension.minus;
+        }
+        else{
+            tree.plus = extension.plus;
+        }
+        if (extension.num_valid > 0 && unit_uniform<double>(generator) * (tree.num_valid + extension.num_valid) < extension.num_valid){
+            tree.proposal = extension.proposal;
+        }
+        tree.acceptance_sum += extension.acceptance_sum;
+        tree.num_steps += extension.num_steps;
+        tree.keep_going = extension.keep_going && no_u_turn(tree.minus, tree.plus);
+        tree.num_valid += extension.num_valid;
+        return tree;
+    }
+
+    /**
+     * @brief: One No-U-Turn iteration from current with a freshly drawn momentum, replacing current with the point it moves to.
+     * @return: The acceptance statistic used to tune the step size.
+    */
+    double transition(PhasePoint &current, REAL step, Xoshiro256 &generator){
+        for (std::size_t i = 0; i < num_params; i++){
+            current.momentum[i] = momentum_normals(generator);
+        }
+        double initial_log_density = current.hamiltonian_log_density();
+        double log_slice = initial_log_density + std::log(unit_uniform<double>(generator));
+        PhasePoint minus = current;
+        PhasePoint plus = current;
+        PhasePoint next = current;
+        std::uint64_t num_valid = 1;
+        double acceptance_sum = 0;
+        std::uint64_t num_steps = 0;
+        uint depth = 0;
+        bool keep_going = true;
+        while (keep_going && depth < max_tree_depth){
+            int direction = unit_uniform<double>(generator) < 0.5 ? -1 : 1;
+            Subtree tree = build_tree(direction == -1 ? minus : plus, log_slice, direction, depth, step, initial_log_density, generator);
+            if (direction == -1){
+                minus = tree.minus;
+            }
+            else{
+                plus = tree.plus;
+            }
+            if (tree.keep_going && unit_uniform<double>(generator) * num_valid < tree.num_valid){
+                next = tree.proposal;
+            }
+            num_valid += tree.num_valid;
+            acceptance_sum += tree.acceptance_sum;
+            num_steps += tree.num_steps;
+            keep_going = tree.keep_going && no_u_turn(minus, plus);
+            depth++;
+        }
+        last_tree_depth = depth;
+        current = next;
+        return acceptance_sum / num_steps;
+    }
+
+    /**
+     * @brief: Heuristic first step size: halves or doubles the step until a single leapfrog step changes the Hamiltonian acceptance probability across 1/2.
+    */
+    REAL initial_step_size(const PhasePoint &start, Xoshiro256 &generator){
+        PhasePoint point = start;
+        for (std::size_t i = 0; i < num_params; i++){
+            point.momentum[i] = momentum_normals(generator);
+        }
+        REAL step = 0.1;
+        double log_ratio = leapfrog(point, step).hamiltonian_log_density() - point.hamiltonian_log_density();
+        int direction = log_ratio > std::log(0.5) ? 1 : -1;
+        for (uint tries = 0; tries < 100 && direction * log_ratio > -direction * std::log(2.0); tries++){
+            step = direction == 1 ? step * 2 : step / 2;
+            log_ratio = leapfrog(point, step).hamiltonian_log_density() - point.hamiltonian_log_density();
+            if (std::isnan(log_ratio)){
+                log_ratio = -std::numeric_limits<double>::infinity();
+            }
+        }
+        return step;
+    }
+};
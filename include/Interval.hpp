@@ -0,0 +1,79 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+/**
+ * @brief Closed interval [lower, upper] of real numbers with the arithmetic needed to evaluate the model functions over a box of parameters.
+ * The result of every operation contains every value the operation can take for arguments inside the operand intervals, so a model function instantiated with Interval<REAL>
+ * bounds the model output over a whole parameter box in one evaluation. Rounding is not directed outwards; the bounds are used with a margin of several nats so this is not an issue in practice.
+ * Operations that cannot be bounded cheaply return the whole real line, which is always safe.
+ *
+ * @tparam REAL: type representing real numbers; usually float or double.
+*/
+template<typename REAL>
+class Interval
+{
+public:
+    Interval(REAL value = 0) : lower(value), upper(value) {}
+    Interval(REAL lower, REAL upper) : lower(lower), upper(upper) {}
+
+    static Interval whole(){
+        return Interval(-std::numeric_limits<REAL>::infinity(), std::numeric_limits<REAL>::infinity());
+    }
+    bool contains(REAL value) const {
+        return lower <= value && value <= upper;
+    }
+
+    friend Interval operator+(const Interval &a, const Interval &b){
+        return Interval(a.lower + b.lower, a.upper + b.upper);
+    }
+    friend Interval operator-(const Interval &a, const Interval &b){
+        return Interval(a.lower - b.upper, a.upper - b.lower);
+    }
+    friend Interval operator-(const Interval &a){
+        return Interval(-a.upper, -a.lower);
+    }
+    friend Interval operator*(const Interval &a, const Interval &b){
+        REAL products[4] = {a.lower * b.lower, a.lower * b.upper, a.upper * b.lower, a.upper * b.upper};
+        return Interval(*std::min_element(products, products + 4), *std::max_element(products, products + 4));
+    }
+    friend Interval operator/(const Interval &a, const Interval &b){
+        if (b.contains(0)){
+            return whole();
+        }
+        return a * Interval(1 / b.upper, 1 / b.lower);
+    }
+    Interval& operator+=(const Interval &other){
+        return *this = *this + other;
+    }
+    Interval& operator*=(const Interval &other){
+        return *this = *this * other;
+    }
+
+    /**
+     * @brief: base^exponent for a non negative base. exponent * log(base) is bilinear so the extremes are at the corners of the two intervals. A base that reaches zero needs a positive exponent and negative bases are not bounded.
+    */
+    friend Interval pow(const Interval &base, const Interval &exponent){
+        if (!(base.lower > 0 || (base.lower == 0 && exponent.lower > 0))){
+            return whole();
+        }
+        REAL corners[4] = {std::pow(base.lower, exponent.lower), std::pow(base.lower, exponent.upper), std::pow(base.upper, exponent.lower), std::pow(base.upper, exponent.upper)};
+        return Interval(*std::min_element(corners, corners + 4), *std::max_element(corners, corners + 4));
+    }
+    friend Interval exp(const Interval &a){
+        return Interval(std::exp(a.lower), std::exp(a.upper));
+    }
+    /**
+     * @brief: log and sqrt are increasing, so only the ends are mapped. An argument that reaches zero or below is not bounded.
+    */
+    friend Interval log(const Interval &a){
+        return a.lower > 0 ? Interval(std::log(a.lower), std::log(a.upper)) : whole();
+    }
+    friend Interval sqrt(const Interval &a){
+        return a.lower >= 0 ? Interval(std::sqrt(a.lower), std::sqrt(a.upper)) : whole();
+    }
+
+    REAL lower;
+    REAL upper;
+};
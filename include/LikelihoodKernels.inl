@@ -0,0 +1,91 @@
+// Likelihood kernels of the known models, written once over a Lanes type that supplies the vector type and its arithmetic. VectorLikelihood.hpp includes this file
+// inside one namespace per instruction set, under the matching #pragma GCC target, so every instruction set gets its own compiled copy. It has no include guard on purpose.
+
+/**
+ * @brief: Log likelihood of the polynomial model, params[0] x^(n - 1) + ... + params[n - 1], over every observation. The model is evaluated by Horner's rule with fused multiply adds,
+ * two vectors of Lanes::width observations at a time to hide the latency of the chain, and the observations left over are done one by one.
+*/
+template<typename Lanes, std::size_t num_coefficients>
+typename Lanes::Real polynomial_log_likelihood(const std::array<typename Lanes::Real, num_coefficients> &coefficients, const typename Lanes::Real *inputs, const typename Lanes::Real *outputs,
+                                               const typename Lanes::Real *weights, std::size_t num_points){
+    using REAL = typename Lanes::Real;
+    using Vec = typename Lanes::Vec;
+    Vec broadcast[num_coefficients]; // a plain array, as std::array would drop the alignment of the vector type
+    for (std::size_t k = 0; k < num_coefficients; k++){
+        broadcast[k] = Lanes::set1(coefficients[k]);
+    }
+    Vec sum_a = Lanes::zero();
+    Vec sum_b = Lanes::zero();
+    std::size_t i = 0;
+    for (; i + 2 * Lanes::width <= num_points; i += 2 * Lanes::width){
+        Vec x_a = Lanes::load(inputs + i);
+        Vec x_b = Lanes::load(inputs + i + Lanes::width);
+        Vec model_a = broadcast[0];
+        Vec model_b = broadcast[0];
+        for (std::size_t k = 1; k < num_coefficients; k++){
+            model_a = Lanes::fmadd(model_a, x_a, broadcast[k]);
+            model_b = Lanes::fmadd(model_b, x_b, broadcast[k]);
+        }
+        Vec residual_a = Lanes::sub(model_a, Lanes::load(outputs + i));
+        Vec residual_b = Lanes::sub(model_b, Lanes::load(outputs + i + Lanes::width));
+        sum_a = Lanes::fmadd(Lanes::mul(residual_a, residual_a), Lanes::load(weights + i), sum_a);
+        sum_b = Lanes::fmadd(Lanes::mul(residual_b, residual_b), Lanes::load(weights + i + Lanes::width), sum_b);
+    }
+    REAL sum = Lanes::reduce(Lanes::add(sum_a, sum_b));
+    for (; i < num_points; i++){
+        REAL model = coefficients[0];
+        for (std::size_t k = 1; k < num_coefficients; k++){
+            model = model * inputs[i] + coefficients[k];
+        }
+        sum += (model - outputs[i]) * (model - outputs[i]) * weights[i];
+    }
+    return -sum;
+}
+
+/**
+ * @brief: e^t in every lane. t is split into k ln 2 + r with |r| <= ln(2) / 2, ln 2 in two parts so that r is exact, e^r comes from its Taylor series, to degree 13 for double and 7 for float
+ * which is below the rounding error of REAL, and 2^k is built in the exponent bits. t is clamped to the range where the result is a normal number.
+*/
+template<typename Lanes>
+typename Lanes::Vec exp_lanes(typename Lanes::Vec t){
+    using REAL = typename Lanes::Real;
+    using Vec = typename Lanes::Vec;
+    constexpr bool is_double = sizeof(REAL) == 8;
+    constexpr int degree = is_double ? 13 : 7;
+    constexpr double inverse_factorials[14] = {1.0, 1.0, 1.0 / 2, 1.0 / 6, 1.0 / 24, 1.0 / 120, 1.0 / 720, 1.0 / 5040, 1.0 / 40320, 1.0 / 362880, 1.0 / 3628800,
+                                               1.0 / 39916800, 1.0 / 479001600, 1.0 / 6227020800};
+    t = Lanes::min(Lanes::max(t, Lanes::set1(is_double ? REAL(-708) : REAL(-87))), Lanes::set1(is_double ? REAL(709) : REAL(88)));
+    Vec k = Lanes::round(Lanes::mul(t, Lanes::set1(REAL(1.4426950408889634))));
+    Vec r = Lanes::fmadd(k, Lanes::set1(is_double ? REAL(-6.93147180369123816490e-01) : REAL(-0.693359375)), t);
+    r = Lanes::fmadd(k, Lanes::set1(is_double ? REAL(-1.90821492927058770002e-10) : REAL(2.12194440e-4)), r);
+    Vec series = Lanes::set1(static_cast<REAL>(inverse_factorials[degree]));
+    for (int n = degree - 1; n >= 0; n--){
+        series = Lanes::fmadd(series, r, Lanes::set1(static_cast<REAL>(inverse_factorials[n])));
+    }
+    return Lanes::mul(series, Lanes::pow2(k));
+}
+
+/**
+ * @brief: Log likelihood of the power law model params[0] x^params[1] over every observation, from the logarithms of the inputs so that x^b = e^(b ln x) needs one exponential per observation.
+*/
+template<typename Lanes>
+typename Lanes::Real power_law_log_likelihood(const std::array<typename Lanes::Real, 2> &params, const typename Lanes::Real *log_inputs, const typename Lanes::Real *outputs,
+                                              const typename Lanes::Real *weights, std::size_t num_points){
+    using REAL = typename Lanes::Real;
+    using Vec = typename Lanes::Vec;
+    Vec amplitude = Lanes::set1(params[0]);
+    Vec exponent = Lanes::set1(params[1]);
+    Vec sum = Lanes::zero();
+    std::size_t i = 0;
+    for (; i + Lanes::width <= num_points; i += Lanes::width){
+        Vec model = Lanes::mul(amplitude, exp_lanes<Lanes>(Lanes::mul(exponent, Lanes::load(log_inputs + i))));
+        Vec residual = Lanes::sub(model, Lanes::load(outputs + i));
+        sum = Lanes::fmadd(Lanes::mul(residual, residual), Lanes::load(weights + i), sum);
+    }
+    REAL total = Lanes::reduce(sum);
+    for (; i < num_points; i++){
+        REAL model = params[0] * std::exp(params[1] * log_inputs[i]);
+        total += (model - outputs[i]) * (model - outputs[i]) * weights[i];
+    }
+    return -total;
+}
@@ -0,0 +1,177 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/**
+ * @brief Contiguous array of log likelihoods addressed by flattened grid index, flat = sum_j c_j * bins^(num_axes - 1 - j) where c_j is the bin index on axis j.
+ * Used by the Uniform Sampler in place of the std::map so that a grid point costs sizeof(REAL) bytes and a store is a plain write.
+ * The storage is either held in memory or memory mapped to a file, in which case the tensor is left on disk once the sampler is finished with it.
+ *
+ * @tparam REAL: type representing real numbers; usually float or double.
+*/
+template<typename REAL>
+class LikelihoodTensor
+{
+    public:
+    LikelihoodTensor() = default;
+    ~LikelihoodTensor(){
+        release();
+    }
+    LikelihoodTensor(const LikelihoodTensor&) = delete;
+    LikelihoodTensor& operator=(const LikelihoodTensor&) = delete;
+
+    /**
+     * @brief Allocates space for num_entries log likelihoods, discarding anything held before.
+     * @param num_entries: Number of grid points.
+     * @param backing_file: File the tensor is memory mapped to. Created or truncated to the right size. Held in memory if empty. (optional: default = "")
+    */
+    void allocate(std::uint64_t num_entries, const std::string &backing_file = ""){
+        release();
+        entries = num_entries;
+        if (backing_file.empty()){
+            memory.assign(num_entries, 0);
+            values = memory.data();
+            return;
+        }
+        std::uint64_t num_bytes = num_entries * sizeof(REAL);
+        file_descriptor = ::open(backing_file.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (file_descriptor < 0){
+            throw std::runtime_error("Unable to open likelihood tensor file: " + backing_file);
+        }
+        if (::ftruncate(file_descriptor, static_cast<off_t>(num_bytes)) != 0){
+            release();
+            throw std::runtime_error("Unable to resize likelihood tensor file: " + backing_file);
+        }
+        if (num_bytes == 0){
+            return;
+        }
+        void *mapping = ::mmap(nullptr, num_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, file_descriptor, 0);
+        if (mapping == MAP_FAILED){
+            release();
+            throw std::runtime_error("Unable to memory map likelihood tensor file: " + backing_file);
+        }
+        values = static_cast<REAL*>(mapping);
+        mapped_bytes = num_bytes;
+    }
+
+    std::uint64_t size() const {
+        return entries;
+    }
+    bool is_memory_mapped() const {
+        return mapped_bytes != 0;
+    }
+    REAL* data(){
+        return values;
+    }
+    const REAL* data() const {
+        return values;
+    }
+    REAL& operator[](std::uint64_t flat_idx){
+        return values[flat_idx];
+    }
+    const REAL& operator[](std::uint64_t flat_idx) const {
+        return values[flat_idx];
+    }
+
+    /**
+     * @brief Reads the log likelihood stored for a combination of bin indices, which must lie inside the tensor.
+     * @param combination: Bin index on every axis.
+     * @param num_bins: Number of bins on every axis.
+    */
+    template<std::size_t num_axes>
+    const REAL& at(const std::array<uint, num_axes> &combination, uint num_bins) const {
+        std::uint64_t flat_idx = 0;
+        for (std::size_t j = 0; j < num_axes; j++){
+            if (combination[j] >= num_bins){
+                throw std::domain_error("Error - Bin index " + std::to_string(combination[j]) + " is out of range for " + std::to_string(num_bins) + " bins.");
+            }
+            flat_idx = flat_idx * num_bins + combination[j];
+        }
+        if (flat_idx >= entries){
+            throw std::domain_error("Error - Bin indices address a grid point outside the likelihood tensor.");
+        }
+        return values[flat_idx];
+    }
+
+    /**
+     * @brief: Largest log likelihood in the flat index range [first, last).
+    */
+    REAL max_value(std::uint64_t first, std::uint64_t last) const {
+        REAL maximum = -std::numeric_limits<REAL>::infinity();
+        for (std::uint64_t i = first; i < last; i++){
+            if (values[i] > maximum){
+                maximum = values[i];
+            }
+        }
+        return maximum;
+    }
+
+    /**
+     * @brief Axis reductions of exp(log likelihood - log_offset) over the grid rows [first_row, last_row), where a row is the num_bins entries of the last axis with every other bin index fixed.
+     * Every axis is reduced in the same pass so each entry is read and exponentiated once. Results are added to marginal.
+     * @param first_row: First row to reduce.
+     * @param last_row: One past the last row to reduce.
+     * @param num_bins: Number of bins on every axis.
+     * @param log_offset: Subtracted from every log likelihood before exponentiating, normally the largest value in the tensor.
+     * @param marginal: num_axes vectors of num_bins sums that the reductions are added to.
+    */
+    template<std::size_t num_axes>
+    void reduce_axes(std::uint64_t first_row, std::uint64_t last_row, uint num_bins, REAL log_offset, std::vector<std::vector<REAL>> &marginal) const {
+        constexpr std::size_t inner = num_axes - 1;
+        std::array<uint, num_axes> combination{};
+        std::uint64_t remainder = first_row;
+        for (std::size_t idx = inner; idx-- > 0;){
+            combination[idx] = static_cast<uint>(remainder % num_bins);
+            remainder /= num_bins;
+        }
+        std::vector<REAL> &inner_marginal = marginal[inner];
+        for (std::uint64_t row = first_row; row < last_row; row++){
+            const REAL *row_values = values + row * num_bins;
+            REAL row_sum = 0;
+            for (uint j = 0; j < num_bins; j++){
+                REAL likelihood = std::exp(row_values[j] - log_offset);
+                inner_marginal[j] += likelihood;
+                row_sum += likelihood;
+            }
+            for (std::size_t idx = 0; idx < inner; idx++){
+                marginal[idx][combination[idx]] += row_sum;
+            }
+            for (std::size_t idx = inner; idx-- > 0;){
+                if (++combination[idx] < num_bins){
+                    break;
+                }
+                combination[idx] = 0;
+            }
+        }
+    }
+
+    private:
+    void release(){
+        if (mapped_bytes != 0){
+            ::munmap(values, mapped_bytes);
+        }
+        if (file_descriptor >= 0){
+            ::close(file_descriptor);
+        }
+        std::vector<REAL>().swap(memory);
+        values = nullptr;
+        entries = 0;
+        mapped_bytes = 0;
+        file_descriptor = -1;
+    }
+
+    std::vector<REAL> memory;
+    REAL *values = nullptr;
+    std::uint64_t entries = 0;
+    std::uint64_t mapped_bytes = 0;
+    int file_descriptor = -1;
+};
@@ -0,0 +1,145 @@
+#pragma once
+#include <array>
+#include <functional>
+#include <cmath>
+#include "Observations.hpp"
+
+/**
+ * @brief Likelihood engine for models that are linear in their parameters, f(x) = sum_j p_j phi_j(x), described by the basis functions phi_j.
+ * For such a model chi^2 is a quadratic form in the parameters so the sufficient statistics G_jk = sum_i phi_j(x_i) phi_k(x_i) / sigma_i^2 (the Gram matrix) and
+ * h_j = sum_i y_i phi_j(x_i) / sigma_i^2 are computed once from the observations. After that every log likelihood evaluation costs O(p^2) instead of O(N).
+ * The quadratic form is expanded around the least squares solution p_hat, chi^2(p) = chi^2(p_hat) + d^T G d - 2 r^T d with d = p - p_hat, so no large terms cancel when it is evaluated.
+ * r = h - G p_hat is zero up to rounding unless G is singular, in which case p_hat is left at 0.
+ *
+ * @tparam REAL: type representing real numbers; usually float or double.
+ * @tparam num_params: number of parameters that are being used to fit the model.
+*/
+template<typename REAL, std::size_t num_params>
+class LinearModel
+{
+    public:
+    using BasisFunctions = std::array<std::function<REAL(REAL)>, num_params>;
+
+    /**
+     * @brief Constructor that computes the sufficient statistics. Accumulation is done in double so float samplers keep their precision.
+     * @param basis: Basis function of each parameter so that the model is sum_j params[j] * basis[j](x).
+     * @param observations: Observations the likelihood is evaluated against.
+    */
+    LinearModel(const BasisFunctions &basis, const Observations<REAL> &observations){
+        std::array<double, num_params> phi;
+        double data_term = 0; // sum y^2 / sigma^2
+        for (uint i = 0; i < observations.num_points; i++){
+            double inverse_variance = 1.0 / (static_cast<double>(observations.sigmas[i]) * observations.sigmas[i]);
+            for (std::size_t j = 0; j < num_params; j++){
+                phi[j] = basis[j](observations.inputs[i]);
+            }
+            for (std::size_t j = 0; j < num_params; j++){
+                projection[j] += observations.outputs[i] * phi[j] * inverse_variance;
+                for (std::size_t k = 0; k < num_params; k++){
+                    gram_matrix[j][k] += phi[j] * phi[k] * inverse_variance;
+                }
+            }
+            data_term += static_cast<double>(observations.outputs[i]) * observations.outputs[i] * inverse_variance;
+        }
+
+        if (solve_normal_equations()){
+            residual_projection = projection;
+            for (std::size_t j = 0; j < num_params; j++){
+                for (std::size_t k = 0; k < num_params; k++){
+                    residual_projection[j] -= gram_matrix[j][k] * best_fit[k];
+                }
+            }
+            // chi^2 at the least squares solution is recomputed directly from the data rather than as data_term - h^T p_hat.
+            minimum_chi_squared = 0;
+            for (uint i = 0; i < observations.num_points; i++){
+                double residual = observations.outputs[i];
+                for (std::size_t j = 0; j < num_params; j++){
+                    residual -= best_fit[j] * basis[j](observations.inputs[i]);
+                }
+                minimum_chi_squared += residual * residual / (static_cast<double>(observations.sigmas[i]) * observations.sigmas[i]);
+            }
+        }
+        else{
+            best_fit.fill(0);
+            residual_projection = projection;
+            minimum_chi_squared = data_term;
+        }
+    }
+
+    /**
+     * @brief: Log likelihood -chi^2/2 of the parameter vector evaluated from the sufficient statistics.
+    */
+    REAL log_likelihood(const std::array<REAL, num_params> &params) const {
+        std::array<double, num_params> delta;
+        for (std::size_t j = 0; j < num_params; j++){
+            delta[j] = params[j] - best_fit[j];
+        }
+        double chi_squared = minimum_chi_squared;
+        for (std::size_t j = 0; j < num_params; j++){
+            double row = 0;
+            for (std::size_t k = 0; k < num_params; k++){
+                row += gram_matrix[j][k] * delta[k];
+            }
+            chi_squared += delta[j] * (row - 2 * residual_projection[j]);
+        }
+        return static_cast<REAL>(-0.5 * chi_squared);
+    }
+
+    const std::array<std::array<double, num_params>, num_params>& get_gram_matrix() const {
+        return gram_matrix;
+    }
+    const std::array<double, num_params>& get_projection() const {
+        return projection;
+    }
+    const std::array<double, num_params>& get_best_fit() const {
+        return best_fit;
+    }
+
+    private:
+    /**
+     * @brief: Solves G p_hat = h with a Cholesky factorisation of the Gram matrix.
+     * @return: false if the Gram matrix is not positive definite, e.g. because two basis functions are identical on the observed inputs.
+    */
+    bool solve_normal_equations(){
+        std::array<std::array<double, num_params>, num_params> lower{};
+        for (std::size_t j = 0; j < num_params; j++){
+            for (std::size_t k = 0; k <= j; k++){
+                double sum = gram_matrix[j][k];
+                for (std::size_t m = 0; m < k; m++){
+                    sum -= lower[j][m] * lower[k][m];
+                }
+                if (j == k){
+                    if (!(sum > 0)){
+                        return false;
+                    }
+                    lower[j][j] = std::sqrt(sum);
+                }
+                else{
+                    lower[j][k] = sum / lower[k][k];
+                }
+            }
+        }
+        std::array<double, num_params> forward;
+        for (std::size_t j = 0; j < num_params; j++){ // L z = h
+            double sum = projection[j];
+            for (std::size_t m = 0; m < j; m++){
+                sum -= lower[j][m] * forward[m];
+            }
+            forward[j] = sum / lower[j][j];
+        }
+        for (std::size_t j = num_params; j-- > 0;){ // L^T p_hat = z
+            double sum = forward[j];
+            for (std::size_t m = j + 1; m < num_params; m++){
+                sum -= lower[m][j] * best_fit[m];
+            }
+            best_fit[j] = sum / lower[j][j];
+        }
+        return true;
+    }
+
+    std::array<std::array<double, num_params>, num_params> gram_matrix{};
+    std::array<double, num_params> projection{};
+    std::array<double, num_params> residual_projection{};
+    std::array<double, num_params> best_fit{};
+    double minimum_chi_squared = 0;
+};
@@ -1,6 +1,12 @@
 #pragma once
 #include "Sampler.hpp"
-#include <random>
+#include "ThreadPool.hpp"
+#include "TraceBuffer.hpp"
+#include "Random.hpp"
+#include "BatchMeans.hpp"
+#include "TraceFile.hpp"
+#include <algorithm>
+#include <limits>
 
 /**
  * @brief Derived class template from base abstract class template that uses the Monte Carlo Markov Chain sampling method using the Metropolis Hastings algorithm. 
@@ -41,81 +47,856 @@ class MetropolisHastingSampler : public Sampler<REAL, num_params>{
 
     /**
      * @brief: Sampling method that uses the Metropolis Hastings algorithm to propogate the parameter vector of the system. 
-     * It uses a uniform distribution from the std::default_random_engine type that is seeded at 42 to generate an initial position in the unit hyperspace. 
-     * A vector is then added to the unit hypercube thhat is generated from a zero mean normal distribution with standard deviation as the step size. If the log likelihood of the new parameter value is higher than the old the chain is advanced.
+     * It uses uniform numbers from a Xoshiro256 generator that is seeded at 42 to generate an initial position in the unit hyperspace. 
+     * A vector is then added to the unit hypercube thhat is generated from a zero mean normal distribution with standard deviation as the step size, drawn from a NormalBlock. If the log likelihood of the new parameter value is higher than the old the chain is advanced.
      * Otherwise a uniform distribution generates a number u between 0 and 1. If log(u) < new log likelihood - old log likelihood then the new positon is accepted. If not it is rejected.
+     * With checkpoints enabled the chain position, the generator and normal block states, the iteration and the histograms are saved periodically and an existing checkpoint is resumed from.
+     * With more than one chain set the chains run on their own threads, their histograms are summed and the Gelman-Rubin R-hat of every parameter is stored in its ParamInfo.
+     * The chain carries the log likelihood of its current position, so the parameter likelihood map stays empty; use enable_trace to keep the visited points.
+     * With use_adaptive_proposal the isotropic step is replaced by a proposal learnt from the chain's own history, and with use_delayed_acceptance proposals are screened by a cheap likelihood first, see there.
+     * Every chain tracks the effective sample size, integrated autocorrelation time and Monte Carlo standard error of its draws by batch means as it runs; they are stored in the ParamInfo of every parameter
+     * together with the acceptance rate, and with stop_at_effective_sample_size or stop_at_standard_errors a chain stops as soon as its draws are good enough.
+     * set_burn_in and set_thinning choose which draws are kept: only kept draws are counted into the histograms, traces, trace files and diagnostics.
+     * With use_minibatch_likelihood every step estimates the log likelihood ratio from a random minibatch of the observations instead of evaluating the full likelihood, see there.
     */
     void sample() override {
         if (this -> been_sampled){
             throw std::logic_error("Error - Procedure aborted as this MetropolisHastingsSampler instance has already sampled the data points.");
         }
+        if (burn_in >= num_sample_points){ // no draw would be kept and the histograms would normalise to 0 / 0
+            throw std::domain_error("Error - The burn in must be shorter than the number of sample points.");
+        }
+        if (trace_capacity != 0){
+            traces.assign(num_chains, TraceBuffer<REAL, num_params>(trace_capacity, trace_mode));
+        }
+        accepted_steps.assign(num_chains, 0);
+        full_evaluations.assign(num_chains, 0);
+        iterations_run.assign(num_chains, 0);
+        diagnostics.assign(num_chains, BatchMeans<REAL, num_params>());
+        minibatch_variance_sums.assign(num_chains, 0);
+        minibatch_estimates.assign(num_chains, 0);
+        minibatch_likelihood.reset();
+        if (minibatch_size != 0){
+            if (uses_delayed_acceptance()){
+                throw std::logic_error("Error - The minibatch likelihood cannot be combined with delayed acceptance.");
+            }
+            minibatch_likelihood.emplace(this -> make_minibatch_likelihood(minibatch_size, minibatch_reference));
+        }
+        if (screening_subset_size != 0){
+            if (screening_subset_size >= this -> observations.num_points){
+                throw std::domain_error("Error - The screening subset must be smaller than the number of observations.");
+            }
+            screening_rows.resize(this -> observations.num_points);
+            std::iota(screening_rows.begin(), screening_rows.end(), 0);
+            std::shuffle(screening_rows.begin(), screening_rows.end(), Xoshiro256(42));
+            screening_rows.resize(screening_subset_size);
+            std::sort(screening_rows.begin(), screening_rows.end());
+            screening_log_likelihood = [this](std::array<REAL, num_params> &params){
+                return this -> subset_log_likelihood(params, screening_rows);
+            };
+        }
+        if (num_chains == 1){
+            ChainMoments moments;
+            run_chain(0, Xoshiro256(42), this -> marginal_distribution, moments);
+        }
+        else{
+            if (this -> uses_checkpoints()){
+                throw std::logic_error("Error - Checkpoints are only available for a single chain.");
+            }
+            uint number_bins = this -> get_bins();
+            std::vector<std::vector<std::vector<REAL>>> chain_marginals(num_chains, std::vector<std::vector<REAL>>(num_params, std::vector<REAL>(number_bins, 0)));
+            std::vector<ChainMoments> chain_moments(num_chains);
+            std::vector<Xoshiro256> generators = Xoshiro256::streams(42, num_chains);
+            ThreadPool pool(num_chains);
+            pool.parallel_for(num_chains, [&](uint, std::uint64_t chain){
+                run_chain(static_cast<uint>(chain), generators[chain], chain_marginals[chain], chain_moments[chain]);
+            });
+            for (uint chain = 0; chain < num_chains; chain++){
+                for (std::size_t i = 0; i < num_params; i++){
+                    for (uint k = 0; k < number_bins; k++){
+                        this -> marginal_distribution[i][k] += chain_marginals[chain][i][k];
+                    }
+                }
+            }
+            set_r_hat(chain_moments);
+        }
+        store_chain_diagnostics();
+        this -> normalise_marginal_distribution(); //normalise and add conditions to extra setting map. Used add tags to he plot filenames.
+        this -> been_sampled = true;
+        this -> finish_checkpoints();
+        std::map<std::string, std::string> settings = {{"step_size", findsigfig<REAL>(step_size)},{"N_sample",std::to_string(num_sample_points)}};
+        if (num_chains > 1){
+            settings["chains"] = std::to_string(num_chains);
+        }
+        if (adaptation_iterations != 0){
+            settings["adapt"] = std::to_string(adaptation_iterations);
+        }
+        if (minibatch_size != 0){
+            settings["minibatch"] = std::to_string(minibatch_size);
+        }
+        if (target_effective_sample_size != 0){
+            settings["ESS"] = findsigfig<REAL>(target_effective_sample_size);
+        }
+        this -> set_extra_settings(settings);
+    }
+
+    /**
+     * @brief Sets the number of independent chains. Every chain takes the full number of sample points from its own seed: chain m draws from Xoshiro256::stream(42, m), so chain 0 matches the single chain and runs are reproducible.
+     * @param chains: Number of chains, each run on its own thread.
+    */
+    void set_num_chains(uint chains){
+        if (chains == 0){
+            throw std::domain_error("Error - Number of chains cannot be 0.");
+        }
+        num_chains = chains;
+    }
+    uint get_num_chains() const {
+        return num_chains;
+    }
+
+    /**
+     * @brief Adaptive Metropolis: over the first adaptation_iterations iterations of every chain the proposal covariance is learnt from a running covariance of the chain's positions in the unit hypercube,
+     * refactorised with a Cholesky decomposition every 100 iterations, and its overall scale is tuned by Robbins-Monro steps towards an acceptance rate of 0.234. The proposal is then frozen
+     * for the rest of the chain. Correlated parameters, such as the coefficients of the cubic, are then explored along their correlations rather than with small isotropic steps.
+     * Until enough positions have been seen the step is isotropic with standard deviation step_size.
+     * @param adaptation_iterations: Number of iterations over which the proposal adapts, usually the burn in.
+    */
+    void use_adaptive_proposal(uint adaptation_iterations){
+        if (adaptation_iterations == 0){
+            throw std::domain_error("Error - Number of adaptation iterations cannot be 0.");
+        }
+        this -> adaptation_iterations = adaptation_iterations;
+    }
+    bool uses_adaptive_proposal() const {
+        return adaptation_iterations != 0;
+    }
+
+    /**
+     * @brief Delayed acceptance: every proposal is first accepted or rejected with the Metropolis Hastings criterion on a cheap screening log likelihood, and only those that pass are evaluated
+     * with the full log likelihood, which accepts them with probability min(1, exp(full ratio - screening ratio)). The second stage corrects the first, so the chain still targets the full
+     * posterior exactly; the closer the screen is to the full likelihood the fewer proposals that pass it are rejected.
+     * @param screening: Approximation to the full log likelihood, e.g. a surrogate model.
+    */
+    void use_delayed_acceptance(const std::function<REAL(std::array<REAL, num_params>&)> &screening){
+        if (!screening){
+            throw std::domain_error("Error - The screening log likelihood must be callable.");
+        }
+        screening_log_likelihood = screening;
+        screening_subset_size = 0;
+    }
+
+    /**
+     * @brief Delayed acceptance screening with the log likelihood of a fixed random subset of the observations, drawn with seed 42 when sampling starts. The subset likelihood is not scaled up to the
+     * full data set: its posterior is then wider than the full one and covers it, so the screen rejects proposals far from the bulk without turning away good ones. Scaled up, a subset's posterior is as narrow
+     * as the full one but centred elsewhere and the chain mixes badly.
+     * @param subset_size: Number of observations in the subset, fewer than in the data file.
+    */
+    void use_delayed_acceptance(uint subset_size){
+        if (subset_size == 0){
+            throw std::domain_error("Error - The screening subset cannot be empty.");
+        }
+        screening_subset_size = subset_size;
+        screening_log_likelihood = nullptr;
+    }
+    bool uses_delayed_acceptance() const {
+        return screening_subset_size != 0 || screening_log_likelihood;
+    }
+
+    /**
+     * @brief Approximate likelihood mode for very large data sets: every step estimates the log likelihood ratio of the proposal from batch_size observations drawn at random, with control variates
+     * from the model linearised around a reference point (see MinibatchLikelihood), so a step costs O(batch_size) model evaluations however many observations there are. The estimate is noisy, so the
+     * proposal is accepted with the penalty method of Ceperley and Dewing, on the estimate less half its variance, which keeps detailed balance when the noise is Gaussian with a known variance.
+     * Here the variance is itself estimated from the same minibatch, so the chain only samples the posterior approximately, with an error that shrinks with the variance. This works well while the
+     * variance stays around 1 or less, see get_minibatch_variance; a larger minibatch or a reference closer to the posterior lowers it. Needs the gradient model, and the log likelihoods recorded in traces
+     * are those of the linearised model. The linearisation is stored for every observation, (num_params + 1) values each, see MinibatchLikelihood. Cannot be combined with delayed acceptance.
+     * @param batch_size: Number of observations in every minibatch, at least 2 and fewer than in the data file.
+     * @param reference: Point the model is linearised around. (optional: default = the least squares fit inside the parameter ranges, found when sampling starts)
+    */
+    void use_minibatch_likelihood(uint batch_size, std::optional<std::array<REAL, num_params>> reference = std::nullopt){
+        if (batch_size < 2){
+            throw std::domain_error("Error - The minibatch must hold at least 2 observations.");
+        }
+        minibatch_size = batch_size;
+        minibatch_reference = reference;
+    }
+    bool uses_minibatch_likelihood() const {
+        return minibatch_size != 0;
+    }
+
+    /**
+     * @brief: Mean variance of the minibatch estimates of the log likelihood ratio over the iterations of the last sample after the burn in and adaptation, 0 unless the minibatch likelihood is used.
+     * The walk in from the starting point, far from the reference point, is left out as its estimates are much noisier.
+    */
+    REAL get_minibatch_variance() const {
+        std::uint64_t iterations = std::accumulate(minibatch_estimates.begin(), minibatch_estimates.end(), std::uint64_t(0));
+        return iterations == 0 ? 0 : static_cast<REAL>(std::accumulate(minibatch_variance_sums.begin(), minibatch_variance_sums.end(), 0.0) / iterations);
+    }
+
+    /**
+     * @brief: Reference point the minibatch likelihood of the last sample was linearised around.
+    */
+    const std::array<REAL, num_params>& get_minibatch_reference() const {
+        if (!minibatch_likelihood){
+            throw std::logic_error("Error - The minibatch likelihood has not been used. Call use_minibatch_likelihood before sample.");
+        }
+        return minibatch_likelihood -> get_reference();
+    }
+
+    /**
+     * @brief Ends every chain once the effective sample size of each parameter, estimated by batch means over the draws after any adaptation, reaches the target. sample_points becomes the most
+     * iterations a chain may take. The rule is checked every few thousand iterations. With several chains each chain stops on its own once it reaches target / number of chains, as the effective
+     * sample sizes of independent chains add up, so the result still does not depend on the number of threads.
+     * @param target: Effective sample size wanted for every parameter.
+    */
+    void stop_at_effective_sample_size(REAL target){
+        if (!(target > 0)){
+            throw std::domain_error("Error - The target effective sample size must be positive.");
+        }
+        target_effective_sample_size = target;
+    }
+
+    /**
+     * @brief Ends every chain once the Monte Carlo standard error of the mean of each parameter is below its target, in the units of the parameter. With several chains each chain stops
+     * once its own standard error is below target * sqrt(number of chains). Can be combined with stop_at_effective_sample_size, in which case both must hold.
+     * @param targets: Standard error wanted on the mean of every parameter.
+    */
+    void stop_at_standard_errors(const std::array<REAL, num_params> &targets){
+        for (REAL target: targets){
+            if (!(target > 0)){
+                throw std::domain_error("Error - The target standard errors must be positive.");
+            }
+        }
+        target_standard_errors = targets;
+    }
+    bool uses_early_stopping() const {
+        return target_effective_sample_size != 0 || target_standard_errors;
+    }
+
+    /**
+     * @brief: Number of iterations run by every chain of the last sample together, less than the number of sample points times the number of chains if the chains stopped early.
+    */
+    std::uint64_t get_num_iterations() const {
+        return std::accumulate(iterations_run.begin(), iterations_run.end(), std::uint64_t(0));
+    }
+
+    /**
+     * @brief: Effective sample size of every parameter over all chains of the last sample, the sum of those of the chains.
+    */
+    std::array<REAL, num_params> get_effective_sample_sizes() const {
+        std::array<REAL, num_params> sizes{};
+        for (const BatchMeans<REAL, num_params> &chain_diagnostics: diagnostics){
+            std::array<REAL, num_params> chain_sizes = chain_diagnostics.effective_sample_sizes();
+            for (std::size_t i = 0; i < num_params; i++){
+                sizes[i] += chain_sizes[i];
+            }
+        }
+        return sizes;
+    }
+
+    /**
+     * @brief: Integrated autocorrelation time of every parameter over all chains of the last sample, the number of draws per effective sample.
+    */
+    std::array<REAL, num_params> get_autocorrelation_times() const {
+        std::array<REAL, num_params> times = get_effective_sample_sizes();
+        std::uint64_t draws = 0;
+        for (const BatchMeans<REAL, num_params> &chain_diagnostics: diagnostics){
+            draws += chain_diagnostics.get_count();
+        }
+        for (std::size_t i = 0; i < num_params; i++){
+            times[i] = times[i] > 0 ? draws / times[i] : (draws > 1 ? std::numeric_limits<REAL>::infinity() : 0);
+        }
+        return times;
+    }
+
+    /**
+     * @brief: Monte Carlo standard error of the mean of every parameter over all chains of the last sample, taking the result as the average of the chain means.
+    */
+    std::array<REAL, num_params> get_standard_errors() const {
+        std::array<REAL, num_params> errors{};
+        for (const BatchMeans<REAL, num_params> &chain_diagnostics: diagnostics){
+            std::array<REAL, num_params> chain_errors = chain_diagnostics.standard_errors();
+            for (std::size_t i = 0; i < num_params; i++){
+                errors[i] += chain_errors[i] * chain_errors[i];
+            }
+        }
+        for (std::size_t i = 0; i < num_params; i++){
+            errors[i] = std::sqrt(errors[i]) / diagnostics.size();
+        }
+        return errors;
+    }
+
+    /**
+     * @brief: Number of full log likelihood evaluations made by the iterations of every chain of the last sample, one per iteration unless delayed acceptance or the minibatch likelihood is used.
+    */
+    std::uint64_t get_num_full_evaluations() const {
+        return std::accumulate(full_evaluations.begin(), full_evaluations.end(), std::uint64_t(0));
+    }
+
+    /**
+     * @brief: Number of proposals rejected by the delayed acceptance screen, each one a full log likelihood evaluation saved.
+    */
+    std::uint64_t get_num_screened_out() const {
+        return uses_delayed_acceptance() ? get_num_iterations() - get_num_full_evaluations() : 0;
+    }
+
+    /**
+     * @brief: Fraction of proposed steps that were accepted, over every chain of the last sample.
+    */
+    REAL get_acceptance_rate() const {
+        std::uint64_t accepted = std::accumulate(accepted_steps.begin(), accepted_steps.end(), std::uint64_t(0));
+        std::uint64_t proposed = get_num_iterations();
+        return proposed == 0 ? 0 : static_cast<REAL>(accepted) / proposed;
+    }
+
+    /**
+     * @brief Keeps the position and log likelihood of every chain after each iteration, starting with the initial point, in a buffer allocated before sampling so memory stays flat however long the run.
+     * @param capacity: Number of points kept per chain.
+     * @param mode: TraceMode::ring keeps the most recent points, TraceMode::fixed the first ones. (optional: default = TraceMode::ring)
+    */
+    void enable_trace(std::size_t capacity, TraceMode mode = TraceMode::ring){
+        if (capacity == 0){
+            throw std::domain_error("Error - Trace capacity cannot be 0.");
+        }
+        trace_capacity = capacity;
+        trace_mode = mode;
+    }
+    bool uses_trace() const {
+        return trace_capacity != 0;
+    }
+
+    /**
+     * @brief Discards the first draws of every chain, the random starting point being draw 0 and iteration j giving draw j + 1, so the walk from the starting point towards the bulk of the
+     * posterior is not counted into the histograms, traces or diagnostics. sample() throws if the burn in is not shorter than the number of sample points.
+     * @param draws: Number of draws discarded. (default = 0)
+    */
+    void set_burn_in(uint draws){
+        burn_in = draws;
+    }
+    uint get_burn_in() const {
+        return burn_in;
+    }
+
+    /**
+     * @brief Keeps only every thinning-th draw after the burn in, which shrinks traces of strongly correlated chains with little loss of information.
+     * @param thinning: Interval between kept draws. (default = 1)
+    */
+    void set_thinning(uint thinning){
+        if (thinning == 0){
+            throw std::domain_error("Error - Thinning cannot be 0.");
+        }
+        this -> thinning = thinning;
+    }
+    uint get_thinning() const {
+        return thinning;
+    }
+
+    /**
+     * @brief Streams the kept draws of every chain and their log likelihoods to a binary trace file while sampling, written by a background thread so the chain does not wait on the disk.
+     * The file can be read with MappedTrace. With several chains chain m writes to filepath + "." + m. A checkpointed chain cuts its trace file back to the last checkpoint when it resumes.
+     * @param filepath: Trace file, replaced if it exists.
+    */
+    void stream_trace(const std::string &filepath){
+        if (filepath.empty()){
+            throw std::domain_error("Error - The trace file path cannot be empty.");
+        }
+        trace_stream_path = filepath;
+    }
+    bool uses_trace_stream() const {
+        return !trace_stream_path.empty();
+    }
+
+    /**
+     * @brief: Trace file written by the given chain.
+    */
+    std::string get_trace_stream_path(uint chain = 0) const {
+        return num_chains == 1 ? trace_stream_path : trace_stream_path + "." + std::to_string(chain);
+    }
+
+    /**
+     * @brief: Trace of the given chain, filled by sample.
+    */
+    const TraceBuffer<REAL, num_params>& get_trace(uint chain = 0) const {
+        if (chain >= traces.size()){
+            throw std::logic_error("Error - No trace has been recorded for this chain. Call enable_trace before sample.");
+        }
+        return traces[chain];
+    }
+
+    private:
+    uint num_sample_points;
+    REAL step_size;
+    uint num_chains = 1;
+    uint adaptation_iterations = 0;
+    std::vector<std::uint64_t> accepted_steps; // per chain
+    std::vector<std::uint64_t> full_evaluations; // per chain
+    std::vector<std::uint64_t> iterations_run; // per chain
+    std::vector<BatchMeans<REAL, num_params>> diagnostics; // per chain, of the draws after adaptation
+    REAL target_effective_sample_size = 0;
+    std::optional<std::array<REAL, num_params>> target_standard_errors;
+    std::function<REAL(std::array<REAL, num_params>&)> screening_log_likelihood;
+    uint screening_subset_size = 0;
+    std::vector<uint> screening_rows;
+    uint minibatch_size = 0;
+    std::optional<std::array<REAL, num_params>> minibatch_reference;
+    std::optional<MinibatchLikelihood<REAL, num_params>> minibatch_likelihood;
+    std::vector<double> minibatch_variance_sums; // per chain, over the iterations after the burn in and adaptation
+    std::vector<std::uint64_t> minibatch_estimates; // per chain
+    uint burn_in = 0;
+    uint thinning = 1;
+    std::string trace_stream_path;
+    std::size_t trace_capacity = 0;
+    TraceMode trace_mode = TraceMode::ring;
+    std::vector<TraceBuffer<REAL, num_params>> traces;
+
+    /**
+     * @brief: Running mean and sum of squared deviations (Welford) of every parameter over the second half of a chain, used for R-hat.
+    */
+    struct ChainMoments{
+        std::uint64_t count = 0;
+        std::array<double, num_params> mean{};
+        std::array<double, num_params> sum_squares{};
+
+        void add(const std::array<REAL, num_params> &params){
+            count++;
+            for (std::size_t i = 0; i < num_params; i++){
+                double delta = params[i] - mean[i];
+                mean[i] += delta / count;
+                sum_squares[i] += delta * (params[i] - mean[i]);
+            }
+        }
+    };
+
+    static constexpr uint convergence_check_interval = 4096; // kept draws between checks of the early stopping rule
+    static constexpr uint adaptation_start = 500; // positions seen before the learnt covariance replaces the isotropic step
+    static constexpr uint adaptation_update_interval = 100; // iterations between Cholesky refactorisations
+    static constexpr double target_acceptance = 0.234;
+
+    /**
+     * @brief: State of the adaptive proposal of one chain: the running mean and scatter matrix of the positions (Welford), the lower triangular Cholesky factor of the proposal covariance and the log of its scale.
+    */
+    struct AdaptiveProposal{
+        std::uint64_t count = 0;
+        std::array<double, num_params> mean{};
+        std::array<std::array<double, num_params>, num_params> scatter{};
+        std::array<std::array<REAL, num_params>, num_params> cholesky{};
+        double log_scale = 0;
+        bool learnt = false;
+
+        explicit AdaptiveProposal(REAL step_size = 0){
+            for (std::size_t i = 0; i < num_params; i++){
+                cholesky[i][i] = step_size;
+            }
+        }
+
+        void add(const std::array<REAL, num_params> &position){
+            count++;
+            std::array<double, num_params> delta;
+            for (std::size_t i = 0; i < num_params; i++){
+                delta[i] = position[i] - mean[i];
+                mean[i] += delta[i] / count;
+            }
+            for (std::size_t i = 0; i < num_params; i++){
+                for (std::size_t k = 0; k <= i; k++){
+                    scatter[i][k] += delta[i] * (position[k] - mean[k]);
+                }
+            }
+        }
+
+        /**
+         * @brief: Replaces the Cholesky factor with that of the sample covariance plus a small ridge, keeping the old factor if the covariance is not positive definite.
+        */
+        void factorise(){
+            std::array<std::array<REAL, num_params>, num_params> factor{};
+            for (std::size_t i = 0; i < num_params; i++){
+                for (std::size_t k = 0; k <= i; k++){
+                    double sum = scatter[i][k] / (count - 1) + (i == k ? 1e-10 : 0);
+                    for (std::size_t l = 0; l < k; l++){
+                        sum -= static_cast<double>(factor[i][l]) * factor[k][l];
+                    }
+                    if (i == k){
+                        if (!(sum > 0)){
+                            return;
+                        }
+                        factor[i][i] = static_cast<REAL>(std::sqrt(sum));
+                    }
+                    else{
+                        factor[i][k] = static_cast<REAL>(sum / factor[k][k]);
+                    }
+                }
+            }
+            cholesky = factor;
+            if (!learnt){
+                log_scale = std::log(2.38 / std::sqrt(static_cast<double>(num_params))); // optimal scale for a Gaussian target
+                learnt = true;
+            }
+        }
+
+        /**
+         * @brief: Robbins-Monro update of the scale after iteration iteration was accepted or rejected.
+        */
+        void adapt_scale(uint iteration, bool accepted){
+            log_scale += std::pow(iteration + 1.0, -0.6) * ((accepted ? 1.0 : 0.0) - target_acceptance);
+        }
+
+        std::array<REAL, num_params> step(const std::array<REAL, num_params> &standard_normals) const {
+            std::array<REAL, num_params> result{};
+            REAL scale = static_cast<REAL>(std::exp(log_scale));
+            for (std::size_t i = 0; i < num_params; i++){
+                for (std::size_t k = 0; k <= i; k++){
+                    result[i] += cholesky[i][k] * standard_normals[k];
+                }
+                result[i] *= scale;
+            }
+            return result;
+        }
+    };
+
+    /**
+     * @brief Runs one chain. Only chain 0 reads and writes checkpoints.
+     * @param chain: Index of the chain.
+     * @param generator: The chain's generator, Xoshiro256::stream(42, chain), seeded at 42 to keep results consistent and reproducible.
+     * @param marginal: Histograms the chain's positions are counted into.
+     * @param moments: Moments of the second half of the chain.
+    */
+    void run_chain(uint chain, Xoshiro256 generator, std::vector<std::vector<REAL>> &marginal, ChainMoments &moments){
         const std::array<ParamInfo<REAL>, num_params>& params_info = this -> get_params_info();
-        std::default_random_engine generator(42); //initiating generator with random seed 42 to keep results consistent and reproductable.
         std::array<REAL, num_params> unit_hypercube;
         std::array<REAL, num_params> new_unit_hypercube;
         std::array<REAL, num_params> params;
         std::array<REAL, num_params> new_params;
         uint number_bins = this -> get_bins();
-        std::uniform_real_distribution<REAL> initial_dist(0, 1);
-        std::normal_distribution<REAL> step_dist(0, step_size);
+        NormalBlock<REAL> normals;
+        AdaptiveProposal proposal(step_size);
+        std::array<REAL, num_params> step;
         
         uint bin_number;
         REAL lg_likelihood;
+        REAL current_log_likelihood;
+        REAL new_screening_log_likelihood = 0;
+        REAL current_screening_log_likelihood = 0;
+        TraceBuffer<REAL, num_params> *trace = traces.empty() ? nullptr : &traces[chain];
+        std::unique_ptr<TraceWriter<REAL, num_params>> stream;
+        std::uint64_t streamed_points = 0;
+        uint first_iteration = 0;
+        const uint moments_start = uses_early_stopping() ? adaptation_iterations : num_sample_points / 2; // the first half is treated as warm up, unless the chain may stop early
+        const bool checkpointed = chain == 0 && this -> uses_checkpoints(); // sample() only allows checkpoints with a single chain
 
-        for (std::size_t i = 0; i < num_params; i++){
-            unit_hypercube[i] = initial_dist(generator);
-            params[i] = params_info[i].min + unit_hypercube[i] * params_info[i].width;
-                      
-            bin_number = static_cast<uint>(std::floor(unit_hypercube[i] * number_bins));
+        bool resume = checkpointed && this -> checkpoint_exists();
+        if (checkpointed){
+            this -> resumed = resume;
+        }
+        if (resume){
+            first_iteration = read_chain_checkpoint(unit_hypercube, current_log_likelihood, current_screening_log_likelihood, generator, normals, trace, proposal, streamed_points);
+            for (std::size_t i = 0; i < num_params; i++){
+                params[i] = params_info[i].min + unit_hypercube[i] * params_info[i].width;
+            }
+        }
+        if (uses_trace_stream()){
+            stream = std::make_unique<TraceWriter<REAL, num_params>>(get_trace_stream_path(chain), thinning, resume ? std::optional<std::uint64_t>(streamed_points) : std::nullopt);
+        }
+        if (!resume){
+            for (std::size_t i = 0; i < num_params; i++){
+                unit_hypercube[i] = unit_uniform<REAL>(generator);
+                params[i] = params_info[i].min + unit_hypercube[i] * params_info[i].width;
+            }
             
-            this -> marginal_distribution[i][bin_number]++;
+            current_log_likelihood = minibatch_likelihood ? minibatch_likelihood -> approximate_log_likelihood(params) : this -> log_likelihood(params);
+            if (screening_log_likelihood){
+                current_screening_log_likelihood = screening_log_likelihood(params);
+            }
+            if (is_kept(0)){
+                for (std::size_t i = 0; i < num_params; i++){
+                    bin_number = static_cast<uint>(std::floor(unit_hypercube[i] * number_bins));
+                    marginal[i][bin_number]++;
+                }
+                if (trace){
+                    trace -> record(params, current_log_likelihood);
+                }
+                if (stream){
+                    stream -> record(params, current_log_likelihood);
+                }
+            }
+        }
+        if (checkpointed){
+            this -> checkpoint_schedule.reset(first_iteration);
         }
         
-        this -> parameter_likelihood[params] = this -> log_likelihood(params);
-        
-        for (uint j = 0; j < num_sample_points; j++){
+        for (uint j = first_iteration; j < num_sample_points; j++){
+            if (checkpointed && j % checkpoint_poll_interval == 0 && j != first_iteration && this -> checkpoint_schedule.due(j)){
+                write_chain_checkpoint(j, unit_hypercube, current_log_likelihood, current_screening_log_likelihood, generator, normals, trace, proposal, stream.get());
+                this -> checkpoint_schedule.reset(j);
+                CheckpointSchedule::stop_if_requested(this -> checkpoint_file);
+            }
+            if (adaptation_iterations != 0){
+                for (std::size_t i = 0; i < num_params; i++){
+                    step[i] = normals(generator);
+                }
+                step = proposal.step(step);
+            }
+            else{
+                for (std::size_t i = 0; i < num_params; i++){
+                    step[i] = step_size * normals(generator);
+                }
+            }
             for (std::size_t i = 0; i < num_params; i++){
-                new_unit_hypercube[i] = unit_hypercube[i] + step_dist(generator);
-                if (new_unit_hypercube[i] > 1){ //boundary conditions of unit hypercube applied here
+                new_unit_hypercube[i] = unit_hypercube[i] + step[i];
+                while (new_unit_hypercube[i] > 1){ //boundary conditions of unit hypercube applied here. A learnt step can be wider than the hypercube.
                     new_unit_hypercube[i]--;
                 }
-                else if (new_unit_hypercube[i] < 0){
+                while (new_unit_hypercube[i] < 0){
                     new_unit_hypercube[i]++;
                 }
                 new_params[i] = params_info[i].min + new_unit_hypercube[i] * params_info[i].width;
             }
 
             //use acceptance criterion
-            lg_likelihood = this -> log_likelihood(new_params);
-            if (lg_likelihood >= this -> parameter_likelihood[params]){
+            bool accepted;
+            if (screening_log_likelihood){ // delayed acceptance: the screen decides first and the full likelihood corrects its decision
+                new_screening_log_likelihood = screening_log_likelihood(new_params);
+                REAL screening_ratio = new_screening_log_likelihood - current_screening_log_likelihood;
+                accepted = screening_ratio >= 0 || screening_ratio > std::log(unit_uniform<REAL>(generator));
+                if (accepted){
+                    lg_likelihood = this -> log_likelihood(new_params);
+                    full_evaluations[chain]++;
+                    REAL correction = lg_likelihood - current_log_likelihood - screening_ratio;
+                    accepted = correction >= 0 || correction > std::log(unit_uniform<REAL>(generator));
+                }
+            }
+            else if (minibatch_likelihood){ // noisy estimate of the log likelihood ratio, penalised by half its variance
+                REAL variance;
+                REAL penalised_ratio = minibatch_likelihood -> estimate_difference(params, new_params, generator, variance);
+                penalised_ratio -= variance / 2;
+                if (j >= adaptation_iterations && j >= burn_in){
+                    minibatch_variance_sums[chain] += variance;
+                    minibatch_estimates[chain]++;
+                }
+                accepted = penalised_ratio >= 0 || penalised_ratio > std::log(unit_uniform<REAL>(generator));
+                lg_likelihood = minibatch_likelihood -> approximate_log_likelihood(new_params);
+            }
+            else{
+                lg_likelihood = this -> log_likelihood(new_params);
+                full_evaluations[chain]++;
+                accepted = lg_likelihood >= current_log_likelihood || (lg_likelihood - current_log_likelihood) > std::log(unit_uniform<REAL>(generator)); // second acceptance criterion
+            }
+            if (accepted){
                 params = new_params;
                 unit_hypercube = new_unit_hypercube;
-                this -> parameter_likelihood[new_params] = lg_likelihood;
-                
+                current_log_likelihood = lg_likelihood;
+                current_screening_log_likelihood = new_screening_log_likelihood;
+                accepted_steps[chain]++;
             }
-            else{           // second acceptance criterion
-                if ((lg_likelihood - this -> parameter_likelihood[params]) > std::log(initial_dist(generator))){
-                    params = new_params;
-                    unit_hypercube = new_unit_hypercube;
-                    this -> parameter_likelihood[new_params] = lg_likelihood;
-                    
-                }
-                else{
-                    new_params = params; // reject
-                    new_unit_hypercube = unit_hypercube;
+            if (j < adaptation_iterations){
+                proposal.adapt_scale(j, accepted);
+                proposal.add(unit_hypercube);
+                if (proposal.count >= adaptation_start && (j + 1) % adaptation_update_interval == 0){
+                    proposal.factorise();
                 }
             }
+            iterations_run[chain] = j + 1;
+            if (!is_kept(j + 1)){
+                continue;
+            }
             for (std::size_t i = 0; i < num_params; i++){
                 bin_number = static_cast<uint>(std::floor(unit_hypercube[i] * number_bins));
-                this -> marginal_distribution[i][bin_number]++;
+                marginal[i][bin_number]++;
+            }
+            if (trace){
+                trace -> record(params, current_log_likelihood);
+            }
+            if (stream){
+                stream -> record(params, current_log_likelihood);
+            }
+            if (j >= moments_start){
+                moments.add(params);
+            }
+            if (j >= adaptation_iterations){
+                diagnostics[chain].add(params);
+                if (uses_early_stopping() && diagnostics[chain].get_count() % convergence_check_interval == 0 && has_converged(diagnostics[chain])){
+                    break;
+                }
             }
         }
-        this -> normalise_marginal_distribution(); //normalise and add conditions to extra setting map. Used add tags to he plot filenames.
-        this -> been_sampled = true;
-        this -> set_extra_settings({{"step_size", findsigfig<REAL>(step_size)},{"N_sample",std::to_string(num_sample_points)}});
+        if (stream){
+            stream -> close();
+        }
     }
 
-    private:
-    uint num_sample_points;
-    REAL step_size;
+    /**
+     * @brief: Whether draw draw, 0 being the starting point, is kept after the burn in and thinning.
+    */
+    bool is_kept(std::uint64_t draw) const {
+        return draw >= burn_in && (draw - burn_in) % thinning == 0;
+    }
+
+    /**
+     * @brief: Whether the draws of one chain meet the early stopping rule, with the targets shared out between the chains.
+    */
+    bool has_converged(const BatchMeans<REAL, num_params> &chain_diagnostics) const {
+        if (!chain_diagnostics.ready()){
+            return false;
+        }
+        if (target_effective_sample_size != 0){
+            std::array<REAL, num_params> sizes = chain_diagnostics.effective_sample_sizes();
+            for (std::size_t i = 0; i < num_params; i++){
+                if (sizes[i] < target_effective_sample_size / num_chains){
+                    return false;
+                }
+            }
+        }
+        if (target_standard_errors){
+            std::array<REAL, num_params> errors = chain_diagnostics.standard_errors();
+            for (std::size_t i = 0; i < num_params; i++){
+                if (errors[i] > target_standard_errors.value()[i] * std::sqrt(static_cast<REAL>(num_chains))){
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief: Stores the pooled diagnostics in the ParamInfo of every parameter and the acceptance rate for summarise.
+    */
+    void store_chain_diagnostics(){
+        std::array<REAL, num_params> sizes = get_effective_sample_sizes();
+        std::array<REAL, num_params> times = get_autocorrelation_times();
+        std::array<REAL, num_params> errors = get_standard_errors();
+        for (std::size_t i = 0; i < num_params; i++){
+            Sampler<REAL, num_params>::set_chain_diagnostics(i, sizes[i], times[i], errors[i]);
+        }
+        this -> acceptance_rate = get_acceptance_rate();
+    }
+
+    /**
+     * @brief Gelman-Rubin potential scale reduction factor of every parameter from the second halves of the chains, or with early stopping from the draws after adaptation, R-hat = sqrt(((n - 1)/n W + B/n) / W) where W is the mean within chain variance
+     * and B/n the variance of the chain means. Values close to 1 mean the chains agree; above about 1.1 they have not converged. Chains that never move (W = 0) give infinity if they sit at
+     * different values and 1 if they all sit at the same one.
+    */
+    void set_r_hat(const std::vector<ChainMoments> &chain_moments){
+        double n = static_cast<double>(std::min_element(chain_moments.begin(), chain_moments.end(), [](const ChainMoments &a, const ChainMoments &b){ return a.count < b.count; }) -> count);
+        double m = static_cast<double>(chain_moments.size());
+        if (n < 2){
+            return;
+        }
+        for (std::size_t i = 0; i < num_params; i++){
+            double grand_mean = 0;
+            double within = 0;
+            for (const ChainMoments &moments: chain_moments){
+                grand_mean += moments.mean[i] / m;
+                within += moments.sum_squares[i] / (moments.count - 1) / m;
+            }
+            double between_over_n = 0;
+            for (const ChainMoments &moments: chain_moments){
+                between_over_n += (moments.mean[i] - grand_mean) * (moments.mean[i] - grand_mean) / (m - 1);
+            }
+            if (within == 0){
+                this -> set_r_hat_value(i, between_over_n > 0 ? std::numeric_limits<REAL>::infinity() : 1);
+                continue;
+            }
+            this -> set_r_hat_value(i, static_cast<REAL>(std::sqrt(((n - 1) / n * within + between_over_n) / within)));
+        }
+    }
+    static constexpr uint checkpoint_poll_interval = 1024; // iterations between checks of the checkpoint schedule
+
+    /**
+     * @brief: Writes a checkpoint holding the chain state before iteration next_iteration. The generator and the normal block, including its unused values, are written as raw values so the chain resumes exactly.
+     * The trace, if there is one, follows as its capacity, mode, number of points recorded and raw storage, then the accepted step count, the adaptive proposal state, the delayed acceptance state, the batch means diagnostics, the burn in and thinning, the number of points in the trace file
+     * and the minibatch size, reference point and summed variance of the estimates.
+    */
+    void write_chain_checkpoint(uint next_iteration, const std::array<REAL, num_params> &unit_hypercube, REAL current_log_likelihood, REAL current_screening_log_likelihood, const Xoshiro256 &generator,
+                                const NormalBlock<REAL> &normals, const TraceBuffer<REAL, num_params> *trace, const AdaptiveProposal &proposal, TraceWriter<REAL, num_params> *stream) const {
+        binary_io::write_file_atomically(this -> checkpoint_file, [&](std::ofstream &file){
+            this -> write_checkpoint_header(file, Sampler<REAL, num_params>::chain_checkpoint);
+            binary_io::write_value(file, step_size);
+            binary_io::write_value(file, next_iteration);
+            binary_io::write_value(file, unit_hypercube);
+            binary_io::write_value(file, current_log_likelihood);
+            binary_io::write_value(file, generator);
+            binary_io::write_value(file, normals);
+            binary_io::write_value<std::uint64_t>(file, trace ? trace -> capacity() : 0);
+            if (trace){
+                binary_io::write_value<std::uint32_t>(file, static_cast<std::uint32_t>(trace -> get_mode()));
+                binary_io::write_value<std::uint64_t>(file, trace -> total_recorded());
+                binary_io::write_values(file, trace -> storage());
+            }
+            binary_io::write_value<std::uint64_t>(file, accepted_steps[0]);
+            binary_io::write_value<std::uint32_t>(file, adaptation_iterations);
+            if (adaptation_iterations != 0){
+                binary_io::write_value(file, proposal);
+            }
+            binary_io::write_value<std::uint32_t>(file, uses_delayed_acceptance());
+            binary_io::write_value<std::uint32_t>(file, screening_subset_size);
+            binary_io::write_value(file, current_screening_log_likelihood);
+            binary_io::write_value<std::uint64_t>(file, full_evaluations[0]);
+            binary_io::write_value(file, diagnostics[0]);
+            binary_io::write_value<std::uint32_t>(file, burn_in);
+            binary_io::write_value<std::uint32_t>(file, thinning);
+            if (stream){
+                stream -> flush(); // the points counted here must be on disk before the checkpoint is
+            }
+            binary_io::write_value<std::uint32_t>(file, stream != nullptr);
+            binary_io::write_value<std::uint64_t>(file, stream ? stream -> size() : 0);
+            binary_io::write_value<std::uint32_t>(file, minibatch_size);
+            if (minibatch_likelihood){
+                binary_io::write_value(file, minibatch_likelihood -> get_reference());
+                binary_io::write_value(file, minibatch_variance_sums[0]);
+                binary_io::write_value<std::uint64_t>(file, minibatch_estimates[0]);
+            }
+        });
+    }
+
+    /**
+     * @brief: Restores the chain state from the checkpoint file.
+     * @return: The iteration to continue from.
+    */
+    uint read_chain_checkpoint(std::array<REAL, num_params> &unit_hypercube, REAL &current_log_likelihood, REAL &current_screening_log_likelihood, Xoshiro256 &generator, NormalBlock<REAL> &normals,
+                               TraceBuffer<REAL, num_params> *trace, AdaptiveProposal &proposal, std::uint64_t &streamed_points){
+        std::ifstream file(this -> checkpoint_file, std::ios::binary);
+        this -> read_checkpoint_header(file, Sampler<REAL, num_params>::chain_checkpoint);
+        if (binary_io::read_value<REAL>(file) != step_size){
+            throw std::runtime_error("Error - Checkpoint file " + this -> checkpoint_file + " was written with a different step size.");
+        }
+        uint next_iteration = binary_io::read_value<uint>(file);
+        unit_hypercube = binary_io::read_value<std::array<REAL, num_params>>(file);
+        current_log_likelihood = binary_io::read_value<REAL>(file);
+        generator = binary_io::read_value<Xoshiro256>(file);
+        normals = binary_io::read_value<NormalBlock<REAL>>(file);
+        if (binary_io::read_value<std::uint64_t>(file) != (trace ? trace -> capacity() : 0)
+            || (trace && binary_io::read_value<std::uint32_t>(file) != static_cast<std::uint32_t>(trace -> get_mode()))){
+            throw std::runtime_error("Error - Checkpoint file " + this -> checkpoint_file + " was written with different trace settings.");
+        }
+        if (trace){
+            trace -> set_total_recorded(binary_io::read_value<std::uint64_t>(file));
+            binary_io::read_values(file, trace -> storage());
+        }
+        accepted_steps[0] = binary_io::read_value<std::uint64_t>(file);
+        if (binary_io::read_value<std::uint32_t>(file) != adaptation_iterations){
+            throw std::runtime_error("Error - Checkpoint file " + this -> checkpoint_file + " was written with different adaptive proposal settings.");
+        }
+        if (adaptation_iterations != 0){
+            proposal = binary_io::read_value<AdaptiveProposal>(file);
+        }
+        if (binary_io::read_value<std::uint32_t>(file) != uses_delayed_acceptance() || binary_io::read_value<std::uint32_t>(file) != screening_subset_size){
+            throw std::runtime_error("Error - Checkpoint file " + this -> checkpoint_file + " was written with different delayed acceptance settings.");
+        }
+        current_screening_log_likelihood = binary_io::read_value<REAL>(file);
+        full_evaluations[0] = binary_io::read_value<std::uint64_t>(file);
+        diagnostics[0] = binary_io::read_value<BatchMeans<REAL, num_params>>(file);
+        if (binary_io::read_value<std::uint32_t>(file) != burn_in || binary_io::read_value<std::uint32_t>(file) != thinning || binary_io::read_value<std::uint32_t>(file) != uses_trace_stream()){
+            throw std::runtime_error("Error - Checkpoint file " + this -> checkpoint_file + " was written with different burn in, thinning or trace file settings.");
+        }
+        streamed_points = binary_io::read_value<std::uint64_t>(file);
+        if (binary_io::read_value<std::uint32_t>(file) != minibatch_size
+            || (minibatch_likelihood && binary_io::read_value<std::array<REAL, num_params>>(file) != minibatch_likelihood -> get_reference())){
+            throw std::runtime_error("Error - Checkpoint file " + this -> checkpoint_file + " was written with different minibatch likelihood settings.");
+        }
+        if (minibatch_likelihood){
+            minibatch_variance_sums[0] = binary_io::read_value<double>(file);
+            minibatch_estimates[0] = binary_io::read_value<std::uint64_t>(file);
+        }
+        if (!file){
+            throw std::runtime_error("Error - Checkpoint file " + this -> checkpoint_file + " is truncated.");
+        }
+        return next_iteration;
+    }
 };
\ No newline at end of file
@@ -0,0 +1,234 @@
+#pragma once
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <type_traits>
+
+/**
+ * @brief Small expression template language for model functions whose type is known at compile time, for Sampler::set_compiled_model. An expression is built from the input x, the parameters
+ * param<j>, numbers, + - * /, pow, exp and log, e.g. param<0> * pow(x, param<1>), and every expression is a functor REAL operator()(REAL x, const std::array<REAL, n> &params) const.
+ * The whole expression is one type, so the compiler inlines it into the likelihood loop. It works for any REAL with the operations it uses, so the same expression also serves as the interval
+ * and gradient model, e.g. set_interval_model(model) and set_gradient_model(model), and as the model function of a sampler.
+*/
+namespace model_expression{
+
+/**
+ * @brief: Base of every expression node, used to tell expressions apart from other types in the operators below.
+*/
+template<typename Derived>
+struct Expression{};
+
+template<typename T>
+constexpr bool is_expression = std::is_base_of_v<Expression<T>, T>;
+
+struct Input : Expression<Input>
+{
+    template<typename REAL, std::size_t num_params>
+    REAL operator()(REAL x, const std::array<REAL, num_params> &) const {
+        return x;
+    }
+};
+
+template<std::size_t index>
+struct Param : Expression<Param<index>>
+{
+    template<typename REAL, std::size_t num_params>
+    REAL operator()(REAL, const std::array<REAL, num_params> &params) const {
+        static_assert(index < num_params, "Parameter index out of range for the number of parameters of the sampler.");
+        return params[index];
+    }
+};
+
+struct Constant : Expression<Constant>
+{
+    double value;
+    constexpr explicit Constant(double value) : value(value) {}
+    template<typename REAL, std::size_t num_params>
+    REAL operator()(REAL, const std::array<REAL, num_params> &) const {
+        return static_cast<REAL>(value);
+    }
+};
+
+struct Add{
+    template<typename REAL>
+    static REAL apply(REAL left, REAL right){ return left + right; }
+};
+struct Subtract{
+    template<typename REAL>
+    static REAL apply(REAL left, REAL right){ return left - right; }
+};
+struct Multiply{
+    template<typename REAL>
+    static REAL apply(REAL left, REAL right){ return left * right; }
+};
+struct Divide{
+    template<typename REAL>
+    static REAL apply(REAL left, REAL right){ return left / right; }
+};
+
+/**
+ * @brief: Arithmetic operation of two expressions.
+*/
+template<typename Operation, typename Left, typename Right>
+struct BinaryNode : Expression<BinaryNode<Operation, Left, Right>>
+{
+    Left left;
+    Right right;
+    constexpr BinaryNode(Left left, Right right) : left(left), right(right) {}
+    template<typename REAL, std::size_t num_params>
+    REAL operator()(REAL x, const std::array<REAL, num_params> &params) const {
+        return Operation::apply(left(x, params), right(x, params));
+    }
+};
+
+template<typename Operand>
+struct Negation : Expression<Negation<Operand>>
+{
+    Operand operand;
+    constexpr explicit Negation(Operand operand) : operand(operand) {}
+    template<typename REAL, std::size_t num_params>
+    REAL operator()(REAL x, const std::array<REAL, num_params> &params) const {
+        return -operand(x, params);
+    }
+};
+
+/**
+ * @brief: base^exponent for a whole number exponent known at compile time, as a chain of multiplications.
+*/
+template<int exponent, typename Base>
+struct IntegerPower : Expression<IntegerPower<exponent, Base>>
+{
+    static_assert(exponent >= 1, "Whole number powers need an exponent of at least 1.");
+    Base base;
+    constexpr explicit IntegerPower(Base base) : base(base) {}
+    template<typename REAL, std::size_t num_params>
+    REAL operator()(REAL x, const std::array<REAL, num_params> &params) const {
+        REAL value = base(x, params);
+        REAL result = value;
+        for (int k = 1; k < exponent; k++){
+            result = result * value;
+        }
+        return result;
+    }
+};
+
+// pow, exp and log are called unqualified so that argument dependent lookup picks up the overloads of non built in REAL types such as Interval and Dual.
+template<typename Base, typename Exponent>
+struct Power : Expression<Power<Base, Exponent>>
+{
+    Base base;
+    Exponent exponent;
+    constexpr Power(Base base, Exponent exponent) : base(base), exponent(exponent) {}
+    template<typename REAL, std::size_t num_params>
+    REAL operator()(REAL x, const std::array<REAL, num_params> &params) const {
+        using std::pow;
+        return pow(base(x, params), exponent(x, params));
+    }
+};
+
+template<typename Operand>
+struct Exponential : Expression<Exponential<Operand>>
+{
+    Operand operand;
+    constexpr explicit Exponential(Operand operand) : operand(operand) {}
+    template<typename REAL, std::size_t num_params>
+    REAL operator()(REAL x, const std::array<REAL, num_params> &params) const {
+        using std::exp;
+        return exp(operand(x, params));
+    }
+};
+
+template<typename Operand>
+struct Logarithm : Expression<Logarithm<Operand>>
+{
+    Operand operand;
+    constexpr explicit Logarithm(Operand operand) : operand(operand) {}
+    template<typename REAL, std::size_t num_params>
+    REAL operator()(REAL x, const std::array<REAL, num_params> &params) const {
+        using std::log;
+        return log(operand(x, params));
+    }
+};
+
+/**
+ * @brief: Numbers in an expression become constants, expressions stay as they are.
+*/
+template<typename T>
+constexpr auto as_expression(T value){
+    if constexpr (is_expression<T>){
+        return value;
+    }
+    else{
+        return Constant(static_cast<double>(value));
+    }
+}
+
+template<typename Operation, typename Left, typename Right>
+constexpr BinaryNode<Operation, Left, Right> make_binary(Left left, Right right){
+    return BinaryNode<Operation, Left, Right>(left, right);
+}
+
+template<typename T>
+constexpr bool is_operand = is_expression<T> || std::is_arithmetic_v<T>;
+
+template<typename Left, typename Right>
+using enable_if_operands = std::enable_if_t<is_operand<Left> && is_operand<Right> && (is_expression<Left> || is_expression<Right>)>;
+
+template<typename Left, typename Right, typename = enable_if_operands<Left, Right>>
+constexpr auto operator+(Left left, Right right){
+    return make_binary<Add>(as_expression(left), as_expression(right));
+}
+
+template<typename Left, typename Right, typename = enable_if_operands<Left, Right>>
+constexpr auto operator-(Left left, Right right){
+    return make_binary<Subtract>(as_expression(left), as_expression(right));
+}
+
+template<typename Left, typename Right, typename = enable_if_operands<Left, Right>>
+constexpr auto operator*(Left left, Right right){
+    return make_binary<Multiply>(as_expression(left), as_expression(right));
+}
+
+template<typename Left, typename Right, typename = enable_if_operands<Left, Right>>
+constexpr auto operator/(Left left, Right right){
+    return make_binary<Divide>(as_expression(left), as_expression(right));
+}
+
+template<typename Operand, typename = std::enable_if_t<is_expression<Operand>>>
+constexpr auto operator-(Operand operand){
+    return Negation(operand);
+}
+
+template<int exponent, typename Base, typename = std::enable_if_t<is_expression<Base>>>
+constexpr auto pow(Base base){
+    return IntegerPower<exponent, Base>(base);
+}
+
+template<typename Base, typename Exponent, typename = enable_if_operands<Base, Exponent>>
+constexpr auto pow(Base base, Exponent exponent){
+    return Power(as_expression(base), as_expression(exponent));
+}
+
+template<typename Operand, typename = std::enable_if_t<is_expression<Operand>>>
+constexpr auto exp(Operand operand){
+    return Exponential(operand);
+}
+
+template<typename Operand, typename = std::enable_if_t<is_expression<Operand>>>
+constexpr auto log(Operand operand){
+    return Logarithm(operand);
+}
+
+inline constexpr Input x{};
+
+template<std::size_t index>
+inline constexpr Param<index> param{};
+
+/**
+ * @brief Expression forms of the models in ModelFunctions.hpp, written with the same order of operations so they give the same results.
+*/
+inline constexpr auto power_law_model = param<0> * pow(x, param<1>); // param_2_model_func
+inline constexpr auto straight_line_model = param<0> * x + param<1>; // param_test_model_func
+inline constexpr auto polynomial_model = param<0> * x * x * x + param<1> * x * x + param<2> * x + param<3>; // polynomial
+
+}
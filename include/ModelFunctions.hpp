@@ -1,8 +1,12 @@
 #pragma once
 #include <array>
+#include <functional>
+#include "StagedModel.hpp"
 
 /**
  * @brief All the functions declared below are model functions that are passed into the derived classes. The data can be fit to certain relationships here.
+ * The model functions are also instantiated for Interval<double> and Interval<float> (Interval.hpp) to bound their output over a box of parameters,
+ * and for Dual<double, n> and Dual<float, n> (Dual.hpp) with n their number of parameters to differentiate them.
 */
 
 
@@ -22,4 +26,28 @@ template <typename REAL>
 REAL gaussian_func(REAL x, REAL sigma, REAL mean);
 
 template <typename REAL>
-REAL polynomial(REAL x, std::array<REAL, 4> &params);
\ No newline at end of file
+REAL polynomial(REAL x, std::array<REAL, 4> &params);
+
+/**
+ * @brief Basis functions of the models above that are linear in their parameters. Entry j multiplies params[j] so the sum over the basis reproduces the model function.
+ * Used to opt in to the sufficient statistics likelihood engine with Sampler::set_linear_model.
+*/
+
+template <typename REAL>
+std::array<std::function<REAL(REAL)>, 2> param_test_basis();
+
+template <typename REAL>
+std::array<std::function<REAL(REAL)>, 3> param_3_test_basis();
+
+template <typename REAL>
+std::array<std::function<REAL(REAL)>, 4> polynomial_basis();
+
+/**
+ * @brief Staged forms of the models above for Sampler::set_staged_model. Each reproduces the model function exactly while caching everything that does not depend on its inner parameter.
+*/
+
+template <typename REAL>
+StagedModel<REAL, 2> param_2_staged_model(); // caches x^b, inner parameter a
+
+template <typename REAL>
+StagedModel<REAL, 4> polynomial_staged_model(); // caches ax^3 + bx^2 + cx, inner parameter d
@@ -0,0 +1,343 @@
+#pragma once
+#include "Sampler.hpp"
+#include "ThreadPool.hpp"
+#include "Random.hpp"
+#include <algorithm>
+#include <numeric>
+#include <limits>
+
+/**
+ * @brief Derived class template from base abstract class template that samples with Skilling's nested sampling, which gives the Bayesian evidence Z = integral of L over the prior and the posterior in one pass.
+ * A set of live points is drawn from the uniform prior over the parameter space. The live point with the lowest likelihood is repeatedly removed as a dead point and replaced by a new point drawn
+ * from the prior above its likelihood, so the prior volume enclosed by the live points shrinks by about a factor exp(-1/num_live_points) every iteration. Each dead point is weighted by the prior
+ * volume it accounts for; the weights sum to the evidence and, times the likelihood, give posterior weights that are binned into the marginal distribution.
+ * New points are found by a random walk from a surviving live point constrained to the current likelihood threshold. With a batch size of k the k lowest points are removed together, the volume
+ * shrinking by exp(-1/n), exp(-1/(n - 1)), ..., and their k replacements are drawn in parallel, each from its own random stream, so the result depends on the batch size but not on the number of threads.
+ * The log likelihood leaves out the constant -sum log(sigma sqrt(2 pi)), which is the same for every model of the same data, so differences of log evidence between models are exact.
+ *
+ * @tparam REAL: type representing real numbers; usually float or double.
+ *
+ * @tparam num_params: number of parameters that are being used to fit the model.
+*/
+template<typename REAL, std::size_t num_params>
+class NestedSampler : public Sampler<REAL, num_params>{
+    public:
+    /**
+     * @brief Dead point, or final live point, with the log of its share of the prior volume and its normalised posterior weight.
+    */
+    struct WeightedSample{
+        std::array<REAL, num_params> params;
+        REAL log_likelihood;
+        double log_prior_volume;
+        double posterior_weight = 0;
+    };
+
+    /**
+     * @brief Constructor for NestedSampler. Calls the constructor of base abstract sampler class.
+     * @param filepath: Filepath of the data that is fitted to the provided function.
+     * @param func: Function that is used to fit the data. Takes the independent variable and parameter array.
+     * @param names: The names of each of the parameters.
+     * @param min_values: The minimum value of each parameter in the space, the lower edge of the uniform prior.
+     * @param max_values: The maximum value of each parameter in the space, the upper edge of the uniform prior.
+     * @param num_live_points: Number of live points. The error of the log evidence falls as 1/sqrt(num_live_points). (optional: default = 500)
+     * @param tolerance: Sampling stops once the live points could raise the log evidence by less than this. (optional: default = 0.01)
+     * @param max_iterations: Most dead points taken before stopping regardless. (optional: default = 1,000,000)
+     * @param num_bins: The number of bins used to sample each parameter. (optional: default = 100)
+     * @param rigidity: The flexibility of the Observations object when it reads data. (optional: default = false)
+    */
+    NestedSampler(const std::string &filepath, const std::function<REAL(REAL,std::array<REAL,num_params>&)> &func,
+    std::array<std::string,num_params> names, std::array<REAL,num_params> min_values, std::array<REAL, num_params> max_values,
+    uint num_live_points = 500, REAL tolerance = 0.01, uint max_iterations = 1000000,
+    uint num_bins = 100, const bool rigidity = false) : Sampler<REAL, num_params>(filepath, func, names, min_values, max_values, num_bins, rigidity)
+    {
+        if (num_live_points < 2){
+            throw std::domain_error("Error - Nested sampling needs at least 2 live points.");
+        }
+        if (!(tolerance > 0)){
+            throw std::domain_error("Error - The evidence tolerance must be positive.");
+        }
+        this -> num_live_points = num_live_points;
+        this -> tolerance = tolerance;
+        this -> max_iterations = max_iterations;
+    }
+
+    /**
+     * @brief: Runs nested sampling until the evidence left in the live points falls below the tolerance, then adds the live points as the final dead points. The live points start at
+     * uniformly random positions from Xoshiro256::stream(42, batch size) and replacement k of every batch draws from stream k.
+    */
+    void sample() override {
+        if (this -> been_sampled){
+            throw std::logic_error("Error - Procedure aborted as this NestedSampler instance has already sampled the data points.");
+        }
+        if (this -> uses_checkpoints()){
+            throw std::logic_error("Error - Checkpoints are not available for nested sampling.");
+        }
+        const std::array<ParamInfo<REAL>, num_params>& params_info = this -> get_params_info();
+        std::vector<LivePoint> live(num_live_points);
+        std::vector<Xoshiro256> generators = Xoshiro256::streams(42, batch_size + 1); // one per replacement of a batch and the last for the initial live points
+        Xoshiro256 initial_generator = generators.back();
+        for (LivePoint &point: live){
+            for (std::size_t i = 0; i < num_params; i++){
+                point.unit_hypercube[i] = unit_uniform<REAL>(initial_generator);
+            }
+            point.params = to_params(point.unit_hypercube, params_info);
+        }
+        ThreadPool pool(std::min(num_threads, batch_size));
+        pool.parallel_for(num_live_points, [&](uint, std::uint64_t k){
+            live[k].log_likelihood = this -> log_likelihood(live[k].params);
+        });
+        likelihood_evaluations = num_live_points;
+
+        std::vector<Walker> walkers(batch_size);
+        for (uint k = 0; k < batch_size; k++){
+            walkers[k].generator = generators[k];
+        }
+        samples.clear();
+        log_evidence = -std::numeric_limits<double>::infinity();
+        information = 0;
+        double log_volume = 0;
+        double walk_scale = 1;
+        std::vector<std::size_t> order(num_live_points);
+        iterations = 0;
+        while (iterations < max_iterations){
+            double max_log_likelihood = std::max_element(live.begin(), live.end(), [](const LivePoint &a, const LivePoint &b){ return a.log_likelihood < b.log_likelihood; }) -> log_likelihood;
+            if (std::isfinite(log_evidence) && log_add_exp(log_evidence, max_log_likelihood + log_volume) - log_evidence < tolerance){
+                break;
+            }
+            std::iota(order.begin(), order.end(), 0);
+            std::partial_sort(order.begin(), order.begin() + batch_size, order.end(), [&](std::size_t a, std::size_t b){ return live[a].log_likelihood < live[b].log_likelihood; });
+            for (uint k = 0; k < batch_size; k++){ // live points left when point k is removed: num_live_points - k
+                double shrinkage = 1.0 / (num_live_points - k);
+                add_dead_point(live[order[k]], log_volume + std::log1p(-std::exp(-shrinkage)));
+                log_volume -= shrinkage;
+            }
+            REAL threshold = live[order[batch_size - 1]].log_likelihood;
+            std::array<REAL, num_params> spread = survivor_spread(live, order);
+            pool.parallel_for(batch_size, [&](uint, std::uint64_t k){
+                Walker &walker = walkers[k];
+                std::size_t start = order[batch_size + std::min<std::size_t>(static_cast<std::size_t>(unit_uniform<REAL>(walker.generator) * (num_live_points - batch_size)), num_live_points - batch_size - 1)];
+                live[order[k]] = constrained_walk(live[start], threshold, spread, walk_scale, walker, params_info);
+            });
+            std::uint64_t accepted = 0;
+            std::uint64_t proposed = 0;
+            for (Walker &walker: walkers){
+                accepted += walker.accepted;
+                proposed += walker.proposed;
+                likelihood_evaluations += walker.evaluations;
+                walker.accepted = walker.proposed = walker.evaluations = 0;
+            }
+            walk_scale *= std::exp((static_cast<double>(accepted) / proposed - target_walk_acceptance) / num_params); // keeps about half the walk steps accepted
+            iterations += batch_size;
+        }
+        std::sort(live.begin(), live.end(), [](const LivePoint &a, const LivePoint &b){ return a.log_likelihood < b.log_likelihood; });
+        for (const LivePoint &point: live){ // the remaining volume is shared equally between the live points
+            add_dead_point(point, log_volume - std::log(static_cast<double>(num_live_points)));
+        }
+
+        uint number_bins = this -> get_bins();
+        for (WeightedSample &sample: samples){
+            sample.posterior_weight = std::exp(sample.log_likelihood + sample.log_prior_volume - log_evidence);
+            for (std::size_t i = 0; i < num_params; i++){
+                REAL unit_position = (sample.params[i] - params_info[i].min) / params_info[i].width;
+                uint bin_number = std::min(static_cast<uint>(std::floor(unit_position * number_bins)), number_bins - 1);
+                this -> marginal_distribution[i][bin_number] += sample.posterior_weight;
+            }
+        }
+        this -> normalise_marginal_distribution();
+        this -> been_sampled = true;
+        this -> set_extra_settings({{"live", std::to_string(num_live_points)}, {"NS", "batch_" + std::to_string(batch_size)}});
+    }
+
+    /**
+     * @brief Sets the number of lowest live points removed together and replaced in parallel. Larger batches give more parallel work per iteration; the evidence stays unbiased but its error grows
+     * slightly once the batch is a sizeable fraction of the live points.
+     * @param batch: Points replaced per iteration, fewer than half the live points. (default = 1)
+    */
+    void set_batch_size(uint batch){
+        if (batch == 0 || 2 * batch > num_live_points){
+            throw std::domain_error("Error - The batch size must be at least 1 and at most half the number of live points.");
+        }
+        batch_size = batch;
+    }
+    uint get_batch_size() const {
+        return batch_size;
+    }
+
+    /**
+     * @brief Sets the number of threads the replacements of a batch are spread across.
+     * @param threads: Number of threads. (default = 1)
+    */
+    void set_num_threads(uint threads){
+        if (threads == 0){
+            throw std::domain_error("Error - Number of threads cannot be 0.");
+        }
+        num_threads = threads;
+    }
+    uint get_num_threads() const {
+        return num_threads;
+    }
+
+    /**
+     * @brief Sets the number of steps of the constrained random walk that draws each new live point. More steps decorrelate the new point from its starting point better.
+     * @param steps: Number of steps. (default = 25)
+    */
+    void set_walk_steps(uint steps){
+        if (steps == 0){
+            throw std::domain_error("Error - The number of walk steps cannot be 0.");
+        }
+        walk_steps = steps;
+    }
+
+    /**
+     * @brief: Natural log of the evidence of the last sample, relative to the uniform prior over the parameter space.
+    */
+    double get_log_evidence() const {
+        return log_evidence;
+    }
+
+    /**
+     * @brief: Standard error of the log evidence, sqrt(H / num_live_points) where H is the information.
+    */
+    double get_log_evidence_error() const {
+        return std::sqrt(std::max(information, 0.0) / num_live_points);
+    }
+
+    /**
+     * @brief: Information H, the Kullback-Leibler divergence from the prior to the posterior in nats.
+    */
+    double get_information() const {
+        return information;
+    }
+    std::uint64_t get_num_iterations() const {
+        return iterations;
+    }
+    std::uint64_t get_num_likelihood_evaluations() const {
+        return likelihood_evaluations;
+    }
+
+    /**
+     * @brief: Dead points of the last sample followed by the final live points, in order of increasing likelihood, with their posterior weights, which sum to 1.
+    */
+    const std::vector<WeightedSample>& get_posterior_samples() const {
+        return samples;
+    }
+
+    private:
+    uint num_live_points;
+    REAL tolerance;
+    uint max_iterations;
+    uint batch_size = 1;
+    uint num_threads = 1;
+    uint walk_steps = 25;
+    static constexpr double target_walk_acceptance = 0.5;
+    std::uint64_t iterations = 0;
+    std::uint64_t likelihood_evaluations = 0;
+    double log_evidence = 0;
+    double information = 0;
+    std::vector<WeightedSample> samples;
+
+    struct LivePoint{
+        std::array<REAL, num_params> unit_hypercube;
+        std::array<REAL, num_params> params;
+        REAL log_likelihood = 0;
+    };
+
+    /**
+     * @brief: Random stream and counters of one replacement slot of a batch.
+    */
+    struct Walker{
+        Xoshiro256 generator;
+        NormalBlock<REAL> normals;
+        std::uint64_t accepted = 0;
+        std::uint64_t proposed = 0;
+        std::uint64_t evaluations = 0;
+    };
+
+    static std::array<REAL, num_params> to_params(const std::array<REAL, num_params> &unit_hypercube, const std::array<ParamInfo<REAL>, num_params>& params_info){
+        std::array<REAL, num_params> params;
+        for (std::size_t i = 0; i < num_params; i++){
+            params[i] = params_info[i].min + unit_hypercube[i] * params_info[i].width;
+        }
+        return params;
+    }
+
+    static double log_add_exp(double a, double b){
+        if (a < b){
+            std::swap(a, b);
+        }
+        return std::isinf(a) && a < 0 ? a : a + std::log1p(std::exp(b - a));
+    }
+
+    /**
+     * @brief: Adds a dead point to the evidence and to the information H with Skilling's running update, H = sum of (w L / Z) log(L / Z).
+    */
+    void add_dead_point(const LivePoint &point, double log_prior_volume){
+        double log_weight = log_prior_volume + point.log_likelihood;
+        double new_log_evidence = log_add_exp(log_evidence, log_weight);
+        if (std::isinf(log_evidence)){
+            information = point.log_likelihood - new_log_evidence;
+        }
+        else{
+            information = std::exp(log_weight - new_log_evidence) * point.log_likelihood + std::exp(log_evidence - new_log_evidence) * (information + log_evidence) - new_log_evidence;
+        }
+        log_evidence = new_log_evidence;
+        samples.push_back({point.params, point.log_likelihood, log_prior_volume});
+    }
+
+    /**
+     * @brief: Standard deviation of the surviving live points along every axis of the unit hypercube, which sets the length of the walk steps.
+    */
+    std::array<REAL, num_params> survivor_spread(const std::vector<LivePoint> &live, const std::vector<std::size_t> &order) const {
+        std::array<double, num_params> mean{};
+        std::array<double, num_params> sum_squares{};
+        std::uint64_t count = 0;
+        for (std::size_t k = batch_size; k < order.size(); k++){
+            count++;
+            for (std::size_t i = 0; i < num_params; i++){
+                double delta = live[order[k]].unit_hypercube[i] - mean[i];
+                mean[i] += delta / count;
+                sum_squares[i] += delta * (live[order[k]].unit_hypercube[i] - mean[i]);
+            }
+        }
+        std::array<REAL, num_params> spread;
+        for (std::size_t i = 0; i < num_params; i++){
+            spread[i] = static_cast<REAL>(count > 1 ? std::sqrt(sum_squares[i] / (count - 1)) : 0.1);
+        }
+        return spread;
+    }
+
+    /**
+     * @brief Draws a new live point by a random walk from start that only moves to points inside the parameter space with a log likelihood above threshold. The walk takes walk_steps steps
+     * and continues, up to a hundred times as long, until it has moved at least once.
+     * @param start: Surviving live point the walk starts from.
+     * @param threshold: Log likelihood of the highest point removed.
+     * @param spread: Spread of the live points along every axis of the unit hypercube.
+     * @param scale: Step length relative to the spread.
+     * @param walker: Random stream and counters of this replacement.
+    */
+    LivePoint constrained_walk(const LivePoint &start, REAL threshold, const std::array<REAL, num_params> &spread, double scale, Walker &walker, const std::array<ParamInfo<REAL>, num_params>& params_info){
+        LivePoint point = start;
+        std::uint64_t moves = 0;
+        for (uint step = 0; step < walk_steps || (moves == 0 && step < 100 * walk_steps); step++){
+            walker.proposed++;
+            LivePoint proposal;
+            bool inside = true;
+            for (std::size_t i = 0; i < num_params; i++){
+                proposal.unit_hypercube[i] = point.unit_hypercube[i] + static_cast<REAL>(scale) * spread[i] * walker.normals(walker.generator);
+                inside = inside && proposal.unit_hypercube[i] >= 0 && proposal.unit_hypercube[i] < 1;
+            }
+            if (!inside){
+                continue;
+            }
+            proposal.params = to_params(proposal.unit_hypercube, params_info);
+            proposal.log_likelihood = this -> log_likelihood(proposal.params);
+            walker.evaluations++;
+            if (proposal.log_likelihood > threshold){
+                point = proposal;
+                walker.accepted++;
+                moves++;
+            }
+        }
+        return point;
+    }
+};
@@ -15,6 +15,7 @@ public:
     std::vector<REAL> inputs;
     std::vector<REAL> outputs;
     std::vector<REAL> sigmas;
+    std::vector<REAL> inverse_double_variances; // 1 / (2 sigma^2) of every point, cached when the data is loaded so the likelihood multiplies rather than divides.
 
     /**
      * @brief Member function used to load data from file into Observation class.
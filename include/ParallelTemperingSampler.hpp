@@ -0,0 +1,205 @@
+#pragma once
+#include "Sampler.hpp"
+#include "ThreadPool.hpp"
+#include "Random.hpp"
+
+/**
+ * @brief Derived class template from base abstract class template that samples with parallel tempering (replica exchange). A ladder of Metropolis Hastings chains runs at geometrically spaced
+ * temperatures, each chain targeting the likelihood raised to the power 1/T. Hot chains move freely across the parameter space and pass what they find down the ladder through swaps of the
+ * positions of neighbouring chains, so the T = 1 chain mixes between modes and into narrow peaks that a single chain rarely reaches. Only the T = 1 chain is counted into the marginal distribution.
+ * The chains advance in parallel for swap_interval iterations between rounds of swaps, so the results do not depend on the number of threads.
+ *
+ * @tparam REAL: type representing real numbers; usually float or double.
+ *
+ * @tparam num_params: number of parameters that are being used to fit the model.
+*/
+template<typename REAL, std::size_t num_params>
+class ParallelTemperingSampler : public Sampler<REAL, num_params>{
+    public:
+    /**
+     * @brief Constructor for ParallelTemperingSampler. Calls the constructor of base abstract sampler class.
+     * @param filepath: Filepath of the data that is fitted to the provided function.
+     * @param func: Function that is used to fit the data. Takes the independent variable and parameter array.
+     * @param names: The names of each of the parameters.
+     * @param min_values: The minimum value of each parameter in the space.
+     * @param max_values: The maximum value of each parameter in the space.
+     * @param sample_points: The number of iterations of every chain.
+     * @param step_s: Standard deviation of the steps of the T = 1 chain in the unit hypercube. A chain at temperature T steps sqrt(T) times further.
+     * @param num_temperatures: Number of chains in the temperature ladder. (optional: default = 4)
+     * @param max_temperature: Temperature of the hottest chain. (optional: default = 100)
+     * @param swap_interval: Iterations between rounds of swaps. (optional: default = 100)
+     * @param num_bins: The number of bins used to sample each parameter. (optional: default = 100)
+     * @param rigidity: The flexibility of the Observations object when it reads data. (optional: default = false)
+    */
+    ParallelTemperingSampler(const std::string &filepath, const std::function<REAL(REAL,std::array<REAL,num_params>&)> &func,
+    std::array<std::string,num_params> names, std::array<REAL,num_params> min_values, std::array<REAL, num_params> max_values,
+    uint sample_points = 100000, REAL step_s = 0.01, uint num_temperatures = 4, REAL max_temperature = 100, uint swap_interval = 100,
+    uint num_bins = 100, const bool rigidity = false) : Sampler<REAL, num_params>(filepath, func, names, min_values, max_values, num_bins, rigidity)
+    {
+        if (num_temperatures < 2){
+            throw std::domain_error("Error - Parallel tempering needs at least 2 temperatures.");
+        }
+        if (!(max_temperature > 1)){
+            throw std::domain_error("Error - The maximum temperature must be greater than 1.");
+        }
+        if (swap_interval == 0){
+            throw std::domain_error("Error - The swap interval cannot be 0.");
+        }
+        if (static_cast<std::uint64_t>(sample_points) * num_temperatures > 1000000000){
+            std::cerr << "Warning: The number of points to be sampled over all temperatures exceeds 1,000,000,000. This amount is excessively high and may take a while. Please make sure you want to keep sampling!" << std::endl;
+        }
+        num_sample_points = sample_points;
+        step_size = step_s;
+        this -> swap_interval = swap_interval;
+        for (uint k = 0; k < num_temperatures; k++){
+            temperatures.push_back(std::pow(max_temperature, static_cast<REAL>(k) / (num_temperatures - 1)));
+        }
+        num_threads = num_temperatures;
+    }
+
+    /**
+     * @brief: Runs the temperature ladder. Chain k draws from Xoshiro256::stream(42, k) and the swaps, which alternate between the even and odd neighbouring pairs, from the next stream.
+     * A swap of the chains at inverse temperatures b_i and b_j is accepted with probability min(1, exp((b_i - b_j)(L_j - L_i))) where L is the log likelihood of each chain's position.
+    */
+    void sample() override {
+        if (this -> been_sampled){
+            throw std::logic_error("Error - Procedure aborted as this ParallelTemperingSampler instance has already sampled the data points.");
+        }
+        if (this -> uses_checkpoints()){
+            throw std::logic_error("Error - Checkpoints are not available for parallel tempering.");
+        }
+        const std::array<ParamInfo<REAL>, num_params>& params_info = this -> get_params_info();
+        uint number_bins = this -> get_bins();
+        std::vector<Replica> replicas(temperatures.size());
+        std::vector<Xoshiro256> generators = Xoshiro256::streams(42, replicas.size() + 1); // the last stream is for the swaps
+        for (uint k = 0; k < replicas.size(); k++){
+            Replica &replica = replicas[k];
+            replica.generator = generators[k];
+            replica.inverse_temperature = 1 / temperatures[k];
+            replica.step_scale = step_size * std::sqrt(temperatures[k]);
+            for (std::size_t i = 0; i < num_params; i++){
+                replica.unit_hypercube[i] = unit_uniform<REAL>(replica.generator);
+                replica.params[i] = params_info[i].min + replica.unit_hypercube[i] * params_info[i].width;
+            }
+            replica.log_likelihood = this -> log_likelihood(replica.params);
+        }
+        add_to_marginals(replicas[0], number_bins);
+
+        swap_attempts.assign(temperatures.size() - 1, 0);
+        swap_accepts.assign(temperatures.size() - 1, 0);
+        Xoshiro256 swap_generator = generators.back();
+        ThreadPool pool(std::min<uint>(num_threads, temperatures.size()));
+        for (uint first_iteration = 0, round = 0; first_iteration < num_sample_points; first_iteration += swap_interval, round++){
+            uint iterations = std::min(swap_interval, num_sample_points - first_iteration);
+            pool.parallel_for(replicas.size(), [&](uint, std::uint64_t k){
+                advance_replica(replicas[k], iterations, k == 0, number_bins);
+            });
+            for (std::size_t k = round % 2; k + 1 < replicas.size(); k += 2){
+                swap_attempts[k]++;
+                REAL log_ratio = (replicas[k].inverse_temperature - replicas[k + 1].inverse_temperature) * (replicas[k + 1].log_likelihood - replicas[k].log_likelihood);
+                if (log_ratio >= 0 || log_ratio > std::log(unit_uniform<REAL>(swap_generator))){
+                    std::swap(replicas[k].unit_hypercube, replicas[k + 1].unit_hypercube);
+                    std::swap(replicas[k].params, replicas[k + 1].params);
+                    std::swap(replicas[k].log_likelihood, replicas[k + 1].log_likelihood);
+                    swap_accepts[k]++;
+                }
+            }
+        }
+        this -> normalise_marginal_distribution();
+        this -> been_sampled = true;
+        this -> set_extra_settings({{"step_size", findsigfig<REAL>(step_size)}, {"N_sample", std::to_string(num_sample_points)},
+                                    {"temps", std::to_string(temperatures.size())}, {"Tmax", findsigfig<REAL>(temperatures.back())}});
+    }
+
+    /**
+     * @brief Sets the number of threads the chains are spread across. By default every chain has its own thread.
+     * @param threads: Number of threads.
+    */
+    void set_num_threads(uint threads){
+        if (threads == 0){
+            throw std::domain_error("Error - Number of threads cannot be 0.");
+        }
+        num_threads = threads;
+    }
+    uint get_num_threads() const {
+        return num_threads;
+    }
+    const std::vector<REAL>& get_temperatures() const {
+        return temperatures;
+    }
+
+    /**
+     * @brief: Fraction of the attempted swaps between the chains at temperatures k and k + 1 that were accepted, for every k. Rates near 0 mean the ladder needs more temperatures.
+    */
+    std::vector<REAL> get_swap_acceptance_rates() const {
+        std::vector<REAL> rates;
+        for (std::size_t k = 0; k < swap_attempts.size(); k++){
+            rates.push_back(swap_attempts[k] == 0 ? 0 : static_cast<REAL>(swap_accepts[k]) / swap_attempts[k]);
+        }
+        return rates;
+    }
+
+    private:
+    uint num_sample_points;
+    REAL step_size;
+    uint swap_interval;
+    uint num_threads;
+    std::vector<REAL> temperatures;
+    std::vector<std::uint64_t> swap_attempts;
+    std::vector<std::uint64_t> swap_accepts;
+
+    /**
+     * @brief: One chain of the ladder. Swaps exchange the positions and log likelihoods of two chains; the engine, temperature and step stay with the chain.
+    */
+    struct Replica{
+        Xoshiro256 generator;
+        NormalBlock<REAL> normals;
+        REAL step_scale = 0;
+        REAL inverse_temperature = 1;
+        std::array<REAL, num_params> unit_hypercube;
+        std::array<REAL, num_params> params;
+        REAL log_likelihood = 0;
+    };
+
+    /**
+     * @brief Runs iterations Metropolis Hastings steps of one chain on the tempered likelihood.
+     * @param replica: The chain.
+     * @param iterations: Number of steps.
+     * @param count: true for the T = 1 chain, whose positions are counted into the marginal distribution.
+     * @param number_bins: Number of bins of each histogram.
+    */
+    void advance_replica(Replica &replica, uint iterations, bool count, uint number_bins){
+        const std::array<ParamInfo<REAL>, num_params>& params_info = this -> get_params_info();
+        std::array<REAL, num_params> new_unit_hypercube;
+        std::array<REAL, num_params> new_params;
+        for (uint j = 0; j < iterations; j++){
+            for (std::size_t i = 0; i < num_params; i++){
+                new_unit_hypercube[i] = replica.unit_hypercube[i] + replica.step_scale * replica.normals(replica.generator);
+                while (new_unit_hypercube[i] > 1){ //boundary conditions of unit hypercube applied here. Hot chains can step further than the hypercube.
+                    new_unit_hypercube[i]--;
+                }
+                while (new_unit_hypercube[i] < 0){
+                    new_unit_hypercube[i]++;
+                }
+                new_params[i] = params_info[i].min + new_unit_hypercube[i] * params_info[i].width;
+            }
+            REAL lg_likelihood = this -> log_likelihood(new_params);
+            REAL log_ratio = replica.inverse_temperature * (lg_likelihood - replica.log_likelihood);
+            if (log_ratio >= 0 || log_ratio > std::log(unit_uniform<REAL>(replica.generator))){
+                replica.unit_hypercube = new_unit_hypercube;
+                replica.params = new_params;
+                replica.log_likelihood = lg_likelihood;
+            }
+            if (count){
+                add_to_marginals(replica, number_bins);
+            }
+        }
+    }
+
+    void add_to_marginals(const Replica &replica, uint number_bins){
+        for (std::size_t i = 0; i < num_params; i++){
+            uint bin_number = std::min(static_cast<uint>(std::floor(replica.unit_hypercube[i] * number_bins)), number_bins - 1);
+            this -> marginal_distribution[i][bin_number]++;
+        }
+    }
+};
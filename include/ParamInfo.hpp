@@ -1,5 +1,6 @@
 #pragma once
 #include <string>
+#include <optional>
 
 /**
  * @brief Class for holding / passing information about parameters to be sampled
@@ -31,4 +32,8 @@ public:
     REAL marginal_distribution_peak; // for storing summary statistics.
     REAL mean_parameter;
     REAL standard_deviation;    
+    std::optional<REAL> r_hat; // Gelman-Rubin convergence statistic, only set by multi-chain samplers.
+    std::optional<REAL> effective_sample_size; // batch means diagnostics of the chain draws, only set by MCMC samplers that track them.
+    std::optional<REAL> autocorrelation_time;
+    std::optional<REAL> standard_error; // Monte Carlo standard error of the chain mean
 };
\ No newline at end of file
@@ -0,0 +1,228 @@
+#pragma once
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+/**
+ * @brief xoshiro256++ pseudo random generator of Blackman and Vigna: 256 bits of state, a period of 2^256 - 1 and four adds, shifts and rotations per 64 bit output.
+ * It meets the UniformRandomBitGenerator requirements, so it also works with the standard distributions and algorithms such as std::shuffle.
+ * jump advances the state by 2^128 outputs, which splits one seed into non overlapping streams: stream(seed, k) is the stream given to chain, replica or walker k,
+ * so every unit of parallel work draws the same numbers whichever thread runs it. The state is four integers and can be written to checkpoints as a raw value.
+ * The samplers use this generator directly rather than taking the generator as a template parameter, as their checkpoints store its raw state and the normal blocks are built on its 64 bit outputs.
+*/
+class Xoshiro256
+{
+public:
+    using result_type = std::uint64_t;
+
+    /**
+     * @brief Constructor that expands a 64 bit seed into the full state with splitmix64, as recommended by the authors.
+     * @param seed: Seed of the generator. (optional: default = 42)
+    */
+    explicit Xoshiro256(std::uint64_t seed = 42){
+        for (std::uint64_t &word: state){
+            seed += 0x9e3779b97f4a7c15;
+            std::uint64_t z = seed;
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+            word = z ^ (z >> 31);
+        }
+    }
+
+    /**
+     * @brief Constructor from a raw state, which must not be all zero.
+    */
+    explicit Xoshiro256(const std::array<std::uint64_t, 4> &raw_state) : state(raw_state) {}
+
+    /**
+     * @brief: Stream k of the given seed, the generator seeded with seed and jumped k times. Streams are 2^128 outputs apart, so they never overlap in practice.
+    */
+    static Xoshiro256 stream(std::uint64_t seed, std::uint64_t k){
+        Xoshiro256 generator(seed);
+        for (std::uint64_t i = 0; i < k; i++){
+            generator.jump();
+        }
+        return generator;
+    }
+
+    /**
+     * @brief: Streams 0 to count - 1 of the given seed, each one jump on from the one before, so seeding count chains or walkers takes count - 1 jumps rather than count^2 / 2.
+    */
+    static std::vector<Xoshiro256> streams(std::uint64_t seed, std::size_t count){
+        std::vector<Xoshiro256> generators;
+        generators.reserve(count);
+        for (std::size_t k = 0; k < count; k++){
+            generators.push_back(k == 0 ? Xoshiro256(seed) : generators.back());
+            if (k > 0){
+                generators.back().jump();
+            }
+        }
+        return generators;
+    }
+
+    static constexpr result_type min(){
+        return 0;
+    }
+    static constexpr result_type max(){
+        return std::numeric_limits<result_type>::max();
+    }
+
+    result_type operator()(){
+        std::uint64_t result = rotate_left(state[0] + state[3], 23) + state[0];
+        std::uint64_t shifted = state[1] << 17;
+        state[2] ^= state[0];
+        state[3] ^= state[1];
+        state[1] ^= state[2];
+        state[0] ^= state[3];
+        state[2] ^= shifted;
+        state[3] = rotate_left(state[3], 45);
+        return result;
+    }
+
+    /**
+     * @brief: Advances the state by 2^128 outputs.
+    */
+    void jump(){
+        static constexpr std::uint64_t jump_polynomial[4] = {0x180ec6d33cfd0aba, 0xd5a61266f0c9392c, 0xa9582618e03fc9aa, 0x39abdc4529b1661c};
+        std::array<std::uint64_t, 4> jumped{};
+        for (std::uint64_t word: jump_polynomial){
+            for (int bit = 0; bit < 64; bit++){
+                if (word & (std::uint64_t(1) << bit)){
+                    for (std::size_t i = 0; i < 4; i++){
+                        jumped[i] ^= state[i];
+                    }
+                }
+                (*this)();
+            }
+        }
+        state = jumped;
+    }
+
+    const std::array<std::uint64_t, 4>& get_state() const {
+        return state;
+    }
+
+    friend bool operator==(const Xoshiro256 &a, const Xoshiro256 &b){
+        return a.state == b.state;
+    }
+    friend bool operator!=(const Xoshiro256 &a, const Xoshiro256 &b){
+        return !(a == b);
+    }
+
+private:
+    std::array<std::uint64_t, 4> state;
+
+    static std::uint64_t rotate_left(std::uint64_t x, int k){
+        return (x << k) | (x >> (64 - k));
+    }
+};
+
+/**
+ * @brief: Uniform number in [0, 1) from the top bits of one output of the generator, as many bits as REAL has in its mantissa.
+*/
+template<typename REAL>
+REAL unit_uniform(Xoshiro256 &generator){
+    constexpr int digits = std::numeric_limits<REAL>::digits < 64 ? std::numeric_limits<REAL>::digits : 64;
+    return static_cast<REAL>(generator() >> (64 - digits)) * (REAL(1) / static_cast<REAL>(std::uint64_t(1) << (digits - 1)) / 2);
+}
+
+/**
+ * @brief Tables of the 128 layer ziggurat for the standard normal of Marsaglia and Tsang, built once on first use. x holds the right edge of every layer divided by 2^53, so that a 53 bit integer times
+ * x[layer] is a point in the layer, and limit the integer below which that point lies inside the next layer down, where the density is certainly above it. Layer 0 is the base strip including the tail beyond r.
+*/
+struct ZigguratTables
+{
+    static constexpr double r = 3.442619855899; // start of the tail
+    static constexpr double layer_area = 9.91256303526217e-3;
+    std::array<double, 128> x;
+    std::array<std::uint64_t, 128> limit;
+    std::array<double, 128> density;
+
+    ZigguratTables(){
+        const double scale = 9007199254740992.0; // 2^53
+        double edge = r;
+        double previous_edge = r;
+        double base_width = layer_area / std::exp(-0.5 * r * r);
+        x[0] = base_width / scale;
+        x[127] = r / scale;
+        limit[0] = static_cast<std::uint64_t>(r / base_width * scale);
+        limit[1] = 0;
+        density[0] = 1;
+        density[127] = std::exp(-0.5 * r * r);
+        for (int i = 126; i >= 1; i--){
+            edge = std::sqrt(-2 * std::log(layer_area / edge + std::exp(-0.5 * edge * edge)));
+            limit[i + 1] = static_cast<std::uint64_t>(edge / previous_edge * scale);
+            previous_edge = edge;
+            density[i] = std::exp(-0.5 * edge * edge);
+            x[i] = edge / scale;
+        }
+    }
+
+    static const ZigguratTables& get(){
+        static const ZigguratTables tables;
+        return tables;
+    }
+};
+
+/**
+ * @brief: Standard normal number from the ziggurat. One output of the generator gives the layer (7 bits), the sign (1 bit) and the position (53 bits); about 99% of draws are accepted straight away
+ * with a multiply and a compare, and only the rest evaluate the density or sample the tail.
+*/
+template<typename REAL>
+REAL ziggurat_normal(Xoshiro256 &generator){
+    const ZigguratTables &tables = ZigguratTables::get();
+    while (true){
+        std::uint64_t bits = generator();
+        std::size_t layer = bits & 127;
+        double sign = (bits & 128) ? -1.0 : 1.0;
+        std::uint64_t position = bits >> 11;
+        double x = static_cast<double>(position) * tables.x[layer];
+        if (position < tables.limit[layer]){
+            return static_cast<REAL>(sign * x);
+        }
+        if (layer == 0){ // tail beyond r, by Marsaglia's method
+            double tail;
+            double y;
+            do{
+                tail = -std::log(1 - unit_uniform<double>(generator)) / ZigguratTables::r;
+                y = -std::log(1 - unit_uniform<double>(generator));
+            } while (y + y < tail * tail);
+            return static_cast<REAL>(sign * (ZigguratTables::r + tail));
+        }
+        if (tables.density[layer] + unit_uniform<double>(generator) * (tables.density[layer - 1] - tables.density[layer]) < std::exp(-0.5 * x * x)){
+            return static_cast<REAL>(sign * x);
+        }
+    }
+}
+
+/**
+ * @brief Standard normal numbers generated block_size at a time with the ziggurat. Filling a whole block in one tight loop keeps the tables and generator state hot and leaves the sampler's
+ * inner loop with a load and an index increment per normal. The block is a plain value, so it can be saved to and restored from checkpoints along with the generator that fills it.
+ *
+ * @tparam REAL: type representing real numbers; usually float or double.
+ * @tparam block_size: number of normals generated at a time.
+*/
+template<typename REAL, std::size_t block_size = 256>
+class NormalBlock
+{
+public:
+    REAL operator()(Xoshiro256 &generator){
+        if (next == block_size){
+            refill(generator);
+        }
+        return values[next++];
+    }
+
+private:
+    std::array<REAL, block_size> values{};
+    std::size_t next = block_size;
+
+    void refill(Xoshiro256 &generator){
+        for (REAL &value: values){
+            value = ziggurat_normal<REAL>(generator);
+        }
+        next = 0;
+    }
+};
@@ -10,6 +10,18 @@
 #include <numeric>
 #include <ParamInfo.hpp>
 #include "Plot.hpp"
+#include "LinearModel.hpp"
+#include "Interval.hpp"
+#include "Dual.hpp"
+#include "MinibatchLikelihood.hpp"
+#include "VectorLikelihood.hpp"
+#include "ModelExpression.hpp"
+#include "BytecodeModel.hpp"
+#include "StagedModel.hpp"
+#include "Checkpoint.hpp"
+#include "BinaryIO.hpp"
+#include <filesystem>
+#include <cstring>
 #include <optional>
 
 
@@ -68,21 +80,313 @@ class Sampler
     const std::map<std::array<REAL,num_params>,REAL>& get_param_likelihood() const{
         return parameter_likelihood;
     }
+    const std::vector<std::vector<REAL>>& get_marginal_distribution() const{
+        return marginal_distribution;
+    }
     
 
     /**
-     * @brief: Calculates the log likelihood of the function using specific parameters being a fit for the data we are modelling.
-     * @return: log likelihood value at that specific parameter vector.
+     * @brief: Saves the sampler's progress to a checkpoint file while it samples. If the file already exists when sample() is called the run resumes from it and finishes with the same result,
+     * bit for bit, as a run that was never stopped. The file is replaced atomically at every checkpoint and removed once sampling finishes. The grid appends the grid points sampled since the
+     * last checkpoint to file + ".likelihoods" rather than rewriting the likelihood map, so its checkpoints stay cheap late in a long scan.
+     * @param file: Checkpoint file.
+     * @param interval_seconds: Wall time between checkpoints. 0 disables time based checkpoints. (optional: default = 600)
+     * @param interval_iterations: Iterations between checkpoints; samples for MCMC, grid points for the grid. 0 disables iteration based checkpoints. (optional: default = 0)
+    */
+    void enable_checkpoints(const std::string &file, double interval_seconds = 600, std::uint64_t interval_iterations = 0){
+        if (file.empty()){
+            throw std::domain_error("Error - Checkpoint file cannot be empty.");
+        }
+        if (interval_seconds < 0){
+            throw std::domain_error("Error - Checkpoint interval cannot be negative.");
+        }
+        checkpoint_file = file;
+        checkpoint_schedule = CheckpointSchedule(interval_seconds, interval_iterations);
+    }
+    bool uses_checkpoints() const {
+        return !checkpoint_file.empty();
+    }
+    /**
+     * @brief: Names the model function, e.g. by its expression. A hash of the name is written into checkpoints and shard files, so resuming or merging them with a different model is refused.
+    */
+    void set_model_name(const std::string &name){
+        model_name = name;
+    }
+    const std::string& get_model_name() const {
+        return model_name;
+    }
+    /**
+     * @brief: true if the last call to sample() resumed from a checkpoint file.
     */
-    REAL log_likelihood(std::array<REAL, num_params> params){
+    bool resumed_from_checkpoint() const {
+        return resumed;
+    }
+
+    /**
+     * @brief: Opts in to the sufficient statistics likelihood engine for models that are linear in their parameters. The basis functions must describe the same model as the model function,
+     * i.e. func(x, params) = sum_j params[j] * basis[j](x). From then on log_likelihood costs O(num_params^2) rather than a pass over every observation.
+     * @param basis: Basis function of each parameter.
+    */
+    void set_linear_model(const typename LinearModel<REAL, num_params>::BasisFunctions &basis){
+        linear_model.emplace(basis, observations);
+    }
+    bool uses_linear_model() const {
+        return linear_model.has_value();
+    }
+
+    /**
+     * @brief: Opts in to the vectorised likelihood kernel of a known model. It must describe the same model as the model function, see VectorModel. log_likelihood then evaluates the model
+     * inline on several observations at once with fused multiply adds, on the widest of AVX-512, AVX2 and plain scalar code the processor supports, instead of calling the model function for every
+     * observation. Ignored while a linear model is set as that is cheaper still.
+     * @param model: Known model matching the model function.
+    */
+    void set_vector_model(VectorModel model){
+        if (model == VectorModel::power_law){
+            if (num_params != 2){
+                throw std::domain_error("Error - The power law model has 2 parameters.");
+            }
+            log_inputs.resize(observations.num_points);
+            for (uint i = 0; i < observations.num_points; i++){
+                if (!(observations.inputs[i] > 0)){
+                    throw std::domain_error("Error - The power law model needs every input to be positive.");
+                }
+                log_inputs[i] = std::log(observations.inputs[i]);
+            }
+        }
+        vector_model = model;
+    }
+    bool uses_vector_model() const {
+        return vector_model.has_value() && !linear_model.has_value();
+    }
+
+    /**
+     * @brief: Opts in to a model whose type is known at compile time: a functor with REAL operator()(REAL x, const std::array<REAL, num_params> &params) const, e.g. an expression from
+     * ModelExpression.hpp. It must describe the same model as the model function. log_likelihood then runs a loop compiled for this model type, with the model inlined and the loop free
+     * to be vectorised, instead of calling the model function through std::function for every observation. Ignored while a linear or vector model is set as those are cheaper still.
+     * @param model: Model matching the model function.
+    */
+    template<typename Model>
+    void set_compiled_model(const Model &model){
+        compiled_likelihood = [model](const std::array<REAL, num_params> &params, const Observations<REAL> &observations, uint first_row, uint last_row){
+            return compiled_log_likelihood(model, params, observations, first_row, last_row);
+        };
+    }
+    bool uses_compiled_model() const {
+        return static_cast<bool>(compiled_likelihood) && !linear_model.has_value() && !vector_model.has_value();
+    }
+
+    using BlockModel = std::function<void(const std::array<REAL, num_params>&, const REAL*, REAL*, std::size_t)>;
+
+    /**
+     * @brief: Opts in to a model that evaluates many observations per call, e.g. BytecodeModel::evaluate. It must describe the same model as the model function. log_likelihood then has the
+     * model outputs of a tile of observations computed in one call rather than calling the model function for every observation. Ignored while a linear, vector or compiled model is set.
+     * @param model: Sets outputs[i] to the model output for inputs[i], i < count, at the parameter vector.
+    */
+    void set_block_model(const BlockModel &model){
+        block_model = model;
+    }
+    bool uses_block_model() const {
+        return static_cast<bool>(block_model) && !linear_model.has_value() && !vector_model.has_value() && !compiled_likelihood;
+    }
+
+    /**
+     * @brief: Instruction set used by the vectorised likelihood kernel, by default the widest one the processor supports. Narrower ones can be chosen, e.g. to compare results.
+    */
+    void set_simd_level(SimdLevel level){
+        if (level > detected_simd_level()){
+            throw std::domain_error("Error - The processor does not support this instruction set.");
+        }
+        simd_level = level;
+    }
+    SimdLevel get_simd_level() const {
+        return simd_level;
+    }
+
+    /**
+     * @brief: Sets a staged form of the model function, e.g. param_2_staged_model<double>(). Samplers that sweep the inner parameter with every other parameter fixed compute the partial results once per sweep
+     * and only complete them for each value of the inner parameter. Ignored while a linear model is set as that is cheaper still.
+     * @param staged: Staged form of the model function.
+    */
+    void set_staged_model(const StagedModel<REAL, num_params> &staged){
+        if (staged.inner_param >= num_params){
+            throw std::domain_error("Error - Inner parameter of the staged model is out of range.");
+        }
+        staged_model = staged;
+    }
+    bool uses_staged_model() const {
+        return staged_model.has_value() && !linear_model.has_value();
+    }
+    std::size_t get_staged_inner_param() const {
+        return staged_model ? staged_model->inner_param : num_params - 1;
+    }
+
+    /**
+     * @brief: Evaluates the partial stage of the staged model for every observation.
+     * @param params: Parameter vector. The value of the inner parameter is not used.
+     * @param partials: Filled with one partial result per observation.
+    */
+    void compute_partial_outputs(std::array<REAL, num_params> &params, std::vector<REAL> &partials){
+        partials.resize(observations.num_points);
+        for (uint i = 0; i < observations.num_points; i++){
+            partials[i] = staged_model->partial(observations.inputs[i], params);
+        }
+    }
+
+    /**
+     * @brief: Log likelihood from the cached partial results of the staged model, completed with a value of the inner parameter. Matches log_likelihood for the same parameter vector.
+    */
+    REAL staged_log_likelihood(const std::vector<REAL> &partials, REAL inner_value){
         REAL sum_likelihood = 0;
         for (uint i = 0; i < observations.num_points; i++){
-            REAL func_output = model_function(observations.inputs[i],params);
-            sum_likelihood += -(func_output - observations.outputs[i]) * (func_output - observations.outputs[i]) /(2 * observations.sigmas[i] * observations.sigmas[i]);
+            REAL func_output = staged_model->complete(partials[i], observations.inputs[i], inner_value);
+            sum_likelihood += -(func_output - observations.outputs[i]) * (func_output - observations.outputs[i]) * observations.inverse_double_variances[i];
         }
         return sum_likelihood;
     }
 
+    /**
+     * @brief: Sets the model function instantiated on intervals, e.g. param_2_model_func<Interval<double>>. It must describe the same model as the model function and is used to bound the log likelihood over a box of parameters.
+     * @param func: Interval version of the model function.
+    */
+    void set_interval_model(const std::function<Interval<REAL>(Interval<REAL>, std::array<Interval<REAL>, num_params>&)> &func){
+        interval_model = func;
+        interval_program.reset();
+    }
+    /**
+     * @brief: Sets a bytecode model as the interval model. Its scalar program runs once per box rather than once per observation.
+    */
+    void set_interval_model(const BytecodeModel<REAL, num_params> &program){
+        interval_model = program;
+        interval_program = program;
+    }
+    bool has_interval_model() const {
+        return static_cast<bool>(interval_model);
+    }
+
+    /**
+     * @brief: Upper bound of the log likelihood over a box of parameters. The interval model bounds the output for each observation and only the distance from the observed value to that range counts towards chi^2.
+     * @param box: Range of every parameter.
+     * @return: A value no smaller than the log likelihood of any parameter vector inside the box.
+    */
+    REAL log_likelihood_upper_bound(std::array<Interval<REAL>, num_params> box){
+        if (!interval_model){
+            throw std::logic_error("Error - An interval model must be set before the log likelihood can be bounded.");
+        }
+        if (interval_program){
+            return rows_log_likelihood_upper_bound(interval_program->prepare(box));
+        }
+        return rows_log_likelihood_upper_bound([this, &box](Interval<REAL> x){ return interval_model(x, box); });
+    }
+
+    /**
+     * @brief: Sets the model function instantiated on dual numbers, e.g. param_2_model_func<Dual<double, 2>>. It must describe the same model as the model function and gives the gradient of the log likelihood.
+     * @param func: Dual number version of the model function.
+    */
+    void set_gradient_model(const std::function<Dual<REAL, num_params>(Dual<REAL, num_params>, std::array<Dual<REAL, num_params>, num_params>&)> &func){
+        gradient_model = func;
+        gradient_program.reset();
+    }
+    /**
+     * @brief: Sets a bytecode model as the gradient model. Its scalar program runs once per parameter vector rather than once per observation.
+    */
+    void set_gradient_model(const BytecodeModel<REAL, num_params> &program){
+        gradient_model = program;
+        gradient_program = program;
+    }
+    bool has_gradient_model() const {
+        return static_cast<bool>(gradient_model);
+    }
+
+    /**
+     * @brief: Log likelihood and its gradient with respect to the parameters, from the same residual loop as log_likelihood instantiated with every parameter a dual number variable.
+     * @param params: Parameter vector.
+     * @param gradient: Set to the gradient of the log likelihood.
+     * @return: Log likelihood value at that specific parameter vector.
+    */
+    REAL log_likelihood_gradient(std::array<REAL, num_params> params, std::array<REAL, num_params> &gradient){
+        if (!gradient_model){
+            throw std::logic_error("Error - A gradient model must be set before the gradient of the log likelihood can be evaluated.");
+        }
+        std::array<Dual<REAL, num_params>, num_params> dual_params;
+        for (std::size_t i = 0; i < num_params; i++){
+            dual_params[i] = Dual<REAL, num_params>::variable(params[i], i);
+        }
+        Dual<REAL, num_params> sum_likelihood;
+        if (gradient_program){
+            auto prepared = gradient_program->prepare(dual_params);
+            sum_likelihood = rows_log_likelihood([&prepared](Dual<REAL, num_params> x, std::array<Dual<REAL, num_params>, num_params>&){ return prepared(x); }, dual_params,
+                                                 observations.num_points, [](uint k){ return k; });
+        }
+        else{
+            sum_likelihood = rows_log_likelihood(gradient_model, dual_params, observations.num_points, [](uint k){ return k; });
+        }
+        gradient = sum_likelihood.gradient;
+        return sum_likelihood.value;
+    }
+
+    /**
+     * @brief: Calculates the log likelihood of the function using specific parameters being a fit for the data we are modelling.
+     * @return: log likelihood value at that specific parameter vector.
+    */
+    REAL log_likelihood(const std::array<REAL, num_params> &params){
+        if (linear_model){
+            return linear_model->log_likelihood(params);
+        }
+        if (vector_model){
+            const std::vector<REAL> &inputs = vector_model == VectorModel::power_law ? log_inputs : observations.inputs;
+            return vector_log_likelihood<REAL, num_params>(vector_model.value(), simd_level, params, inputs.data(), observations.outputs.data(), observations.inverse_double_variances.data(), observations.num_points);
+        }
+        if (compiled_likelihood){
+            return compiled_likelihood(params, observations, 0, observations.num_points);
+        }
+        if (block_model){
+            return block_log_likelihood(params, 0, observations.num_points);
+        }
+        std::array<REAL, num_params> model_params = params; // the model function takes its parameters by reference
+        return rows_log_likelihood(model_function, model_params, observations.num_points, [](uint k){ return k; });
+    }
+
+    /**
+     * @brief: Log likelihoods of many parameter vectors from one pass over the observations. The observations are taken in tiles of likelihood_tile_rows rows, small enough to stay in cache, and each
+     * tile is applied to every parameter vector before the next one is loaded, so a large data set is read from memory once per batch instead of once per parameter vector.
+     * Matches log_likelihood for every parameter vector, up to rounding with the vectorised kernels, a compiled model or a block model.
+     * @param params_batch: Parameter vectors.
+     * @param log_likelihoods: Set to the log likelihood of every parameter vector.
+    */
+    void batch_log_likelihood(const std::vector<std::array<REAL, num_params>> &params_batch, std::vector<REAL> &log_likelihoods){
+        log_likelihoods.assign(params_batch.size(), 0);
+        if (linear_model){
+            for (std::size_t k = 0; k < params_batch.size(); k++){
+                log_likelihoods[k] = linear_model->log_likelihood(params_batch[k]);
+            }
+            return;
+        }
+        const std::vector<REAL> &inputs = vector_model == VectorModel::power_law ? log_inputs : observations.inputs;
+        std::vector<std::array<REAL, num_params>> model_params; // the model function takes its parameters by reference
+        if (!vector_model && !compiled_likelihood && !block_model){
+            model_params = params_batch;
+        }
+        for (uint tile_start = 0; tile_start < observations.num_points; tile_start += likelihood_tile_rows){
+            uint tile_end = std::min(tile_start + likelihood_tile_rows, observations.num_points);
+            for (std::size_t k = 0; k < params_batch.size(); k++){
+                if (vector_model){
+                    log_likelihoods[k] += vector_log_likelihood<REAL, num_params>(vector_model.value(), simd_level, params_batch[k], inputs.data() + tile_start, observations.outputs.data() + tile_start,
+                                                                                  observations.inverse_double_variances.data() + tile_start, tile_end - tile_start);
+                    continue;
+                }
+                if (compiled_likelihood){
+                    log_likelihoods[k] += compiled_likelihood(params_batch[k], observations, tile_start, tile_end);
+                    continue;
+                }
+                if (block_model){
+                    log_likelihoods[k] += block_log_likelihood(params_batch[k], tile_start, tile_end);
+                    continue;
+                }
+                log_likelihoods[k] = rows_log_likelihood(model_function, model_params[k], tile_end - tile_start, [tile_start](uint row){ return tile_start + row; }, log_likelihoods[k]);
+            }
+        }
+    }
+
     /**
      * @brief: This member function provides summary statistics for the marginal distribution such as the mean, standard deviation and the midpoint of the bin that houses the largest marginal probability for each parameter.
      * Adds the statistics that are calculated to member variables of the ParamInfo object. Evaluates the mean as \sum_i a_i M_a[i] and the standard deviation as  \sqrt{(\sum_i a_i^2 M_a[i]) - mean_a}. i is the bin index and a is the param.
@@ -120,9 +424,21 @@ class Sampler
             if (print){
                 std::cout << "Parameter " + current_params_info.name + " : \n" + "Standard Deviation - " << standard_deviation << "\n";
                 std::cout << "Mean - " << param_mean << "\n";
-                std::cout << "Parameter at Marginal Distribution Peak - " << param_max << "\n" << std::endl;
+                std::cout << "Parameter at Marginal Distribution Peak - " << param_max << "\n";
+                if (current_params_info.r_hat){
+                    std::cout << "R-hat - " << current_params_info.r_hat.value() << "\n";
+                }
+                if (current_params_info.effective_sample_size){
+                    std::cout << "Effective Sample Size - " << current_params_info.effective_sample_size.value() << "\n";
+                    std::cout << "Integrated Autocorrelation Time - " << current_params_info.autocorrelation_time.value() << "\n";
+                    std::cout << "Monte Carlo Standard Error - " << current_params_info.standard_error.value() << "\n";
+                }
+                std::cout << std::endl;
             }
         }
+        if (print && acceptance_rate){
+            std::cout << "Acceptance Rate - " << acceptance_rate.value() << "\n" << std::endl;
+        }
     }
     
     /**
@@ -182,6 +498,18 @@ class Sampler
     std::array<ParamInfo<REAL>, num_params> params_info;
     std::function<REAL(REAL,std::array<REAL, num_params>&)> model_function;
     std::optional<std::map<std::string, std::string>> extra_settings;
+    std::optional<LinearModel<REAL, num_params>> linear_model;
+    std::optional<StagedModel<REAL, num_params>> staged_model;
+    std::function<Interval<REAL>(Interval<REAL>, std::array<Interval<REAL>, num_params>&)> interval_model;
+    std::function<Dual<REAL, num_params>(Dual<REAL, num_params>, std::array<Dual<REAL, num_params>, num_params>&)> gradient_model;
+    std::optional<BytecodeModel<REAL, num_params>> interval_program; // set when the interval model is a bytecode model, which is then prepared once per box
+    std::optional<BytecodeModel<REAL, num_params>> gradient_program; // likewise for the gradient model, prepared once per parameter vector
+    std::optional<VectorModel> vector_model;
+    SimdLevel simd_level = detected_simd_level();
+    std::function<REAL(const std::array<REAL, num_params>&, const Observations<REAL>&, uint, uint)> compiled_likelihood; // log likelihood over rows [first, last) with the compiled model
+    BlockModel block_model;
+    std::vector<REAL> log_inputs; // natural logarithm of every input, for the power law kernel
+    static constexpr uint likelihood_tile_rows = 1024; // inputs, outputs and weights of a tile take 24 kB in double, within the L1 cache of most cores
     
     protected:
     /**
@@ -196,6 +524,206 @@ class Sampler
         }
     }
     
+    /**
+     * @brief: Log likelihood over the rows [first_row, last_row) with the model type known at compile time. Each tile of rows first fills a buffer with the weighted squared residuals, a loop
+     * without a dependency between iterations that the compiler can vectorise with the model inlined, and the buffer is then summed in row order.
+    */
+    template<typename Model>
+    static REAL compiled_log_likelihood(const Model &model, const std::array<REAL, num_params> &params, const Observations<REAL> &observations, uint first_row, uint last_row){
+        REAL terms[likelihood_tile_rows];
+        REAL sum_likelihood = 0;
+        for (uint tile_start = first_row; tile_start < last_row; tile_start += likelihood_tile_rows){
+            uint tile_rows = std::min(likelihood_tile_rows, last_row - tile_start);
+            const REAL *inputs = observations.inputs.data() + tile_start;
+            const REAL *outputs = observations.outputs.data() + tile_start;
+            const REAL *weights = observations.inverse_double_variances.data() + tile_start;
+            for (uint i = 0; i < tile_rows; i++){
+                REAL residual = model(inputs[i], params) - outputs[i];
+                terms[i] = residual * residual * weights[i];
+            }
+            for (uint i = 0; i < tile_rows; i++){
+                sum_likelihood -= terms[i];
+            }
+        }
+        return sum_likelihood;
+    }
+
+    /**
+     * @brief: Log likelihood over the rows [first_row, last_row) with the block model, which fills a buffer with the model outputs of a tile of rows at a time.
+    */
+    REAL block_log_likelihood(const std::array<REAL, num_params> &params, uint first_row, uint last_row) const {
+        REAL model_outputs[likelihood_tile_rows];
+        REAL sum_likelihood = 0;
+        for (uint tile_start = first_row; tile_start < last_row; tile_start += likelihood_tile_rows){
+            uint tile_rows = std::min(likelihood_tile_rows, last_row - tile_start);
+            block_model(params, observations.inputs.data() + tile_start, model_outputs, tile_rows);
+            for (uint i = 0; i < tile_rows; i++){
+                REAL residual = model_outputs[i] - observations.outputs[tile_start + i];
+                sum_likelihood -= residual * residual * observations.inverse_double_variances[tile_start + i];
+            }
+        }
+        return sum_likelihood;
+    }
+
+    /**
+     * @brief: Upper bound of the log likelihood over every observation, given the interval model with the box already bound so that it takes only the input.
+    */
+    template<typename IntervalModel>
+    REAL rows_log_likelihood_upper_bound(const IntervalModel &model) const {
+        REAL sum_likelihood = 0;
+        for (uint i = 0; i < observations.num_points; i++){
+            Interval<REAL> func_output = model(Interval<REAL>(observations.inputs[i]));
+            REAL distance = std::max<REAL>({func_output.lower - observations.outputs[i], observations.outputs[i] - func_output.upper, 0});
+            sum_likelihood += -distance * distance * observations.inverse_double_variances[i];
+        }
+        return sum_likelihood;
+    }
+
+    /**
+     * @brief: Log likelihood over num_rows rows of the observations with a model instantiated on the number type T, the k-th row being row_index(k), added on to sum_likelihood so that a pass
+     * split into tiles sums in the same order as one pass. The one residual loop behind the full, batched and subset log likelihoods with T = REAL and the gradient with T = Dual.
+    */
+    template<typename T, typename Model, typename RowIndex>
+    T rows_log_likelihood(const Model &model, std::array<T, num_params> &params, uint num_rows, RowIndex row_index, T sum_likelihood = 0) const {
+        for (uint k = 0; k < num_rows; k++){
+            uint i = row_index(k);
+            T residual = model(T(observations.inputs[i]), params) - observations.outputs[i];
+            sum_likelihood -= residual * residual * observations.inverse_double_variances[i];
+        }
+        return sum_likelihood;
+    }
+
+    static constexpr std::uint32_t grid_checkpoint = 1;
+    static constexpr std::uint32_t chain_checkpoint = 2;
+    static constexpr std::uint32_t checkpoint_version = 10;
+
+    /**
+     * @brief: Log likelihood over only the given rows of the observations. Used as a cheap approximation to the full log likelihood.
+    */
+    REAL subset_log_likelihood(std::array<REAL, num_params> params, const std::vector<uint> &rows){
+        return rows_log_likelihood(model_function, params, rows.size(), [&rows](uint k){ return rows[k]; });
+    }
+
+    /**
+     * @brief: Minibatch estimator of log likelihood differences for this model and data, linearised around the reference point or, if none is given, around the least squares fit inside the parameter ranges.
+     * Needs the gradient model.
+    */
+    MinibatchLikelihood<REAL, num_params> make_minibatch_likelihood(uint batch_size, const std::optional<std::array<REAL, num_params>> &reference) const {
+        if (!gradient_model){
+            throw std::logic_error("Error - A gradient model must be set before the minibatch likelihood can be used.");
+        }
+        auto prepare_gradient = [this](const std::array<Dual<REAL, num_params>, num_params> &dual_params) -> std::function<Dual<REAL, num_params>(Dual<REAL, num_params>)> {
+            if (gradient_program){
+                return gradient_program->prepare(dual_params);
+            }
+            return [this, params = dual_params](Dual<REAL, num_params> x) mutable { return gradient_model(x, params); };
+        };
+        std::array<REAL, num_params> linearisation_point;
+        if (reference){
+            linearisation_point = reference.value();
+        }
+        else{
+            std::array<REAL, num_params> min_values;
+            std::array<REAL, num_params> max_values;
+            for (std::size_t i = 0; i < num_params; i++){
+                min_values[i] = params_info[i].min;
+                max_values[i] = params_info[i].max;
+            }
+            linearisation_point = MinibatchLikelihood<REAL, num_params>::least_squares_fit(prepare_gradient, observations, min_values, max_values);
+        }
+        return MinibatchLikelihood<REAL, num_params>(model_function, prepare_gradient, observations, linearisation_point, batch_size);
+    }
+
+    bool checkpoint_exists() const {
+        return uses_checkpoints() && std::filesystem::exists(checkpoint_file);
+    }
+
+    /**
+     * @brief: Writes the part of a checkpoint common to every sampler: a header identifying the sampler and its settings followed by the marginal distribution and the likelihood map.
+     * The sampler's own state is written after it. A sampler that saves the likelihood map elsewhere passes with_likelihoods = false and an empty map is written.
+    */
+    void write_checkpoint_header(std::ostream &file, std::uint32_t kind, bool with_likelihoods = true) const {
+        using namespace binary_io;
+        file.write("CKPT", 4);
+        write_value<std::uint32_t>(file, checkpoint_version);
+        write_value<std::uint32_t>(file, kind);
+        write_value<std::uint32_t>(file, sizeof(REAL));
+        write_value<std::uint32_t>(file, num_params);
+        write_value<std::uint32_t>(file, bins);
+        write_value<std::uint64_t>(file, hash_string(model_name));
+        for (const ParamInfo<REAL> &info: params_info){
+            write_value<REAL>(file, info.min);
+            write_value<REAL>(file, info.max);
+        }
+        write_value<std::uint32_t>(file, observations.num_points);
+        for (const std::vector<REAL> &param_marginal: marginal_distribution){
+            write_values(file, param_marginal);
+        }
+        if (!with_likelihoods){
+            write_value<std::uint64_t>(file, 0);
+            return;
+        }
+        write_value<std::uint64_t>(file, parameter_likelihood.size());
+        for (const auto &pair: parameter_likelihood){
+            write_value(file, pair.first);
+            write_value(file, pair.second);
+        }
+    }
+
+    /**
+     * @brief: Reads back what write_checkpoint_header wrote, restoring the marginal distribution and likelihood map. Throws if the checkpoint was written by another kind of sampler or with other settings.
+    */
+    void read_checkpoint_header(std::istream &file, std::uint32_t kind){
+        using namespace binary_io;
+        char magic[4];
+        file.read(magic, 4);
+        bool matches = file && std::memcmp(magic, "CKPT", 4) == 0 && read_value<std::uint32_t>(file) == checkpoint_version && read_value<std::uint32_t>(file) == kind && read_value<std::uint32_t>(file) == sizeof(REAL)
+                       && read_value<std::uint32_t>(file) == num_params && read_value<std::uint32_t>(file) == bins;
+        if (matches && read_value<std::uint64_t>(file) != hash_string(model_name)){
+            throw std::runtime_error("Error - Checkpoint file " + checkpoint_file + " was written for a different model.");
+        }
+        for (std::size_t i = 0; matches && i < num_params; i++){
+            matches = read_value<REAL>(file) == params_info[i].min && read_value<REAL>(file) == params_info[i].max;
+        }
+        if (!matches || read_value<std::uint32_t>(file) != observations.num_points){
+            throw std::runtime_error("Error - Checkpoint file " + checkpoint_file + " was written by a different sampler or with different settings.");
+        }
+        for (std::vector<REAL> &param_marginal: marginal_distribution){
+            read_values(file, param_marginal);
+        }
+        std::uint64_t num_entries = read_value<std::uint64_t>(file);
+        parameter_likelihood.clear();
+        for (std::uint64_t i = 0; i < num_entries && file; i++){
+            std::array<REAL, num_params> params = read_value<std::array<REAL, num_params>>(file);
+            parameter_likelihood.emplace_hint(parameter_likelihood.end(), params, read_value<REAL>(file));
+        }
+        if (!file){
+            throw std::runtime_error("Error - Checkpoint file " + checkpoint_file + " is truncated.");
+        }
+    }
+
+    /**
+     * @brief: Removes the checkpoint file once sampling has finished.
+    */
+    void finish_checkpoints(){
+        if (uses_checkpoints()){
+            std::filesystem::remove(checkpoint_file);
+        }
+    }
+
+    void set_r_hat_value(std::size_t param_idx, REAL r_hat){
+        params_info[param_idx].r_hat = r_hat;
+    }
+
+    /**
+     * @brief: Stores the convergence diagnostics of the chain draws of a parameter, which summarise then prints.
+    */
+    void set_chain_diagnostics(std::size_t param_idx, REAL effective_sample_size, REAL autocorrelation_time, REAL standard_error){
+        params_info[param_idx].effective_sample_size = effective_sample_size;
+        params_info[param_idx].autocorrelation_time = autocorrelation_time;
+        params_info[param_idx].standard_error = standard_error;
+    }
+
     // for derived classes that have extra conditions so they can be included in plots.
     void set_extra_settings(std::map<std::string,std::string> settings){
         extra_settings = settings;
@@ -206,4 +734,9 @@ class Sampler
     std::map<std::array<REAL, num_params>,REAL> parameter_likelihood; //  Dict for parameter vector and liklihood.
     std::vector<std::vector<REAL>> marginal_distribution;
     bool been_sampled = false;
+    std::string checkpoint_file;
+    std::string model_name;
+    CheckpointSchedule checkpoint_schedule;
+    bool resumed = false;
+    std::optional<REAL> acceptance_rate; // set by samplers with an accept / reject step, printed by summarise
 };
\ No newline at end of file
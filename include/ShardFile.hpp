@@ -0,0 +1,111 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include "BinaryIO.hpp"
+
+/**
+ * @brief Result of one shard of a grid scan that is split across processes. The marginals are unnormalised and held relative to the largest log likelihood in the shard,
+ * marginals[j][k] = sum exp(log likelihood - max_log_likelihood) over the shard's grid points in bin k of parameter j, so shards can be merged without underflow.
+ *
+ * @tparam REAL: type representing real numbers; usually float or double.
+*/
+template<typename REAL>
+struct ShardResult
+{
+    uint shard_index = 0;
+    uint shard_count = 1;
+    uint num_bins = 0;
+    std::uint64_t model_hash = 0; // binary_io::hash_string of the sampler's model name
+    std::vector<REAL> min_values;
+    std::vector<REAL> max_values;
+    REAL max_log_likelihood = 0;
+    std::vector<std::vector<REAL>> marginals;
+};
+
+namespace shard_file_detail{
+    constexpr char magic[4] = {'S', 'H', 'R', 'D'};
+    constexpr std::uint32_t version = 2;
+}
+
+/**
+ * @brief Writes a shard result to a compact binary file: a header (magic, version, sizeof(REAL), number of parameters, bins, shard index and count, model hash), the parameter ranges,
+ * the largest log likelihood and then the marginals parameter by parameter. Values are stored in native byte order.
+ * @param filepath: File that is created or overwritten.
+ * @param result: Shard result to write.
+*/
+template<typename REAL>
+void write_shard_file(const std::string &filepath, const ShardResult<REAL> &result){
+    using namespace shard_file_detail;
+    using namespace binary_io;
+    std::ofstream file(filepath, std::ios::binary | std::ios::trunc);
+    if (!file){
+        throw std::runtime_error("Unable to open shard file: " + filepath);
+    }
+    file.write(magic, sizeof(magic));
+    write_value<std::uint32_t>(file, version);
+    write_value<std::uint32_t>(file, sizeof(REAL));
+    write_value<std::uint32_t>(file, static_cast<std::uint32_t>(result.marginals.size()));
+    write_value<std::uint32_t>(file, result.num_bins);
+    write_value<std::uint32_t>(file, result.shard_index);
+    write_value<std::uint32_t>(file, result.shard_count);
+    write_value<std::uint64_t>(file, result.model_hash);
+    for (std::size_t j = 0; j < result.marginals.size(); j++){
+        write_value<REAL>(file, result.min_values[j]);
+        write_value<REAL>(file, result.max_values[j]);
+    }
+    write_value<REAL>(file, result.max_log_likelihood);
+    for (const std::vector<REAL> &param_marginal: result.marginals){
+        write_values(file, param_marginal);
+    }
+    if (!file){
+        throw std::runtime_error("Unable to write shard file: " + filepath);
+    }
+}
+
+/**
+ * @brief Reads a shard result written by write_shard_file.
+ * @param filepath: Shard file to read.
+*/
+template<typename REAL>
+ShardResult<REAL> read_shard_file(const std::string &filepath){
+    using namespace shard_file_detail;
+    using namespace binary_io;
+    std::ifstream file(filepath, std::ios::binary);
+    if (!file){
+        throw std::runtime_error("Unable to open shard file: " + filepath);
+    }
+    char file_magic[4];
+    file.read(file_magic, sizeof(file_magic));
+    if (!file || std::memcmp(file_magic, magic, sizeof(magic)) != 0 || read_value<std::uint32_t>(file) != version){
+        throw std::runtime_error("Error - " + filepath + " is not a shard file.");
+    }
+    if (read_value<std::uint32_t>(file) != sizeof(REAL)){
+        throw std::runtime_error("Error - Shard file " + filepath + " was written with a different floating point type.");
+    }
+    ShardResult<REAL> result;
+    std::uint32_t num_params = read_value<std::uint32_t>(file);
+    result.num_bins = read_value<std::uint32_t>(file);
+    result.shard_index = read_value<std::uint32_t>(file);
+    result.shard_count = read_value<std::uint32_t>(file);
+    result.model_hash = read_value<std::uint64_t>(file);
+    if (!file || num_params > 1024 || result.num_bins > 400000000){
+        throw std::runtime_error("Error - Shard file " + filepath + " has a corrupt header.");
+    }
+    for (std::uint32_t j = 0; j < num_params; j++){
+        result.min_values.push_back(read_value<REAL>(file));
+        result.max_values.push_back(read_value<REAL>(file));
+    }
+    result.max_log_likelihood = read_value<REAL>(file);
+    result.marginals.assign(num_params, std::vector<REAL>(result.num_bins));
+    for (std::vector<REAL> &param_marginal: result.marginals){
+        read_values(file, param_marginal);
+    }
+    if (!file){
+        throw std::runtime_error("Error - Shard file " + filepath + " is truncated.");
+    }
+    return result;
+}
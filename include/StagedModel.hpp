@@ -0,0 +1,19 @@
+#pragma once
+#include <array>
+#include <functional>
+
+/**
+ * @brief Model function split into two stages around one parameter, the inner parameter, so that the work that does not depend on it can be reused while it alone varies.
+ * partial(x, params) must not read params[inner_param] and complete(partial(x, params), x, params[inner_param]) must equal the model function. For example a * x^b staged around a
+ * caches x^b and completes with a multiplication, so a sweep over a costs no std::pow at all.
+ *
+ * @tparam REAL: type representing real numbers; usually float or double.
+ * @tparam num_params: number of parameters that are being used to fit the model.
+*/
+template<typename REAL, std::size_t num_params>
+struct StagedModel
+{
+    std::size_t inner_param;
+    std::function<REAL(REAL, std::array<REAL, num_params>&)> partial;
+    std::function<REAL(REAL, REAL, REAL)> complete; // (partial result, x, inner parameter value)
+};
@@ -0,0 +1,183 @@
+#pragma once
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+#include <memory>
+#include <cstdint>
+#include <stdexcept>
+
+/**
+ * @brief Fixed size pool of worker threads that the samplers use to spread independent pieces of work across cores.
+ * Work is submitted to parallel_for as a range of task indices. Each worker starts on its own contiguous share of the range and once that runs out it steals
+ * the upper half of the largest share left with another worker, so tasks of uneven cost do not leave cores sitting idle.
+ * A pool with a single thread runs every task on the calling thread and never starts a worker.
+*/
+class ThreadPool
+{
+    public:
+    /**
+     * @brief Constructor that starts the worker threads. They sleep until parallel_for hands them work.
+     * @param num_threads: Number of threads in the pool. (optional: default = number of hardware threads)
+    */
+    explicit ThreadPool(uint num_threads = std::thread::hardware_concurrency()) : pool_size(num_threads == 0 ? 1 : num_threads), ranges(new TaskRange[num_threads == 0 ? 1 : num_threads]){
+        if (pool_size == 1){
+            return;
+        }
+        for (uint i = 0; i < pool_size; i++){
+            workers.emplace_back(&ThreadPool::worker_loop, this, i);
+        }
+    }
+
+    ~ThreadPool(){
+        {
+            std::lock_guard<std::mutex> guard(pool_lock);
+            stopping = true;
+        }
+        job_ready.notify_all();
+        for (std::thread &worker: workers){
+            worker.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    uint size() const {
+        return pool_size;
+    }
+
+    /**
+     * @brief Runs task_func once for every task index in [0, num_tasks) and blocks until all of them are finished. The first exception thrown by a task is rethrown here.
+     * Must not be called from inside one of its own tasks.
+     * @param num_tasks: Number of task indices to run.
+     * @param task_func: Called as task_func(worker, task). worker is in [0, size()) and can be used to index per worker scratch space.
+    */
+    void parallel_for(std::uint64_t num_tasks, const std::function<void(uint, std::uint64_t)> &task_func){
+        if (num_tasks == 0){
+            return;
+        }
+        if (pool_size == 1){
+            for (std::uint64_t task = 0; task < num_tasks; task++){
+                task_func(0, task);
+            }
+            return;
+        }
+        for (uint i = 0; i < pool_size; i++){ // initial even split of the task range
+            std::lock_guard<std::mutex> guard(ranges[i].lock);
+            ranges[i].next = num_tasks * i / pool_size;
+            ranges[i].end = num_tasks * (i + 1) / pool_size;
+        }
+        std::unique_lock<std::mutex> guard(pool_lock);
+        job = &task_func;
+        error = nullptr;
+        active = pool_size;
+        generation++;
+        job_ready.notify_all();
+        job_done.wait(guard, [this]{return active == 0;});
+        job = nullptr;
+        if (error){
+            std::rethrow_exception(error);
+        }
+    }
+
+    private:
+    struct TaskRange{
+        std::mutex lock;
+        std::uint64_t next = 0;
+        std::uint64_t end = 0;
+    };
+
+    void worker_loop(uint worker){
+        std::uint64_t seen_generation = 0;
+        while (true){
+            {
+                std::unique_lock<std::mutex> guard(pool_lock);
+                job_ready.wait(guard, [&]{return stopping || generation != seen_generation;});
+                if (stopping){
+                    return;
+                }
+                seen_generation = generation;
+            }
+            std::uint64_t task;
+            while (next_task(worker, task)){
+                try{
+                    (*job)(worker, task);
+                }
+                catch(...){
+                    std::lock_guard<std::mutex> guard(pool_lock);
+                    if (!error){
+                        error = std::current_exception();
+                    }
+                }
+            }
+            std::lock_guard<std::mutex> guard(pool_lock);
+            if (--active == 0){
+                job_done.notify_all();
+            }
+        }
+    }
+
+    /**
+     * @brief Takes the next task from the worker's own range, otherwise steals the upper half of the largest range held by another worker.
+     * @return: false once every range in the pool is empty.
+    */
+    bool next_task(uint worker, std::uint64_t &task){
+        {
+            std::lock_guard<std::mutex> guard(ranges[worker].lock);
+            if (ranges[worker].next < ranges[worker].end){
+                task = ranges[worker].next++;
+                return true;
+            }
+        }
+        while (true){
+            uint victim = worker;
+            std::uint64_t most_remaining = 0;
+            for (uint i = 0; i < pool_size; i++){
+                if (i == worker){
+                    continue;
+                }
+                std::lock_guard<std::mutex> guard(ranges[i].lock);
+                if (ranges[i].end - ranges[i].next > most_remaining){
+                    most_remaining = ranges[i].end - ranges[i].next;
+                    victim = i;
+                }
+            }
+            if (most_remaining == 0){
+                return false;
+            }
+            std::uint64_t stolen_begin;
+            std::uint64_t stolen_end;
+            {
+                std::lock_guard<std::mutex> guard(ranges[victim].lock);
+                std::uint64_t remaining = ranges[victim].end - ranges[victim].next;
+                if (remaining == 0){ // victim finished while we were looking, search again.
+                    continue;
+                }
+                stolen_begin = ranges[victim].next + remaining / 2;
+                stolen_end = ranges[victim].end;
+                ranges[victim].end = stolen_begin;
+            }
+            // own range is empty so other workers never take from it; safe to fill after releasing the victim's lock.
+            std::lock_guard<std::mutex> guard(ranges[worker].lock);
+            task = stolen_begin;
+            ranges[worker].next = stolen_begin + 1;
+            ranges[worker].end = stolen_end;
+            return true;
+        }
+    }
+
+    uint pool_size;
+    std::unique_ptr<TaskRange[]> ranges; // std::mutex is not movable so the ranges live in a fixed array.
+    std::vector<std::thread> workers;
+    std::mutex pool_lock;
+    std::condition_variable job_ready;
+    std::condition_variable job_done;
+    const std::function<void(uint, std::uint64_t)> *job = nullptr;
+    std::uint64_t generation = 0;
+    uint active = 0;
+    bool stopping = false;
+    std::exception_ptr error;
+};
@@ -0,0 +1,101 @@
+#pragma once
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <stdexcept>
+
+/**
+ * @brief How a TraceBuffer behaves once it is full. ring keeps the most recent points by overwriting the oldest, fixed keeps the first points and ignores the rest.
+*/
+enum class TraceMode{
+    ring,
+    fixed
+};
+
+/**
+ * @brief Fixed capacity contiguous store of the points visited by a sampler together with their log likelihoods. The storage is allocated up front so recording a point never allocates
+ * and memory use does not grow with the length of the run.
+ *
+ * @tparam REAL: type representing real numbers; usually float or double.
+ * @tparam num_params: number of parameters that are being used to fit the model.
+*/
+template<typename REAL, std::size_t num_params>
+class TraceBuffer
+{
+    public:
+    struct TracePoint{
+        std::array<REAL, num_params> params;
+        REAL log_likelihood;
+    };
+
+    TraceBuffer() = default;
+
+    /**
+     * @brief Constructor that allocates room for capacity points.
+     * @param capacity: Maximum number of points held.
+     * @param trace_mode: What happens once the buffer is full. (optional: default = TraceMode::ring)
+    */
+    explicit TraceBuffer(std::size_t capacity, TraceMode trace_mode = TraceMode::ring) : points(capacity), mode(trace_mode){
+        if (capacity == 0){
+            throw std::domain_error("Error - Trace capacity cannot be 0.");
+        }
+    }
+
+    void record(const std::array<REAL, num_params> &params, REAL log_likelihood){
+        if (points.empty() || (mode == TraceMode::fixed && num_recorded >= points.size())){
+            num_recorded++;
+            return;
+        }
+        TracePoint &point = points[num_recorded % points.size()];
+        point.params = params;
+        point.log_likelihood = log_likelihood;
+        num_recorded++;
+    }
+
+    /**
+     * @brief: Number of points held, at most the capacity.
+    */
+    std::size_t size() const {
+        return num_recorded < points.size() ? static_cast<std::size_t>(num_recorded) : points.size();
+    }
+    std::size_t capacity() const {
+        return points.size();
+    }
+    TraceMode get_mode() const {
+        return mode;
+    }
+    /**
+     * @brief: Number of points passed to record, including any that were overwritten or not kept.
+    */
+    std::uint64_t total_recorded() const {
+        return num_recorded;
+    }
+
+    /**
+     * @brief: Point idx of the trace in the order the points were recorded, 0 being the oldest held.
+    */
+    const TracePoint& operator[](std::size_t idx) const {
+        if (mode == TraceMode::ring && num_recorded > points.size()){
+            return points[(num_recorded + idx) % points.size()];
+        }
+        return points[idx];
+    }
+
+    /**
+     * @brief: Raw storage, for saving and restoring the buffer exactly. With a wrapped ring buffer this is not in recorded order.
+    */
+    std::vector<TracePoint>& storage(){
+        return points;
+    }
+    const std::vector<TracePoint>& storage() const {
+        return points;
+    }
+    void set_total_recorded(std::uint64_t recorded){
+        num_recorded = recorded;
+    }
+
+    private:
+    std::vector<TracePoint> points;
+    TraceMode mode = TraceMode::ring;
+    std::uint64_t num_recorded = 0;
+};
@@ -0,0 +1,271 @@
+#pragma once
+#include <array>
+#include <vector>
+#include <deque>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <filesystem>
+#include <optional>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "BinaryIO.hpp"
+#include "TraceBuffer.hpp"
+
+namespace trace_file_detail{
+    constexpr char magic[4] = {'T', 'R', 'C', 'E'};
+    constexpr std::uint32_t version = 1;
+    constexpr std::size_t header_size = 24; // magic, version, sizeof(REAL), number of parameters, thinning and a reserved word, so the points that follow stay aligned
+}
+
+/**
+ * @brief Streams the points of a chain to a binary trace file: a 24 byte header (magic, version, sizeof(REAL), number of parameters, thinning) followed by one TracePoint per point, the parameters
+ * then the log likelihood, in native byte order. The file is a plain array after the header, so MappedTrace can memory map it for analysis.
+ * Points are gathered in buffers that a background thread writes out, so recording a point is a copy into memory and the chain never waits on the disk. Written buffers are reused;
+ * if the disk falls behind further buffers are allocated rather than blocking.
+ *
+ * @tparam REAL: type representing real numbers; usually float or double.
+ * @tparam num_params: number of parameters that are being used to fit the model.
+*/
+template<typename REAL, std::size_t num_params>
+class TraceWriter
+{
+    public:
+    using TracePoint = typename TraceBuffer<REAL, num_params>::TracePoint;
+    static constexpr std::size_t buffer_points = 4096;
+
+    /**
+     * @brief Constructor that creates the file and starts the writer thread.
+     * @param filepath: Trace file.
+     * @param thinning: Thinning of the chain, recorded in the header.
+     * @param resume_points: If set, the existing file is kept up to this many points, with anything after them, written after the last checkpoint, cut off, and new points are appended. (optional)
+    */
+    TraceWriter(const std::string &filepath, uint thinning, std::optional<std::uint64_t> resume_points = std::nullopt) : filepath(filepath){
+        using namespace trace_file_detail;
+        if (resume_points){
+            std::uint64_t kept_size = header_size + resume_points.value() * sizeof(TracePoint);
+            if (!std::filesystem::exists(filepath) || std::filesystem::file_size(filepath) < kept_size){
+                throw std::runtime_error("Error - Trace file " + filepath + " is shorter than the checkpoint it is resumed with.");
+            }
+            std::filesystem::resize_file(filepath, kept_size);
+            file.open(filepath, std::ios::binary | std::ios::app);
+            num_points = resume_points.value();
+        }
+        else{
+            file.open(filepath, std::ios::binary | std::ios::trunc);
+            file.write(magic, sizeof(magic));
+            binary_io::write_value<std::uint32_t>(file, version);
+            binary_io::write_value<std::uint32_t>(file, sizeof(REAL));
+            binary_io::write_value<std::uint32_t>(file, num_params);
+            binary_io::write_value<std::uint32_t>(file, thinning);
+            binary_io::write_value<std::uint32_t>(file, 0);
+        }
+        if (!file){
+            throw std::runtime_error("Unable to open trace file: " + filepath);
+        }
+        current.reserve(buffer_points);
+        writer = std::thread([this]{ write_loop(); });
+    }
+    ~TraceWriter(){
+        try{
+            close();
+        }
+        catch (const std::exception &e){
+            std::cerr << e.what() << std::endl;
+        }
+    }
+    TraceWriter(const TraceWriter&) = delete;
+    TraceWriter& operator=(const TraceWriter&) = delete;
+
+    void record(const std::array<REAL, num_params> &params, REAL log_likelihood){
+        current.push_back({params, log_likelihood});
+        num_points++;
+        if (current.size() == buffer_points){
+            submit();
+        }
+    }
+
+    /**
+     * @brief: Number of points recorded, including any not yet on disk.
+    */
+    std::uint64_t size() const {
+        return num_points;
+    }
+
+    /**
+     * @brief: Blocks until every point recorded so far is written to the file.
+    */
+    void flush(){
+        submit();
+        std::unique_lock<std::mutex> lock(mutex);
+        drained.wait(lock, [this]{ return queue.empty() && !writing; });
+        if (failed){
+            throw std::runtime_error("Unable to write trace file: " + filepath);
+        }
+    }
+
+    /**
+     * @brief: Writes out the remaining points, stops the writer thread and closes the file.
+    */
+    void close(){
+        if (!writer.joinable()){
+            return;
+        }
+        submit();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        ready.notify_one();
+        writer.join();
+        file.close();
+        if (failed){
+            throw std::runtime_error("Unable to write trace file: " + filepath);
+        }
+    }
+
+    private:
+    std::string filepath;
+    std::ofstream file;
+    std::vector<TracePoint> current; // only touched by the recording thread
+    std::uint64_t num_points = 0;
+    std::thread writer;
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::condition_variable drained;
+    std::deque<std::vector<TracePoint>> queue;
+    std::vector<std::vector<TracePoint>> spare_buffers;
+    bool writing = false;
+    bool stopping = false;
+    bool failed = false;
+
+    void submit(){
+        if (current.empty()){
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            queue.push_back(std::move(current));
+            if (!spare_buffers.empty()){
+                current = std::move(spare_buffers.back());
+                spare_buffers.pop_back();
+            }
+            else{
+                current = std::vector<TracePoint>();
+                current.reserve(buffer_points);
+            }
+        }
+        ready.notify_one();
+    }
+
+    void write_loop(){
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true){
+            ready.wait(lock, [this]{ return stopping || !queue.empty(); });
+            if (queue.empty()){
+                return;
+            }
+            std::vector<TracePoint> buffer = std::move(queue.front());
+            queue.pop_front();
+            writing = true;
+            lock.unlock();
+            binary_io::write_values(file, buffer);
+            file.flush();
+            buffer.clear();
+            lock.lock();
+            failed = failed || !file;
+            writing = false;
+            spare_buffers.push_back(std::move(buffer));
+            if (queue.empty()){
+                drained.notify_all();
+            }
+        }
+    }
+};
+
+/**
+ * @brief Read only memory mapping of a trace file written by TraceWriter. The points are used in place, without being copied or parsed.
+ *
+ * @tparam REAL: type representing real numbers; usually float or double.
+ * @tparam num_params: number of parameters that are being used to fit the model.
+*/
+template<typename REAL, std::size_t num_params>
+class MappedTrace
+{
+    public:
+    using TracePoint = typename TraceBuffer<REAL, num_params>::TracePoint;
+
+    /**
+     * @brief Constructor that maps the file. Throws if it is not a trace file for this REAL and number of parameters.
+     * @param filepath: Trace file.
+    */
+    explicit MappedTrace(const std::string &filepath){
+        using namespace trace_file_detail;
+        file_descriptor = ::open(filepath.c_str(), O_RDONLY);
+        struct stat file_status;
+        if (file_descriptor < 0 || ::fstat(file_descriptor, &file_status) != 0){
+            release();
+            throw std::runtime_error("Unable to open trace file: " + filepath);
+        }
+        mapped_bytes = static_cast<std::size_t>(file_status.st_size);
+        void *mapping = mapped_bytes < header_size ? MAP_FAILED : ::mmap(nullptr, mapped_bytes, PROT_READ, MAP_SHARED, file_descriptor, 0);
+        if (mapping == MAP_FAILED){
+            mapped_bytes = 0;
+            release();
+            throw std::runtime_error("Unable to memory map trace file: " + filepath);
+        }
+        bytes = static_cast<const char*>(mapping);
+        std::uint32_t header[5];
+        std::memcpy(header, bytes + sizeof(magic), sizeof(header));
+        if (std::memcmp(bytes, magic, sizeof(magic)) != 0 || header[0] != version || header[1] != sizeof(REAL) || header[2] != num_params){
+            release();
+            throw std::runtime_error("Error - " + filepath + " is not a trace file of this type.");
+        }
+        thinning = header[3];
+        num_points = (mapped_bytes - header_size) / sizeof(TracePoint);
+    }
+    ~MappedTrace(){
+        release();
+    }
+    MappedTrace(const MappedTrace&) = delete;
+    MappedTrace& operator=(const MappedTrace&) = delete;
+
+    std::size_t size() const {
+        return num_points;
+    }
+    uint get_thinning() const {
+        return thinning;
+    }
+    const TracePoint& operator[](std::size_t idx) const {
+        return data()[idx];
+    }
+    const TracePoint* data() const {
+        return reinterpret_cast<const TracePoint*>(bytes + trace_file_detail::header_size);
+    }
+
+    private:
+    int file_descriptor = -1;
+    const char *bytes = nullptr;
+    std::size_t mapped_bytes = 0;
+    std::size_t num_points = 0;
+    uint thinning = 1;
+
+    void release(){
+        if (bytes){
+            ::munmap(const_cast<char*>(bytes), mapped_bytes);
+            bytes = nullptr;
+        }
+        if (file_descriptor >= 0){
+            ::close(file_descriptor);
+            file_descriptor = -1;
+        }
+    }
+};
@@ -1,9 +1,22 @@
 #pragma once
 #include "Sampler.hpp"
+#include "ThreadPool.hpp"
+#include "LikelihoodTensor.hpp"
+#include "ShardFile.hpp"
+#include <cstdint>
+#include <algorithm>
 
 /**
  * @brief Derived class template inheriting from base Sampler class template that uses a grid search technique to calculate the log likelihood of every parameter combination.
- * Includes the overwritten sample member function that uses a the private member recursive function combination_gen to find every possible combination of paramters across an n parameter space.
+ * Includes the overwritten sample member function that walks every combination of parameters across an n parameter space using an odometer over the flattened 64-bit grid index.
+ * The grid is traversed one row at a time, where a row is a full sweep of the last parameter with every other parameter held fixed, so the innermost axis runs as a tight loop.
+ * With a staged model set the rows sweep the staged model's inner parameter instead and the partial model outputs are computed once per row and reused for every bin along it.
+ * With more than one thread set the rows are split into chunks that are shared out across a work stealing thread pool.
+ * By default every grid point is stored in the parameter_likelihood map. With dense storage enabled the log likelihoods are instead written to a LikelihoodTensor addressed by flat grid index
+ * and the marginal distributions are computed afterwards as axis reductions over the tensor.
+ * The multiresolution mode replaces the full scan with a coarse grid of cells that are recursively halved only where their likelihood is close to the best found so far.
+ * The full scan can also be split across processes, each sampling one shard of the rows and writing its unnormalised marginals to a shard file that merge_shards combines.
+ * The branch and bound mode does the same with a rigorous interval arithmetic bound on each cell, so only cells that cannot hold a grid point within a given margin of the best are skipped.
  * @tparam REAL: type representing real numbers; usually float or double.
  * @tparam num_params: number of parameters that are being used to fit the model.
 */
@@ -28,51 +41,921 @@ class UniformSampler : public Sampler<REAL, num_params>{
 
 
     /**
-     * @brief Sampling method that uses uniform sampling technique. To sample every parameter combination across n bins and n parameters a recursive function is used. Overrides abstract virtual member function.
+     * @brief Sampling method that uses uniform sampling technique. Every parameter combination across n bins and n parameters is sampled by sweeping the rows of the grid. Overrides abstract virtual member function.
+     * If more than one thread has been set the rows are shared out across a thread pool. If a shard has been set only its slice of the rows is sampled and the shard file is written before the marginals are normalised.
     */
     void sample() override {
         if (this -> been_sampled){
             std::cerr << "Error - Procedure aborted as this UniformSampler instance has already sampled the data points." << std::endl;
         }
-        // obtain number of bins and array of ParamInfo objects. combination_gen is recursive function
-        const std::array<ParamInfo<REAL>, num_params>& param_info = this -> get_params_info();
         uint num_bins = this -> get_bins();
-        std::vector<uint> combination;
-        combination_gen(combination, num_params, param_info, num_bins);
+        compute_bin_centres(this -> get_params_info(), num_bins);
+        inner_axis = this -> uses_staged_model() ? this -> get_staged_inner_param() : num_params - 1;
+        if (sharded && (multiresolution || branch_and_bound || dense_storage)){
+            throw std::logic_error("Error - Sharded sampling is only available for the full scan stored in the likelihood map.");
+        }
+        if (this -> uses_checkpoints() && (multiresolution || branch_and_bound || dense_storage)){
+            throw std::logic_error("Error - Checkpoints are only available for the full scan stored in the likelihood map.");
+        }
+        if (multiresolution || branch_and_bound){
+            if (dense_storage){
+                throw std::logic_error("Error - Dense likelihood storage needs the full grid and cannot be combined with the multiresolution grid or branch and bound.");
+            }
+            if (multiresolution && branch_and_bound){
+                throw std::logic_error("Error - The multiresolution grid and branch and bound cannot be used together.");
+            }
+            if (branch_and_bound && !this -> has_interval_model()){
+                throw std::logic_error("Error - Branch and bound needs an interval model to be set.");
+            }
+            ThreadPool pool(num_threads);
+            if (multiresolution){
+                sample_multiresolution(pool, num_bins);
+            }
+            else{
+                sample_branch_and_bound(pool, num_bins);
+            }
+            this -> normalise_marginal_distribution();
+            this -> been_sampled = true;
+            return;
+        }
+        std::uint64_t num_rows = 1; // every axis but the innermost
+        for (std::size_t i = 0; i + 1 < num_params; i++){
+            num_rows *= num_bins;
+        }
+        std::uint64_t first_row = 0;
+        std::uint64_t last_row = num_rows;
+        if (sharded){
+            first_row = num_rows * shard_index / shard_count;
+            last_row = num_rows * (shard_index + 1) / shard_count;
+        }
+        ThreadPool pool(num_threads);
+        if (dense_storage){
+            likelihood_tensor.allocate(num_rows * num_bins, tensor_file);
+        }
+        marginal_log_offset = -std::numeric_limits<REAL>::infinity();
+        if (this -> uses_checkpoints()){
+            sample_rows_with_checkpoints(pool, first_row, last_row, num_bins);
+        }
+        else{
+            for_each_row_chunk(pool, first_row, last_row, num_bins, [&](std::uint64_t chunk_first, std::uint64_t chunk_last, std::vector<std::vector<REAL>>& marginal, REAL& log_offset, std::map<std::array<REAL, num_params>, REAL>& likelihoods){
+                sample_rows(chunk_first, chunk_last, num_bins, marginal, log_offset, likelihoods);
+            });
+        }
+        if (dense_storage){
+            reduce_tensor(pool, num_rows, num_bins);
+        }
+        if (sharded){
+            write_shard_file(shard_file, get_shard_result());
+        }
+        this -> normalise_marginal_distribution();
+        this -> been_sampled = true;
+        if (this -> uses_checkpoints()){
+            std::filesystem::remove(likelihood_journal_file());
+        }
+        this -> finish_checkpoints();
+    }
+
+    /**
+     * @brief Replaces the full scan with a coarse to fine multiresolution grid. The parameter space is first split into coarse_bins cells per parameter and every cell is evaluated at its centre and face centres.
+     * Cells whose likelihood bound is within log_threshold of the largest likelihood found so far are halved along every parameter and the children evaluated in turn, until the cells are single bins of the requested grid.
+     * Cells that are not refined contribute their centre likelihood spread uniformly across the bins they cover, so the marginals are still reported on the requested bins.
+     * @param log_threshold: Cells more than this many nats below the current maximum are not refined further.
+     * @param coarse_bins: Number of cells per parameter in the starting grid. (optional: default = 4)
+    */
+    void use_multiresolution(REAL log_threshold, uint coarse_bins = 4){
+        if (!(log_threshold > 0)){
+            throw std::domain_error("Error - Multiresolution log threshold must be positive.");
+        }
+        if (coarse_bins == 0){
+            throw std::domain_error("Error - Number of coarse bins cannot be 0.");
+        }
+        multiresolution = true;
+        refinement_threshold = log_threshold;
+        num_coarse_bins = coarse_bins;
+        this -> set_extra_settings({{"refine", findsigfig<REAL>(log_threshold)}});
+    }
+    bool uses_multiresolution() const {
+        return multiresolution;
+    }
+    /**
+     * @brief: Number of log likelihood evaluations made by the last multiresolution or branch and bound sample, counting the face evaluations of the multiresolution cells and the interval bounds
+     * of branch and bound, each a pass over the observations. The full scan makes num_bins^num_params.
+    */
+    std::uint64_t get_num_likelihood_evaluations() const {
+        return num_likelihood_evaluations;
+    }
+
+    /**
+     * @brief Replaces the full scan with a branch and bound search over the grid. The parameter space is split into coarse_bins cells per parameter and the log likelihood of each cell is bounded from above
+     * with the interval model (Sampler::set_interval_model). Cells whose bound is more than log_threshold below the best grid point found so far are skipped without evaluating their interior, the rest are halved
+     * along every parameter until they are single bins, which are evaluated exactly and stored like the full scan. Every skipped grid point has a likelihood below exp(-log_threshold) of the maximum.
+     * @param log_threshold: Cells whose bound is more than this many nats below the best grid point are pruned.
+     * @param coarse_bins: Number of cells per parameter in the starting grid. (optional: default = 4)
+    */
+    void use_branch_and_bound(REAL log_threshold, uint coarse_bins = 4){
+        if (!(log_threshold > 0)){
+            throw std::domain_error("Error - Branch and bound log threshold must be positive.");
+        }
+        if (coarse_bins == 0){
+            throw std::domain_error("Error - Number of coarse bins cannot be 0.");
+        }
+        branch_and_bound = true;
+        pruning_threshold = log_threshold;
+        num_coarse_bins = coarse_bins;
+        this -> set_extra_settings({{"prune", findsigfig<REAL>(log_threshold)}});
+    }
+    bool uses_branch_and_bound() const {
+        return branch_and_bound;
+    }
+    /**
+     * @brief: Number of grid points skipped by the last branch and bound sample without their likelihood being evaluated.
+    */
+    std::uint64_t get_num_pruned_cells() const {
+        return num_pruned_cells;
+    }
+
+    /**
+     * @brief Stores the grid log likelihoods in a dense tensor addressed by flat bin index instead of the parameter_likelihood map, which is left empty.
+     * @param backing_file: File the tensor is memory mapped to and left in once sampling is done. Held in memory if empty. (optional: default = "")
+    */
+    void use_dense_storage(const std::string &backing_file = ""){
+        dense_storage = true;
+        tensor_file = backing_file;
+    }
+    bool uses_dense_storage() const {
+        return dense_storage;
+    }
+    const LikelihoodTensor<REAL>& get_likelihood_tensor() const {
+        return likelihood_tensor;
+    }
+
+    /**
+     * @brief Reads the log likelihood of a grid point from the dense tensor.
+     * @param combination: Bin index of every parameter, each below the number of bins.
+    */
+    REAL get_log_likelihood(const std::array<uint, num_params> &combination) const {
+        if (!dense_storage || !this -> been_sampled){
+            throw std::logic_error("Error - Dense likelihood storage is only available after sampling with use_dense_storage() set.");
+        }
+        return likelihood_tensor.at(combination, this -> get_bins());
+    }
+
+    /**
+     * @brief Samples only shard index of count equal slices of the grid rows and writes the shard's unnormalised marginals and largest log likelihood to shard_file.
+     * Running every index from 0 to count - 1, in any order and in separate processes, and merging the files with merge_shards gives the same marginals as the full scan.
+     * @param index: Shard to sample, from 0 to count - 1.
+     * @param count: Number of shards the grid is split into.
+     * @param output_file: Shard file that is written once the shard is sampled.
+    */
+    void set_shard(uint index, uint count, const std::string &output_file){
+        if (count == 0 || index >= count){
+            throw std::domain_error("Error - Shard index must be less than the number of shards.");
+        }
+        sharded = true;
+        shard_index = index;
+        shard_count = count;
+        shard_file = output_file;
+    }
+    bool is_sharded() const {
+        return sharded;
+    }
+
+    /**
+     * @brief: Shard result of the last sample, i.e. the marginals before normalisation and the log likelihood they are relative to.
+    */
+    ShardResult<REAL> get_shard_result() const {
+        ShardResult<REAL> result;
+        result.shard_index = sharded ? shard_index : 0;
+        result.shard_count = sharded ? shard_count : 1;
+        result.num_bins = this -> get_bins();
+        result.model_hash = binary_io::hash_string(this -> get_model_name());
+        for (const ParamInfo<REAL> &info: this -> get_params_info()){
+            result.min_values.push_back(info.min);
+            result.max_values.push_back(info.max);
+        }
+        result.max_log_likelihood = marginal_log_offset;
+        result.marginals = this -> marginal_distribution;
+        return result;
+    }
+
+    /**
+     * @brief Combines the shard files of a sharded scan in place of sampling. Each shard's marginals are rescaled from its own largest log likelihood to the largest across all shards before they are summed,
+     * so the result is the marginal distribution of the full scan. The likelihood map is left empty.
+     * @param shard_files: One file for every shard index of the same scan.
+    */
+    void merge_shards(const std::vector<std::string> &shard_files){
+        if (shard_files.empty()){
+            throw std::domain_error("Error - No shard files to merge.");
+        }
+        std::vector<ShardResult<REAL>> shards;
+        for (const std::string &filepath: shard_files){
+            shards.push_back(read_shard_file<REAL>(filepath));
+        }
+        uint num_bins = this -> get_bins();
+        uint count = shards.front().shard_count;
+        std::vector<bool> seen(count, false);
+        REAL max_log_likelihood = -std::numeric_limits<REAL>::infinity();
+        for (std::size_t s = 0; s < shards.size(); s++){
+            const ShardResult<REAL> &shard = shards[s];
+            if (shard.marginals.size() != num_params || shard.num_bins != num_bins || shard.shard_count != count || shard.shard_index >= count){
+                throw std::runtime_error("Error - Shard file " + shard_files[s] + " does not match the number of parameters, bins or shards of this scan.");
+            }
+            if (shard.model_hash != binary_io::hash_string(this -> get_model_name())){
+                throw std::runtime_error("Error - Shard file " + shard_files[s] + " was sampled with a different model.");
+            }
+            for (std::size_t j = 0; j < num_params; j++){
+                if (shard.min_values[j] != this -> get_params_info()[j].min || shard.max_values[j] != this -> get_params_info()[j].max){
+                    throw std::runtime_error("Error - Shard file " + shard_files[s] + " was sampled over different parameter ranges.");
+                }
+            }
+            if (seen[shard.shard_index]){
+                throw std::runtime_error("Error - Shard " + std::to_string(shard.shard_index) + " is merged twice.");
+            }
+            seen[shard.shard_index] = true;
+            max_log_likelihood = std::max(max_log_likelihood, shard.max_log_likelihood);
+        }
+        for (uint i = 0; i < count; i++){
+            if (!seen[i]){
+                throw std::runtime_error("Error - Shard " + std::to_string(i) + "/" + std::to_string(count) + " is missing.");
+            }
+        }
+        for (std::vector<REAL> &param_marginal: this -> marginal_distribution){
+            std::fill(param_marginal.begin(), param_marginal.end(), 0);
+        }
+        for (const ShardResult<REAL> &shard: shards){
+            if (!std::isfinite(shard.max_log_likelihood)){ // shard without a single finite likelihood adds nothing.
+                continue;
+            }
+            REAL rescale = std::exp(shard.max_log_likelihood - max_log_likelihood);
+            for (std::size_t j = 0; j < num_params; j++){
+                for (uint k = 0; k < num_bins; k++){
+                    this -> marginal_distribution[j][k] += rescale * shard.marginals[j][k];
+                }
+            }
+        }
+        marginal_log_offset = max_log_likelihood;
         this -> normalise_marginal_distribution();
         this -> been_sampled = true;
     }
 
+    /**
+     * @brief Sets the number of threads used to sample the grid. A value of 1 samples every row on the calling thread.
+     * @param threads: Number of worker threads.
+    */
+    void set_num_threads(uint threads){
+        if (threads == 0){
+            throw std::domain_error("Error - Number of threads cannot be 0.");
+        }
+        num_threads = threads;
+    }
+    uint get_num_threads() const {
+        return num_threads;
+    }
+
     private:
+    uint num_threads = 1;
+    std::size_t inner_axis = num_params - 1; // parameter swept along each row of the full scan
+    REAL marginal_log_offset = 0; // log likelihood the unnormalised marginals of the full scan are relative to
+    bool sharded = false;
+    uint shard_index = 0;
+    uint shard_count = 1;
+    std::string shard_file;
+    static constexpr std::uint64_t grid_chunk_size = 4096; // approximate number of grid points handed to a worker at a time.
+    static constexpr std::uint64_t chunks_per_checkpoint_block = 64; // chunks sampled between checks of the checkpoint schedule
+    std::array<std::vector<REAL>, num_params> bin_centres; // parameter value at the midpoint of every bin of every axis.
+    bool dense_storage = false;
+    bool multiresolution = false;
+    REAL refinement_threshold = 0;
+    bool branch_and_bound = false;
+    REAL pruning_threshold = 0;
+    uint num_coarse_bins = 4;
+    std::uint64_t num_likelihood_evaluations = 0;
+    std::uint64_t num_pruned_cells = 0;
+    std::string tensor_file;
+    LikelihoodTensor<REAL> likelihood_tensor;
+    std::vector<std::pair<std::array<REAL, num_params>, REAL>> unjournalled_likelihoods; // grid points sampled since the last checkpoint
+    std::uint64_t journal_entries = 0; // grid points in the likelihood journal covered by the last checkpoint
+
     /**
-     * @brief Recursive helper function that calls itself so that x parameters with n bins can be sampled. Starts with the for loop and adds the first bin index to the combination vector before it calls itself with one less parameter.
-     * Another index is added to the combination vector. This process repeats until the value of n is 0 which corresponds to the number of parameters. #
-     * When this happens the exit criteria is satisfied which is where the parameter vector is passed to the likelihood function and the marginal distribution obtains a contribution. This process repeats until every combination is sampled.
-     * 
-     * @param combination: vector of size num_param that contains the current combination of bin indices.
-     * @param n: Initially set to be the number of params. In the recursive call decreased by 1 to move through parameters.
+     * @brief Precomputes min + (idx + 0.5) * width / num_bins for every bin of every parameter so the traversal only needs table lookups.
      * @param param_info: ParamInfo object containing param max and min.
      * @param num_bins: Number of bins as is private in base class.
-     * 
     */
-    void combination_gen(std::vector<uint>& combination, uint n, const std::array<ParamInfo<REAL>, num_params>& param_info,uint num_bins ){
-        if (n == 0){
-            std::array<REAL,num_params> parameters; 
-            for (std::size_t idx = 0; idx < num_params; idx++){
-                parameters[idx] = param_info[idx].min + (combination[idx] + 0.5) * param_info[idx].width/num_bins;
+    void compute_bin_centres(const std::array<ParamInfo<REAL>, num_params>& param_info, uint num_bins){
+        for (std::size_t i = 0; i < num_params; i++){
+            bin_centres[i].resize(num_bins);
+            for (uint j = 0; j < num_bins; j++){
+                bin_centres[i][j] = param_info[i].min + (j + 0.5) * param_info[i].width/num_bins;
             }
-            REAL lg_likelihood = this ->log_likelihood(parameters);
-            this -> parameter_likelihood[parameters] = lg_likelihood;
-            REAL likelihood = std::exp(lg_likelihood);
-            for (std::size_t j = 0; j < num_params; j++){
-                this -> marginal_distribution[j][combination[j]] += likelihood;
+        }
+    }
+
+    /**
+     * @brief Samples the grid rows [first_row, last_row). A row is a sweep of inner_axis and the row index holds the bin indices of the other parameters, with the last of them varying fastest.
+     * With the default inner axis, the last parameter, the flattened grid index is row * num_bins + inner bin. The outer bin indices are decoded once for first_row and then advanced like an odometer.
+     * The likelihood summed across a row is added to the outer parameters' marginals once per row. With a staged model the partial model outputs are computed once per row, otherwise
+     * the whole row is evaluated as one batch so the observations are read once per row.
+     * The marginal holds likelihoods relative to log_offset, which is raised to the row maximum whenever a row beats it with the marginal rescaled to match, so no likelihood underflows.
+     * With dense storage the log likelihoods are only written to the tensor and marginal and likelihoods are left untouched.
+     * @param first_row: First row to sample.
+     * @param last_row: One past the last row to sample.
+     * @param num_bins: Number of bins as is private in base class.
+     * @param marginal: Marginal distribution that the likelihoods are accumulated into.
+     * @param log_offset: Log likelihood the marginal is relative to. Start at -infinity with an empty marginal.
+     * @param likelihoods: Map that every sampled parameter vector and its log likelihood is stored in.
+    */
+    void sample_rows(std::uint64_t first_row, std::uint64_t last_row, uint num_bins, std::vector<std::vector<REAL>>& marginal, REAL& log_offset, std::map<std::array<REAL, num_params>, REAL>& likelihoods){
+        const std::size_t inner = inner_axis;
+        const bool staged = this -> uses_staged_model();
+        std::array<uint, num_params> combination{};
+        std::array<REAL, num_params> parameters;
+        std::array<std::uint64_t, num_params> strides; // flat index step of every axis
+        strides[num_params - 1] = 1;
+        for (std::size_t idx = num_params - 1; idx-- > 0;){
+            strides[idx] = strides[idx + 1] * num_bins;
+        }
+        std::uint64_t remainder = first_row;
+        for (std::size_t idx = num_params; idx-- > 0;){
+            if (idx == inner){
+                continue;
+            }
+            combination[idx] = static_cast<uint>(remainder % num_bins);
+            remainder /= num_bins;
+            parameters[idx] = bin_centres[idx][combination[idx]];
+        }
+        parameters[inner] = bin_centres[inner][0];
+        const std::vector<REAL>& inner_centres = bin_centres[inner];
+        std::vector<REAL>& inner_marginal = marginal[inner];
+        std::vector<REAL> partials;
+        std::vector<REAL> row_log_likelihoods(num_bins);
+        std::vector<std::array<REAL, num_params>> row_parameters(staged ? 0 : num_bins);
+
+        for (std::uint64_t row = first_row; row < last_row; row++){
+            if (staged){
+                this -> compute_partial_outputs(parameters, partials);
+                for (uint j = 0; j < num_bins; j++){
+                    row_log_likelihoods[j] = this -> staged_log_likelihood(partials, inner_centres[j]);
+                }
+            }
+            else{
+                for (uint j = 0; j < num_bins; j++){
+                    parameters[inner] = inner_centres[j];
+                    row_parameters[j] = parameters;
+                }
+                this -> batch_log_likelihood(row_parameters, row_log_likelihoods);
             }
+            if (dense_storage){
+                std::uint64_t row_start = 0;
+                for (std::size_t idx = 0; idx < num_params; idx++){
+                    row_start += idx == inner ? 0 : combination[idx] * strides[idx];
+                }
+                REAL *row_values = likelihood_tensor.data() + row_start;
+                for (uint j = 0; j < num_bins; j++){
+                    row_values[j * strides[inner]] = row_log_likelihoods[j];
+                }
+            }
+            else{
+                REAL row_max = -std::numeric_limits<REAL>::infinity();
+                for (uint j = 0; j < num_bins; j++){
+                    parameters[inner] = inner_centres[j];
+                    likelihoods.emplace_hint(likelihoods.end(), parameters, row_log_likelihoods[j]); // rows of the last axis are visited in increasing key order for increasing ranges.
+                    row_max = std::max(row_max, row_log_likelihoods[j]);
+                }
+                if (row_max > log_offset){
+                    if (std::isfinite(log_offset)){
+                        rescale_marginal(marginal, std::exp(log_offset - row_max));
+                    }
+                    log_offset = row_max;
+                }
+                if (std::isfinite(log_offset)){
+                    REAL row_likelihood = 0;
+                    for (uint j = 0; j < num_bins; j++){
+                        REAL likelihood = std::exp(row_log_likelihoods[j] - log_offset);
+                        inner_marginal[j] += likelihood;
+                        row_likelihood += likelihood;
+                    }
+                    for (std::size_t idx = 0; idx < num_params; idx++){
+                        if (idx != inner){
+                            marginal[idx][combination[idx]] += row_likelihood;
+                        }
+                    }
+                }
+            }
+            for (std::size_t idx = num_params; idx-- > 0;){ // advance the odometer
+                if (idx == inner){
+                    continue;
+                }
+                if (++combination[idx] < num_bins){
+                    parameters[idx] = bin_centres[idx][combination[idx]];
+                    break;
+                }
+                combination[idx] = 0;
+                parameters[idx] = bin_centres[idx][0];
+            }
+        }
+    }
+
+    /**
+     * @brief Splits the rows [first_row, last_row) of the grid into chunks of roughly grid_chunk_size points and shares them out across the thread pool.
+     * Each worker keeps a private copy of the marginal distribution, its log offset and the likelihood map and these are reduced into the members once every chunk is done,
+     * with every marginal rescaled to the largest offset. A single thread works on the members directly.
+     * @param pool: Thread pool the chunks are run on.
+     * @param first_row: First row of the grid to cover.
+     * @param last_row: One past the last row of the grid to cover.
+     * @param num_bins: Number of bins as is private in base class.
+     * @param chunk_func: Called as chunk_func(first_row, last_row, marginal, log_offset, likelihoods) for every chunk.
+    */
+    template<typename ChunkFunc>
+    void for_each_row_chunk(ThreadPool &pool, std::uint64_t first_row, std::uint64_t last_row, uint num_bins, ChunkFunc &&chunk_func){
+        if (pool.size() == 1){
+            chunk_func(first_row, last_row, this -> marginal_distribution, marginal_log_offset, this -> parameter_likelihood);
             return;
         }
-        for (uint i = 0; i < num_bins; i++){
-            combination.push_back(i);
-            combination_gen(combination, n - 1,param_info, num_bins);
-            combination.pop_back();
+        std::uint64_t rows_per_chunk = std::max<std::uint64_t>(1, grid_chunk_size / num_bins);
+        std::uint64_t num_chunks = (last_row - first_row + rows_per_chunk - 1) / rows_per_chunk;
+        std::vector<std::vector<std::vector<REAL>>> worker_marginals(pool.size(), std::vector<std::vector<REAL>>(num_params, std::vector<REAL>(num_bins, 0)));
+        std::vector<REAL> worker_offsets(pool.size(), -std::numeric_limits<REAL>::infinity());
+        std::vector<std::map<std::array<REAL, num_params>, REAL>> worker_likelihoods(pool.size());
+
+        pool.parallel_for(num_chunks, [&](uint worker, std::uint64_t chunk){
+            std::uint64_t chunk_first = first_row + chunk * rows_per_chunk;
+            std::uint64_t chunk_end = std::min(last_row, chunk_first + rows_per_chunk);
+            chunk_func(chunk_first, chunk_end, worker_marginals[worker], worker_offsets[worker], worker_likelihoods[worker]);
+        });
+
+        // reduce the per worker copies into the shared members.
+        marginal_log_offset = std::max(marginal_log_offset, *std::max_element(worker_offsets.begin(), worker_offsets.end()));
+        for (uint worker = 0; worker < pool.size(); worker++){
+            if (std::isfinite(worker_offsets[worker])){
+                REAL rescale = std::exp(worker_offsets[worker] - marginal_log_offset);
+                for (std::size_t j = 0; j < num_params; j++){
+                    for (uint k = 0; k < num_bins; k++){
+                        this -> marginal_distribution[j][k] += rescale * worker_marginals[worker][j][k];
+                    }
+                }
+            }
+            this -> parameter_likelihood.merge(worker_likelihoods[worker]);
         }
     }
+
+    /**
+     * @brief Full scan of the rows [first_row, last_row) with checkpoints. The rows are sampled in blocks of chunks_per_checkpoint_block chunks and the checkpoint schedule is checked after every block.
+     * A single thread samples each block straight into the members exactly like the scan without checkpoints. With more threads every chunk of a block gets its own marginal, which are folded into the members in chunk order,
+     * so the result does not depend on how the chunks were scheduled and a resumed run is bit identical to one that was never stopped.
+     * @param pool: Thread pool the chunks are run on.
+     * @param first_row: First row of the grid to cover.
+     * @param last_row: One past the last row of the grid to cover.
+     * @param num_bins: Number of bins as is private in base class.
+    */
+    void sample_rows_with_checkpoints(ThreadPool &pool, std::uint64_t first_row, std::uint64_t last_row, uint num_bins){
+        std::uint64_t next_row = first_row;
+        this -> resumed = this -> checkpoint_exists();
+        if (this -> resumed){
+            next_row = read_grid_checkpoint(first_row, last_row);
+        }
+        else{
+            std::ofstream journal(likelihood_journal_file(), std::ios::binary | std::ios::trunc); // drop any journal left by a run that stopped before its first checkpoint
+            journal_entries = 0;
+        }
+        unjournalled_likelihoods.clear();
+        std::map<std::array<REAL, num_params>, REAL> block_likelihoods;
+        this -> checkpoint_schedule.reset(next_row * num_bins);
+        std::uint64_t rows_per_chunk = std::max<std::uint64_t>(1, grid_chunk_size / num_bins);
+        std::uint64_t rows_per_block = rows_per_chunk * chunks_per_checkpoint_block;
+        std::vector<std::vector<std::vector<REAL>>> chunk_marginals;
+        std::vector<REAL> chunk_offsets;
+        std::vector<std::map<std::array<REAL, num_params>, REAL>> chunk_likelihoods;
+        if (pool.size() > 1){
+            chunk_marginals.assign(chunks_per_checkpoint_block, std::vector<std::vector<REAL>>(num_params, std::vector<REAL>(num_bins)));
+            chunk_offsets.resize(chunks_per_checkpoint_block);
+            chunk_likelihoods.resize(chunks_per_checkpoint_block);
+        }
+
+        while (next_row < last_row){
+            std::uint64_t block_end = std::min(last_row, next_row + rows_per_block);
+            if (pool.size() == 1){
+                sample_rows(next_row, block_end, num_bins, this -> marginal_distribution, marginal_log_offset, block_likelihoods);
+                keep_block_likelihoods(block_likelihoods);
+            }
+            else{
+                std::uint64_t num_chunks = (block_end - next_row + rows_per_chunk - 1) / rows_per_chunk;
+                pool.parallel_for(num_chunks, [&](uint, std::uint64_t chunk){
+                    for (std::vector<REAL> &param_marginal: chunk_marginals[chunk]){
+                        std::fill(param_marginal.begin(), param_marginal.end(), 0);
+                    }
+                    chunk_offsets[chunk] = -std::numeric_limits<REAL>::infinity();
+                    std::uint64_t chunk_first = next_row + chunk * rows_per_chunk;
+                    sample_rows(chunk_first, std::min(block_end, chunk_first + rows_per_chunk), num_bins, chunk_marginals[chunk], chunk_offsets[chunk], chunk_likelihoods[chunk]);
+                });
+                for (std::uint64_t chunk = 0; chunk < num_chunks; chunk++){ // fold in chunk order
+                    if (!std::isfinite(chunk_offsets[chunk])){
+                        continue;
+                    }
+                    if (chunk_offsets[chunk] > marginal_log_offset){
+                        if (std::isfinite(marginal_log_offset)){
+                            rescale_marginal(this -> marginal_distribution, std::exp(marginal_log_offset - chunk_offsets[chunk]));
+                        }
+                        marginal_log_offset = chunk_offsets[chunk];
+                    }
+                    REAL rescale = std::exp(chunk_offsets[chunk] - marginal_log_offset);
+                    for (std::size_t j = 0; j < num_params; j++){
+                        for (uint k = 0; k < num_bins; k++){
+                            this -> marginal_distribution[j][k] += rescale * chunk_marginals[chunk][j][k];
+                        }
+                    }
+                    keep_block_likelihoods(chunk_likelihoods[chunk]);
+                }
+            }
+            next_row = block_end;
+            if (next_row < last_row && this -> checkpoint_schedule.due(next_row * num_bins)){
+                write_grid_checkpoint(first_row, last_row, next_row);
+                this -> checkpoint_schedule.reset(next_row * num_bins);
+                CheckpointSchedule::stop_if_requested(this -> checkpoint_file);
+            }
+        }
+    }
+
+    /**
+     * @brief: Moves the likelihoods of a sampled block into the likelihood map, keeping a copy to append to the journal at the next checkpoint.
+    */
+    void keep_block_likelihoods(std::map<std::array<REAL, num_params>, REAL> &block_likelihoods){
+        unjournalled_likelihoods.insert(unjournalled_likelihoods.end(), block_likelihoods.begin(), block_likelihoods.end());
+        this -> parameter_likelihood.merge(block_likelihoods);
+        block_likelihoods.clear();
+    }
+
+    /**
+     * @brief: File next to the checkpoint that the likelihood map of a full scan is appended to, one parameter vector and log likelihood per grid point.
+    */
+    std::string likelihood_journal_file() const {
+        return this -> checkpoint_file + ".likelihoods";
+    }
+
+    /**
+     * @brief: Writes a checkpoint of a full scan of the rows [first_row, last_row) that has sampled every row before next_row. Only the grid points sampled since the last checkpoint are appended
+     * to the likelihood journal, so a checkpoint costs the same however far through the grid the scan is. The journal is flushed before the checkpoint is replaced, and the checkpoint records how
+     * many journal entries it covers, so entries appended by a checkpoint that never completed are ignored on resume.
+    */
+    void write_grid_checkpoint(std::uint64_t first_row, std::uint64_t last_row, std::uint64_t next_row){
+        {
+            std::ofstream journal(likelihood_journal_file(), std::ios::binary | std::ios::app);
+            for (const auto &pair: unjournalled_likelihoods){
+                binary_io::write_value(journal, pair.first);
+                binary_io::write_value(journal, pair.second);
+            }
+            journal.flush();
+            if (!journal){
+                throw std::runtime_error("Unable to write file: " + likelihood_journal_file());
+            }
+        }
+        journal_entries += unjournalled_likelihoods.size();
+        unjournalled_likelihoods.clear();
+        binary_io::write_file_atomically(this -> checkpoint_file, [&](std::ofstream &file){
+            this -> write_checkpoint_header(file, Sampler<REAL, num_params>::grid_checkpoint, false);
+            binary_io::write_value(file, first_row);
+            binary_io::write_value(file, last_row);
+            binary_io::write_value<std::uint32_t>(file, static_cast<std::uint32_t>(inner_axis));
+            binary_io::write_value(file, next_row);
+            binary_io::write_value(file, marginal_log_offset);
+            binary_io::write_value(file, journal_entries);
+        });
+    }
+
+    /**
+     * @brief: Restores a full scan from the checkpoint file and the likelihood journal, checking it covers the same rows swept along the same axis. The journal is cut back to the entries
+     * the checkpoint covers so the next checkpoint appends after them.
+     * @return: The row to continue from.
+    */
+    std::uint64_t read_grid_checkpoint(std::uint64_t first_row, std::uint64_t last_row){
+        std::ifstream file(this -> checkpoint_file, std::ios::binary);
+        this -> read_checkpoint_header(file, Sampler<REAL, num_params>::grid_checkpoint);
+        if (binary_io::read_value<std::uint64_t>(file) != first_row || binary_io::read_value<std::uint64_t>(file) != last_row || binary_io::read_value<std::uint32_t>(file) != inner_axis){
+            throw std::runtime_error("Error - Checkpoint file " + this -> checkpoint_file + " covers a different part of the grid.");
+        }
+        std::uint64_t next_row = binary_io::read_value<std::uint64_t>(file);
+        marginal_log_offset = binary_io::read_value<REAL>(file);
+        journal_entries = binary_io::read_value<std::uint64_t>(file);
+        if (!file){
+            throw std::runtime_error("Error - Checkpoint file " + this -> checkpoint_file + " is truncated.");
+        }
+        {
+            std::ifstream journal(likelihood_journal_file(), std::ios::binary);
+            for (std::uint64_t i = 0; i < journal_entries && journal; i++){
+                std::array<REAL, num_params> params = binary_io::read_value<std::array<REAL, num_params>>(journal);
+                this -> parameter_likelihood.emplace(params, binary_io::read_value<REAL>(journal));
+            }
+            if (!journal){
+                throw std::runtime_error("Error - Likelihood journal " + likelihood_journal_file() + " is truncated.");
+            }
+        }
+        std::filesystem::resize_file(likelihood_journal_file(), journal_entries * (sizeof(std::array<REAL, num_params>) + sizeof(REAL)));
+        return next_row;
+    }
+
+    /**
+     * @brief: Multiplies every entry of a marginal distribution by factor.
+    */
+    static void rescale_marginal(std::vector<std::vector<REAL>> &marginal, REAL factor){
+        for (std::vector<REAL> &param_marginal: marginal){
+            for (REAL &num: param_marginal){
+                num *= factor;
+            }
+        }
+    }
+
+    /**
+     * @brief Box of the requested grid covering bins [lower[j], upper[j]) of every parameter j, with the log likelihood at its centre.
+    */
+    struct GridCell{
+        std::array<uint, num_params> lower;
+        std::array<uint, num_params> upper;
+        REAL log_likelihood;
+        REAL refinement_bound; // estimate of the largest log likelihood inside the cell, a strict upper bound for branch and bound
+        uint num_evaluations; // log likelihood evaluations made for the cell, each a pass over the observations
+    };
+
+    /**
+     * @brief Evaluates the log likelihood at the centre of a cell. Cells spanning more than one bin also get a refinement bound, the tangent plane estimate of the largest log likelihood in the cell
+     * ll(c) + sum_j |dll/dp_j| h_j, with the gradient taken by central differences between the centres of opposite faces at distance h_j. This is an upper bound whenever the log likelihood is concave over the cell,
+     * which holds for any model linear in its parameters, and stops a narrow ridge passing between coarse cell centres from being missed.
+    */
+    void evaluate_cell(GridCell &cell, uint num_bins){
+        std::array<REAL, num_params> centre = cell_centre(cell, num_bins);
+        cell.log_likelihood = this -> log_likelihood(centre);
+        cell.refinement_bound = cell.log_likelihood;
+        cell.num_evaluations = 1;
+        const std::array<ParamInfo<REAL>, num_params>& param_info = this -> get_params_info();
+        for (std::size_t j = 0; j < num_params; j++){
+            if (cell.upper[j] - cell.lower[j] == 1){
+                continue;
+            }
+            REAL half_width = (cell.upper[j] - cell.lower[j]) * 0.5 * param_info[j].width/num_bins;
+            std::array<REAL, num_params> face = centre;
+            face[j] = centre[j] + half_width;
+            REAL upper_face = this -> log_likelihood(face);
+            face[j] = centre[j] - half_width;
+            REAL lower_face = this -> log_likelihood(face);
+            cell.refinement_bound += std::abs(upper_face - lower_face) / 2;
+            cell.num_evaluations += 2;
+        }
+    }
+
+    /**
+     * @brief: Parameter vector at the centre of a cell. Cells that are a single bin use the bin centre tables so they match the full scan exactly.
+    */
+    std::array<REAL, num_params> cell_centre(const GridCell &cell, uint num_bins) const {
+        const std::array<ParamInfo<REAL>, num_params>& param_info = this -> get_params_info();
+        std::array<REAL, num_params> parameters;
+        for (std::size_t j = 0; j < num_params; j++){
+            if (cell.upper[j] - cell.lower[j] == 1){
+                parameters[j] = bin_centres[j][cell.lower[j]];
+            }
+            else{
+                parameters[j] = param_info[j].min + (cell.lower[j] + cell.upper[j]) * 0.5 * param_info[j].width/num_bins;
+            }
+        }
+        return parameters;
+    }
+
+    static bool is_single_bin(const GridCell &cell){
+        for (std::size_t j = 0; j < num_params; j++){
+            if (cell.upper[j] - cell.lower[j] > 1){
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Multiresolution grid. Each level of cells is evaluated across the thread pool, the maximum log likelihood is updated and then the cells whose refinement bound is within refinement_threshold
+     * of it are halved along every parameter that still spans more than one bin to form the next level. Single bin cells are stored in the parameter_likelihood map like the full scan.
+     * Cells that are not refined any further have their centre likelihood added to the marginal bins they cover, weighted by the number of grid points they stand for. The marginals are kept relative to
+     * the largest log likelihood found so far and rescaled whenever it increases so they never underflow.
+     * @param pool: Thread pool the cells are evaluated on.
+     * @param num_bins: Number of bins as is private in base class.
+    */
+    void sample_multiresolution(ThreadPool &pool, uint num_bins){
+        std::vector<GridCell> level = coarse_cells(num_bins);
+        REAL max_log_likelihood = -std::numeric_limits<REAL>::infinity();
+        num_likelihood_evaluations = 0;
+        while (!level.empty()){
+            evaluate_level(pool, level, [&](GridCell &cell){
+                evaluate_cell(cell, num_bins);
+            });
+            for (const GridCell &cell: level){
+                num_likelihood_evaluations += cell.num_evaluations;
+            }
+            raise_log_offset(level, max_log_likelihood);
+
+            std::vector<GridCell> next_level;
+            for (const GridCell &cell: level){
+                if (is_single_bin(cell)){
+                    this -> parameter_likelihood[cell_centre(cell, num_bins)] = cell.log_likelihood;
+                    add_cell_to_marginals(cell, max_log_likelihood);
+                }
+                else if (cell.refinement_bound < max_log_likelihood - refinement_threshold){
+                    add_cell_to_marginals(cell, max_log_likelihood);
+                }
+                else{
+                    split_cell(cell, next_level);
+                }
+            }
+            level.swap(next_level);
+        }
+    }
+
+    /**
+     * @brief Branch and bound over the grid. Each level of cells is processed across the thread pool: a single bin cell has its log likelihood evaluated exactly while a larger cell is evaluated at the grid point
+     * nearest its centre, which gives a lower bound on the best grid point, and bounded from above with the interval model over the box spanned by its bin centres.
+     * Cells whose upper bound is more than pruning_threshold below the best grid point found so far are counted as pruned and dropped, the rest are halved. Marginals are accumulated from the
+     * single bin cells only, relative to the running maximum like the multiresolution grid.
+     * @param pool: Thread pool the cells are evaluated on.
+     * @param num_bins: Number of bins as is private in base class.
+    */
+    void sample_branch_and_bound(ThreadPool &pool, uint num_bins){
+        std::vector<GridCell> level = coarse_cells(num_bins);
+        REAL max_log_likelihood = -std::numeric_limits<REAL>::infinity();
+        num_likelihood_evaluations = 0;
+        num_pruned_cells = 0;
+        while (!level.empty()){
+            evaluate_level(pool, level, [&](GridCell &cell){
+                bound_cell(cell);
+            });
+            for (const GridCell &cell: level){
+                num_likelihood_evaluations += cell.num_evaluations;
+            }
+            raise_log_offset(level, max_log_likelihood);
+
+            std::vector<GridCell> next_level;
+            for (const GridCell &cell: level){
+                if (is_single_bin(cell)){
+                    this -> parameter_likelihood[cell_centre(cell, num_bins)] = cell.log_likelihood;
+                    add_cell_to_marginals(cell, max_log_likelihood);
+                }
+                else if (cell.refinement_bound < max_log_likelihood - pruning_threshold){
+                    num_pruned_cells += num_grid_points(cell);
+                }
+                else{
+                    split_cell(cell, next_level);
+                }
+            }
+            level.swap(next_level);
+        }
+    }
+
+    /**
+     * @brief Evaluates the log likelihood at the grid point nearest the centre of a cell and, for cells spanning more than one bin, bounds it over the box between the cell's outermost bin centres.
+    */
+    void bound_cell(GridCell &cell){
+        std::array<REAL, num_params> nearest_point;
+        std::array<Interval<REAL>, num_params> box;
+        for (std::size_t j = 0; j < num_params; j++){
+            nearest_point[j] = bin_centres[j][cell.lower[j] + (cell.upper[j] - cell.lower[j]) / 2];
+            box[j] = Interval<REAL>(bin_centres[j][cell.lower[j]], bin_centres[j][cell.upper[j] - 1]);
+        }
+        cell.log_likelihood = this -> log_likelihood(nearest_point);
+        cell.refinement_bound = is_single_bin(cell) ? cell.log_likelihood : this -> log_likelihood_upper_bound(box);
+        cell.num_evaluations = is_single_bin(cell) ? 1 : 2;
+    }
+
+    /**
+     * @brief: Every combination of num_coarse_bins cells per parameter, clamped to the number of bins.
+    */
+    std::vector<GridCell> coarse_cells(uint num_bins) const {
+        std::vector<GridCell> cells;
+        uint cells_per_param = std::min(num_coarse_bins, num_bins);
+        std::array<uint, num_params> coarse_idx{};
+        while (true){
+            GridCell cell;
+            for (std::size_t j = 0; j < num_params; j++){
+                cell.lower[j] = static_cast<uint>(static_cast<std::uint64_t>(coarse_idx[j]) * num_bins / cells_per_param);
+                cell.upper[j] = static_cast<uint>(static_cast<std::uint64_t>(coarse_idx[j] + 1) * num_bins / cells_per_param);
+            }
+            cells.push_back(cell);
+            std::size_t idx = num_params;
+            while (idx-- > 0 && ++coarse_idx[idx] == cells_per_param){
+                coarse_idx[idx] = 0;
+            }
+            if (idx == static_cast<std::size_t>(-1)){
+                return cells;
+            }
+        }
+    }
+
+    /**
+     * @brief: Runs cell_func on every cell of a level across the thread pool in chunks of grid_chunk_size cells.
+    */
+    template<typename CellFunc>
+    void evaluate_level(ThreadPool &pool, std::vector<GridCell> &level, CellFunc &&cell_func){
+        std::uint64_t num_tasks = (level.size() + grid_chunk_size - 1) / grid_chunk_size;
+        pool.parallel_for(num_tasks, [&](uint, std::uint64_t task){
+            std::size_t task_end = std::min<std::size_t>(level.size(), (task + 1) * grid_chunk_size);
+            for (std::size_t i = task * grid_chunk_size; i < task_end; i++){
+                cell_func(level[i]);
+            }
+        });
+    }
+
+    /**
+     * @brief: Raises max_log_likelihood to the largest cell log likelihood of a level if that is larger, rescaling the marginals accumulated so far to stay relative to it.
+    */
+    void raise_log_offset(const std::vector<GridCell> &level, REAL &max_log_likelihood){
+        REAL level_max = -std::numeric_limits<REAL>::infinity();
+        for (const GridCell &cell: level){
+            level_max = std::max(level_max, cell.log_likelihood);
+        }
+        if (level_max > max_log_likelihood){
+            if (std::isfinite(max_log_likelihood)){
+                rescale_marginal(this -> marginal_distribution, std::exp(max_log_likelihood - level_max));
+            }
+            max_log_likelihood = level_max;
+        }
+    }
+
+    static std::uint64_t num_grid_points(const GridCell &cell){
+        std::uint64_t num_points = 1;
+        for (std::size_t j = 0; j < num_params; j++){
+            num_points *= cell.upper[j] - cell.lower[j];
+        }
+        return num_points;
+    }
+
+    /**
+     * @brief Adds exp(cell log likelihood - log_offset) to every marginal bin the cell covers, once for every grid point of the cell that falls in that bin.
+    */
+    void add_cell_to_marginals(const GridCell &cell, REAL log_offset){
+        REAL likelihood = std::exp(cell.log_likelihood - log_offset);
+        REAL num_points = static_cast<REAL>(num_grid_points(cell));
+        for (std::size_t j = 0; j < num_params; j++){
+            REAL bin_weight = likelihood * num_points / (cell.upper[j] - cell.lower[j]);
+            for (uint k = cell.lower[j]; k < cell.upper[j]; k++){
+                this -> marginal_distribution[j][k] += bin_weight;
+            }
+        }
+    }
+
+    /**
+     * @brief Halves a cell along every parameter that spans more than one bin and appends the children to cells.
+    */
+    static void split_cell(const GridCell &cell, std::vector<GridCell> &cells){
+        std::array<uint, num_params> half{}; // 0 for the lower half, 1 for the upper half
+        while (true){
+            GridCell child;
+            for (std::size_t j = 0; j < num_params; j++){
+                uint mid = cell.lower[j] + (cell.upper[j] - cell.lower[j]) / 2;
+                if (cell.upper[j] - cell.lower[j] == 1){
+                    child.lower[j] = cell.lower[j];
+                    child.upper[j] = cell.upper[j];
+                }
+                else if (half[j] == 0){
+                    child.lower[j] = cell.lower[j];
+                    child.upper[j] = mid;
+                }
+                else{
+                    child.lower[j] = mid;
+                    child.upper[j] = cell.upper[j];
+                }
+            }
+            cells.push_back(child);
+            std::size_t idx = num_params;
+            while (idx-- > 0){
+                if (cell.upper[idx] - cell.lower[idx] == 1){ // axis is not split
+                    continue;
+                }
+                if (++half[idx] < 2){
+                    break;
+                }
+                half[idx] = 0;
+            }
+            if (idx == static_cast<std::size_t>(-1)){
+                return;
+            }
+        }
+    }
+
+    /**
+     * @brief Computes the marginal distributions from the dense tensor. The largest log likelihood is found first and subtracted before exponentiating so the reduction cannot underflow to zero.
+     * Throws if no log likelihood is finite, as the marginals would then be 0 / 0.
+     * @param pool: Thread pool the reductions are run on.
+     * @param num_rows: Number of rows in the grid.
+     * @param num_bins: Number of bins as is private in base class.
+    */
+    void reduce_tensor(ThreadPool &pool, std::uint64_t num_rows, uint num_bins){
+        std::uint64_t rows_per_chunk = std::max<std::uint64_t>(1, grid_chunk_size / num_bins);
+        std::uint64_t num_chunks = (num_rows + rows_per_chunk - 1) / rows_per_chunk;
+        std::vector<REAL> worker_max(pool.size(), -std::numeric_limits<REAL>::infinity());
+        pool.parallel_for(num_chunks, [&](uint worker, std::uint64_t chunk){
+            std::uint64_t chunk_end = std::min(num_rows, (chunk + 1) * rows_per_chunk);
+            worker_max[worker] = std::max(worker_max[worker], likelihood_tensor.max_value(chunk * rows_per_chunk * num_bins, chunk_end * num_bins));
+        });
+        REAL log_offset = *std::max_element(worker_max.begin(), worker_max.end());
+        if (!std::isfinite(log_offset)){ // every likelihood underflowed to zero, or the model gave no usable value, so there is nothing to normalise
+            throw std::runtime_error("Error - No grid point has a finite log likelihood, so the marginal distributions are undefined.");
+        }
+
+        for_each_row_chunk(pool, 0, num_rows, num_bins, [&](std::uint64_t first_row, std::uint64_t last_row, std::vector<std::vector<REAL>>& marginal, REAL& marginal_offset, std::map<std::array<REAL, num_params>, REAL>&){
+            likelihood_tensor.template reduce_axes<num_params>(first_row, last_row, num_bins, log_offset, marginal);
+            marginal_offset = log_offset;
+        });
+    }
 };
\ No newline at end of file
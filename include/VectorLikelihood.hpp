@@ -0,0 +1,233 @@
+#pragma once
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define VECTOR_LIKELIHOOD_X86
+#endif
+
+/**
+ * @brief: Models whose log likelihood has a vectorised kernel, see Sampler::set_vector_model.
+ * polynomial: params[0] x^(n - 1) + ... + params[n - 1] with n the number of parameters, as polynomial, param_3_test_model_func and param_test_model_func.
+ * power_law: params[0] x^params[1], as param_2_model_func. Every input must be positive.
+*/
+enum class VectorModel{
+    polynomial,
+    power_law
+};
+
+/**
+ * @brief: Instruction sets the kernels are compiled for, in increasing order of width.
+*/
+enum class SimdLevel{
+    scalar,
+    avx2,
+    avx512
+};
+
+/**
+ * @brief: Widest instruction set the processor supports, checked once. AVX2 needs FMA as well and AVX-512 only the foundation instructions.
+*/
+inline SimdLevel detected_simd_level(){
+#ifdef VECTOR_LIKELIHOOD_X86
+    static const SimdLevel level = __builtin_cpu_supports("avx512f") ? SimdLevel::avx512
+                                   : (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) ? SimdLevel::avx2 : SimdLevel::scalar;
+    return level;
+#else
+    return SimdLevel::scalar;
+#endif
+}
+
+/**
+ * @brief: One lane of REAL, the portable fallback of the kernels.
+*/
+template<typename REAL>
+struct ScalarLanes
+{
+    using Real = REAL;
+    using Vec = REAL;
+    static constexpr std::size_t width = 1;
+    static Vec zero(){ return 0; }
+    static Vec set1(REAL value){ return value; }
+    static Vec load(const REAL *address){ return *address; }
+    static Vec add(Vec a, Vec b){ return a + b; }
+    static Vec sub(Vec a, Vec b){ return a - b; }
+    static Vec mul(Vec a, Vec b){ return a * b; }
+    static Vec fmadd(Vec a, Vec b, Vec c){ return a * b + c; } // std::fma is emulated in software without hardware support
+    static Vec min(Vec a, Vec b){ return a < b ? a : b; }
+    static Vec max(Vec a, Vec b){ return a > b ? a : b; }
+    static Vec round(Vec a){ return std::nearbyint(a); }
+    static Vec pow2(Vec k){ return std::ldexp(REAL(1), static_cast<int>(k)); }
+    static REAL reduce(Vec a){ return a; }
+};
+
+namespace scalar_kernels{
+#include "LikelihoodKernels.inl"
+}
+
+#ifdef VECTOR_LIKELIHOOD_X86
+#pragma GCC push_options
+#pragma GCC target("avx2,fma")
+template<typename REAL>
+struct Avx2Lanes;
+
+template<>
+struct Avx2Lanes<double>
+{
+    using Real = double;
+    using Vec = __m256d;
+    static constexpr std::size_t width = 4;
+    static Vec zero(){ return _mm256_setzero_pd(); }
+    static Vec set1(double value){ return _mm256_set1_pd(value); }
+    static Vec load(const double *address){ return _mm256_loadu_pd(address); }
+    static Vec add(Vec a, Vec b){ return _mm256_add_pd(a, b); }
+    static Vec sub(Vec a, Vec b){ return _mm256_sub_pd(a, b); }
+    static Vec mul(Vec a, Vec b){ return _mm256_mul_pd(a, b); }
+    static Vec fmadd(Vec a, Vec b, Vec c){ return _mm256_fmadd_pd(a, b, c); }
+    static Vec min(Vec a, Vec b){ return _mm256_min_pd(a, b); }
+    static Vec max(Vec a, Vec b){ return _mm256_max_pd(a, b); }
+    static Vec round(Vec a){ return _mm256_round_pd(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+    static Vec pow2(Vec k){
+        __m256i exponent = _mm256_cvtepi32_epi64(_mm256_cvtpd_epi32(k));
+        return _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_add_epi64(exponent, _mm256_set1_epi64x(1023)), 52));
+    }
+    static double reduce(Vec a){
+        __m128d half = _mm_add_pd(_mm256_castpd256_pd128(a), _mm256_extractf128_pd(a, 1));
+        return _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+    }
+};
+
+template<>
+struct Avx2Lanes<float>
+{
+    using Real = float;
+    using Vec = __m256;
+    static constexpr std::size_t width = 8;
+    static Vec zero(){ return _mm256_setzero_ps(); }
+    static Vec set1(float value){ return _mm256_set1_ps(value); }
+    static Vec load(const float *address){ return _mm256_loadu_ps(address); }
+    static Vec add(Vec a, Vec b){ return _mm256_add_ps(a, b); }
+    static Vec sub(Vec a, Vec b){ return _mm256_sub_ps(a, b); }
+    static Vec mul(Vec a, Vec b){ return _mm256_mul_ps(a, b); }
+    static Vec fmadd(Vec a, Vec b, Vec c){ return _mm256_fmadd_ps(a, b, c); }
+    static Vec min(Vec a, Vec b){ return _mm256_min_ps(a, b); }
+    static Vec max(Vec a, Vec b){ return _mm256_max_ps(a, b); }
+    static Vec round(Vec a){ return _mm256_round_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+    static Vec pow2(Vec k){
+        return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(k), _mm256_set1_epi32(127)), 23));
+    }
+    static float reduce(Vec a){
+        __m128 half = _mm_add_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1));
+        half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+        return _mm_cvtss_f32(_mm_add_ss(half, _mm_movehdup_ps(half)));
+    }
+};
+
+namespace avx2_kernels{
+#include "LikelihoodKernels.inl"
+}
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx512f,avx2,fma")
+// Where the plain AVX-512 intrinsics pass an undefined register as the merge source, which GCC 12 reports as uninitialised, the zero masked forms with every lane selected are used instead.
+template<typename REAL>
+struct Avx512Lanes;
+
+template<>
+struct Avx512Lanes<double>
+{
+    using Real = double;
+    using Vec = __m512d;
+    static constexpr std::size_t width = 8;
+    static constexpr __mmask8 all_lanes = 0xFF;
+    static Vec zero(){ return _mm512_setzero_pd(); }
+    static Vec set1(double value){ return _mm512_set1_pd(value); }
+    static Vec load(const double *address){ return _mm512_loadu_pd(address); }
+    static Vec add(Vec a, Vec b){ return _mm512_add_pd(a, b); }
+    static Vec sub(Vec a, Vec b){ return _mm512_sub_pd(a, b); }
+    static Vec mul(Vec a, Vec b){ return _mm512_mul_pd(a, b); }
+    static Vec fmadd(Vec a, Vec b, Vec c){ return _mm512_fmadd_pd(a, b, c); }
+    static Vec min(Vec a, Vec b){ return _mm512_maskz_min_pd(all_lanes, a, b); }
+    static Vec max(Vec a, Vec b){ return _mm512_maskz_max_pd(all_lanes, a, b); }
+    static Vec round(Vec a){ return _mm512_maskz_roundscale_pd(all_lanes, a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+    static Vec pow2(Vec k){
+        __m512i exponent = _mm512_maskz_cvtepi32_epi64(all_lanes, _mm512_maskz_cvtpd_epi32(all_lanes, k));
+        return _mm512_castsi512_pd(_mm512_maskz_slli_epi64(all_lanes, _mm512_add_epi64(exponent, _mm512_set1_epi64(1023)), 52));
+    }
+    static double reduce(Vec a){
+        return Avx2Lanes<double>::reduce(_mm256_add_pd(_mm512_maskz_extractf64x4_pd(0xF, a, 0), _mm512_maskz_extractf64x4_pd(0xF, a, 1)));
+    }
+};
+
+template<>
+struct Avx512Lanes<float>
+{
+    using Real = float;
+    using Vec = __m512;
+    static constexpr std::size_t width = 16;
+    static constexpr __mmask16 all_lanes = 0xFFFF;
+    static Vec zero(){ return _mm512_setzero_ps(); }
+    static Vec set1(float value){ return _mm512_set1_ps(value); }
+    static Vec load(const float *address){ return _mm512_loadu_ps(address); }
+    static Vec add(Vec a, Vec b){ return _mm512_add_ps(a, b); }
+    static Vec sub(Vec a, Vec b){ return _mm512_sub_ps(a, b); }
+    static Vec mul(Vec a, Vec b){ return _mm512_mul_ps(a, b); }
+    static Vec fmadd(Vec a, Vec b, Vec c){ return _mm512_fmadd_ps(a, b, c); }
+    static Vec min(Vec a, Vec b){ return _mm512_maskz_min_ps(all_lanes, a, b); }
+    static Vec max(Vec a, Vec b){ return _mm512_maskz_max_ps(all_lanes, a, b); }
+    static Vec round(Vec a){ return _mm512_maskz_roundscale_ps(all_lanes, a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+    static Vec pow2(Vec k){
+        return _mm512_castsi512_ps(_mm512_maskz_slli_epi32(all_lanes, _mm512_add_epi32(_mm512_maskz_cvtps_epi32(all_lanes, k), _mm512_set1_epi32(127)), 23));
+    }
+    static float reduce(Vec a){
+        __m512d halves = _mm512_castps_pd(a);
+        __m256 lower = _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xF, halves, 0));
+        __m256 upper = _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xF, halves, 1));
+        return Avx2Lanes<float>::reduce(_mm256_add_ps(lower, upper));
+    }
+};
+
+namespace avx512_kernels{
+#include "LikelihoodKernels.inl"
+}
+#pragma GCC pop_options
+#endif
+
+/**
+ * @brief: Log likelihood of a known model over structure of arrays observations with the kernel of the given instruction set, which the processor must support.
+ * @param inputs: Independent variable of every observation, or its natural logarithm for the power law.
+ * @param weights: 1 / (2 sigma^2) of every observation.
+*/
+template<typename REAL, std::size_t num_params>
+REAL vector_log_likelihood(VectorModel model, SimdLevel level, const std::array<REAL, num_params> &params, const REAL *inputs, const REAL *outputs, const REAL *weights, std::size_t num_points){
+    if (model == VectorModel::power_law){
+        if constexpr (num_params == 2){
+#ifdef VECTOR_LIKELIHOOD_X86
+            if (level == SimdLevel::avx512){
+                return avx512_kernels::power_law_log_likelihood<Avx512Lanes<REAL>>(params, inputs, outputs, weights, num_points);
+            }
+            if (level == SimdLevel::avx2){
+                return avx2_kernels::power_law_log_likelihood<Avx2Lanes<REAL>>(params, inputs, outputs, weights, num_points);
+            }
+#endif
+            return scalar_kernels::power_law_log_likelihood<ScalarLanes<REAL>>(params, inputs, outputs, weights, num_points);
+        }
+        else{
+            throw std::domain_error("Error - The power law model has 2 parameters.");
+        }
+    }
+#ifdef VECTOR_LIKELIHOOD_X86
+    if (level == SimdLevel::avx512){
+        return avx512_kernels::polynomial_log_likelihood<Avx512Lanes<REAL>>(params, inputs, outputs, weights, num_points);
+    }
+    if (level == SimdLevel::avx2){
+        return avx2_kernels::polynomial_log_likelihood<Avx2Lanes<REAL>>(params, inputs, outputs, weights, num_points);
+    }
+#endif
+    return scalar_kernels::polynomial_log_likelihood<ScalarLanes<REAL>>(params, inputs, outputs, weights, num_points);
+}
+
+#undef VECTOR_LIKELIHOOD_X86
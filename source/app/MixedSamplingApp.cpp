@@ -2,12 +2,21 @@
 #include <cstdlib>
 #include "UniformSampler.hpp"
 #include "MetropolisHastingsSampler.hpp"
+#include "ParallelTemperingSampler.hpp"
+#include "EnsembleSampler.hpp"
+#include "HamiltonianSampler.hpp"
+#include "NestedSampler.hpp"
 #include "ModelFunctions.hpp"
 #include <memory>
+#include <optional>
+#include <vector>
+#include <algorithm>
+#include <csignal>
 
 
 /**
  * @brief Factory method function for producing a unique pointer to either a Metropolis Hastings Sampler or Uniform Sampler based on if the total parameter space is larger than or equal to the number of sample points specified.
+ * With more than one temperature a Parallel Tempering Sampler, with walkers set an Ensemble Sampler, with a warm up set a Hamiltonian Sampler, or with live points set a Nested Sampler is produced in place of the Metropolis Hastings Sampler.
  * @param filepath: Filepath to data that the sampling technique will use to fit the parameters of the model.
  * @param func: Function that the data is being fit to. For this application it is y = ax^3 + bx^2 + cx + d. This function must have two arguments: x input value and array of all parameters.
  * @param names: Array of the names of all the parameters.
@@ -17,6 +26,15 @@
  * @param step_size: Standard deviation of the mean centered normal distribution that is used to increment the parameter vector in the unit hypercube space.
  * @param num_sample_points: Max number of points used to sample the distribution.
  * @param rigidity: Rigidity setting for Observations object that loads data. true means that an exception is throw if there is an error with the data. false means that an error message is printed and the erroneous row is skipped but the file still is read.
+ * @param num_threads: Number of threads the Uniform Sampler splits the grid across, or the Ensemble Sampler its walkers.
+ * @param refinement_threshold: If set the Uniform Sampler is always chosen and uses a multiresolution grid that only refines cells within this many nats of the best cell. (optional)
+ * @param pruning_threshold: If set the Uniform Sampler is always chosen and uses branch and bound to prune cells bounded more than this many nats below the best grid point. The sampler then needs an interval model. (optional)
+ * @param force_uniform: Always choose the Uniform Sampler, e.g. for sharded runs. (optional: default = false)
+ * @param num_temperatures: Number of chains in the parallel tempering ladder, 1 for plain Metropolis Hastings. (optional: default = 1)
+ * @param num_walkers: Number of walkers of the Ensemble Sampler, 0 for plain Metropolis Hastings. (optional: default = 0)
+ * @param nuts_warm_up: If set the No-U-Turn Hamiltonian Sampler is used with this many warm up iterations. The sampler then needs a gradient model. (optional)
+ * @param num_live_points: Number of live points of the Nested Sampler, 0 for plain Metropolis Hastings. It takes at most num_sample_points dead points. (optional: default = 0)
+ * @param nested_batch_size: Points the Nested Sampler replaces per iteration, in parallel on up to num_threads threads. (optional: default = 1)
  * @tparam REAL: type representing real numbers; usually float or double.
  * @tparam num_params: number of parameters that are being used to fit the model.
  * @return Unique pointer to class that is derived from the base abstract Sampler class. Either Uniform Sampler or MCMC sampler.
@@ -31,11 +49,49 @@ std::unique_ptr<Sampler<REAL, num_params>> SamplerGen(
     uint num_bins = 100, 
     REAL step_size = 0.01, 
     uint num_sample_points = 100000, 
-    bool rigidity = false)
+    bool rigidity = false,
+    uint num_threads = 1,
+    std::optional<REAL> refinement_threshold = std::nullopt,
+    std::optional<REAL> pruning_threshold = std::nullopt,
+    bool force_uniform = false,
+    uint num_temperatures = 1,
+    uint num_walkers = 0,
+    std::optional<uint> nuts_warm_up = std::nullopt,
+    uint num_live_points = 0,
+    uint nested_batch_size = 1)
     {
-        if (num_sample_points >= std::pow(num_bins,num_params)){
+        if (force_uniform || refinement_threshold || pruning_threshold || num_sample_points >= std::pow(num_bins,num_params)){
             std::cout << "Uniform Sampler Initiated" << std::endl;
-            return std::make_unique<UniformSampler<REAL,num_params>>(filepath, func, names, min_values, max_values, num_bins, rigidity);
+            std::unique_ptr<UniformSampler<REAL,num_params>> uniform_sampler = std::make_unique<UniformSampler<REAL,num_params>>(filepath, func, names, min_values, max_values, num_bins, rigidity);
+            uniform_sampler->set_num_threads(num_threads);
+            if (refinement_threshold){
+                uniform_sampler->use_multiresolution(refinement_threshold.value());
+            }
+            if (pruning_threshold){
+                uniform_sampler->use_branch_and_bound(pruning_threshold.value());
+            }
+            return uniform_sampler;
+        }
+        else if (num_live_points > 0){
+            std::cout << "Nested Sampler Initiated" << std::endl;
+            std::unique_ptr<NestedSampler<REAL,num_params>> nested_sampler = std::make_unique<NestedSampler<REAL,num_params>>(filepath, func, names, min_values, max_values, num_live_points, 0.01, num_sample_points, num_bins, rigidity);
+            nested_sampler->set_batch_size(nested_batch_size);
+            nested_sampler->set_num_threads(num_threads);
+            return nested_sampler;
+        }
+        else if (nuts_warm_up){
+            std::cout << "Hamiltonian Sampler Initiated" << std::endl;
+            return std::make_unique<HamiltonianSampler<REAL,num_params>>(filepath, func, names, min_values, max_values, num_sample_points, nuts_warm_up.value(), 0.8, 10, num_bins, rigidity);
+        }
+        else if (num_walkers > 0){
+            std::cout << "Ensemble Sampler Initiated" << std::endl;
+            std::unique_ptr<EnsembleSampler<REAL,num_params>> ensemble_sampler = std::make_unique<EnsembleSampler<REAL,num_params>>(filepath, func, names, min_values, max_values, num_sample_points, num_walkers, 2, num_bins, rigidity);
+            ensemble_sampler->set_num_threads(num_threads);
+            return ensemble_sampler;
+        }
+        else if (num_temperatures > 1){
+            std::cout << "Parallel Tempering Sampler Initiated" << std::endl;
+            return std::make_unique<ParallelTemperingSampler<REAL,num_params>>(filepath, func, names, min_values, max_values, num_sample_points, step_size, num_temperatures, 100, 100, num_bins, rigidity);
         }
         else{
             std::cout << "Metropolis Hastings Sampler Initiated" << std::endl;
@@ -60,6 +116,28 @@ void HelpMessage(){
               << "  -cr <upper,lower>        Range for parameter c                       (optional: default = -3,3)\n"
               << "  -dr <upper,lower>        Range for parameter d                       (optional: default = -3,3)\n"
               << "  -p  <plot>               Plot condition (Y/N)                        (optional: default = Y)\n"
+              << "  -t  <threads>            Number of threads for uniform or ensemble sampling (optional: default = 1)\n"
+              << "  -c  <chains>             Number of MCMC chains, one thread each      (optional: default = 1)\n"
+              << "  -ad <iterations>         Iterations the MCMC proposal adapts over    (optional)\n"
+              << "  -bi <draws>              Draws of every MCMC chain discarded as burn in (optional: default = 0)\n"
+              << "  -th <interval>           Keep every interval-th MCMC draw after the burn in (optional: default = 1)\n"
+              << "  -tr <path>               Stream the kept MCMC draws to a binary trace file (optional)\n"
+              << "  -ess <target>            Stop MCMC once every parameter reaches this effective sample size, -s then caps each chain (optional)\n"
+              << "  -mb <batch_size>         MCMC steps estimate the likelihood ratio from a minibatch of the data, for -m models (optional)\n"
+              << "  -pt <temperatures>       MCMC with parallel tempering over temperatures 1 to 100, one thread each (optional)\n"
+              << "  -e  <walkers>            MCMC with an affine invariant ensemble of walkers (optional)\n"
+              << "  -nuts <warm_up>          MCMC with the No-U-Turn Hamiltonian sampler after warm_up tuning iterations (optional)\n"
+              << "  -ns <live_points>        Nested sampling for the evidence (optional)\n"
+              << "  -nb <batch>              Nested sampling points replaced at a time, in parallel on -t threads (optional: default = 1)\n"
+              << "  -d  <mem|path>           Uniform sampling stores likelihoods in a dense tensor, in memory or memory mapped to path (optional)\n"
+              << "  -r  <log_threshold>      Uniform sampling on a multiresolution grid refining cells within log_threshold of the best (optional)\n"
+              << "  -b  <log_threshold>      Uniform sampling with branch and bound pruning cells bounded more than log_threshold below the best (optional)\n"
+              << "  --shard <i/k>            Uniform sampling of only shard i of k of the grid, written to a shard file (optional)\n"
+              << "  -o  <path>               Shard file written by --shard               (optional: default = shard_<i>_of_<k>.bin)\n"
+              << "  --merge <f1,f2,...>      Merge the shard files of every shard instead of sampling (optional)\n"
+              << "  -k  <path>               Checkpoint file, resumed from if it exists  (optional)\n"
+              << "  -ki <seconds>            Time between checkpoints                    (optional: default = 600)\n"
+              << "  -m  <expression>         Model of x, a, b, c and d fitted instead of the cubic, e.g. \"a*x^b + c*exp(-d*x)\" (optional)\n"
               << "  -g  <rigidity>           Strictness when Reading Data File (Bool)    (optional: default = false)" << std::endl;
 }
 
@@ -86,6 +164,36 @@ std::array<double,2> split(std::string ranges){
     return {std::stod(lower), std::stod(upper)};
 }
 
+/**
+ * @brief: Parses a shard given as index/count, e.g. 2/8.
+*/
+std::array<uint,2> split_shard(const std::string &shard){
+    std::size_t idx_slash = shard.find('/');
+    if (idx_slash == std::string::npos){
+        throw std::invalid_argument("Missing / in shard.");
+    }
+    return {static_cast<uint>(std::stoul(shard.substr(0, idx_slash))), static_cast<uint>(std::stoul(shard.substr(idx_slash + 1)))};
+}
+
+// splits a comma separated list of file paths.
+std::vector<std::string> split_list(const std::string &list){
+    std::vector<std::string> items;
+    std::size_t start = 0;
+    while (start <= list.size()){
+        std::size_t idx_comma = std::min(list.find(',', start), list.size());
+        if (idx_comma > start){
+            items.push_back(list.substr(start, idx_comma - start));
+        }
+        start = idx_comma + 1;
+    }
+    return items;
+}
+
+// SIGTERM / SIGINT handler: the sampler writes a checkpoint at its next opportunity and stops.
+extern "C" void CheckpointSignalHandler(int){
+    request_checkpoint_stop();
+}
+
 
 int main(int argc, char** argv)
 {
@@ -104,6 +212,43 @@ int main(int argc, char** argv)
     bool plot_condition = true;
     bool plot_condition_set = false;
     bool number_samples_set = false;
+    uint num_threads = 1;
+    bool num_threads_set = false;
+    std::string tensor_storage;
+    bool tensor_storage_set = false;
+    std::optional<double> refinement_threshold;
+    std::optional<double> pruning_threshold;
+    std::optional<std::array<uint,2>> shard;
+    std::string shard_output;
+    bool shard_output_set = false;
+    std::vector<std::string> merge_files;
+    std::string checkpoint_file;
+    bool checkpoint_file_set = false;
+    double checkpoint_interval = 600;
+    bool checkpoint_interval_set = false;
+    uint num_chains = 1;
+    bool num_chains_set = false;
+    uint adaptation_iterations = 0;
+    bool adaptation_iterations_set = false;
+    double target_ess = 0;
+    bool target_ess_set = false;
+    int burn_in = 0;
+    bool burn_in_set = false;
+    int thinning = 1;
+    bool thinning_set = false;
+    std::string trace_path;
+    std::optional<std::string> model_text;
+    int minibatch_size = 0;
+    bool minibatch_size_set = false;
+    uint num_temperatures = 1;
+    bool num_temperatures_set = false;
+    uint num_walkers = 0;
+    bool num_walkers_set = false;
+    std::optional<uint> nuts_warm_up;
+    int num_live_points = 0;
+    bool num_live_points_set = false;
+    int nested_batch_size = 1;
+    bool nested_batch_size_set = false;
     std::array<double,2> a_range;
     std::array<double, 2> b_range;
     std::array<double, 2> c_range;
@@ -255,18 +400,293 @@ int main(int argc, char** argv)
                 return 1;
             }
         }
+        else if (arg == "-d"){
+            if (tensor_storage_set){
+                std::cerr << "Error - Cannot set the dense likelihood storage twice!" << std::endl;
+                HelpMessage();
+                return 1;
+            }
+            std::string arg1(argv[i+1]);
+            tensor_storage = arg1;
+            tensor_storage_set = true;
+        }
+        else if (arg == "-r"){
+            if (refinement_threshold){
+                std::cerr << "Error - Cannot set the refinement threshold twice!" << std::endl;
+                HelpMessage();
+                return 1;
+            }
+            std::string arg1(argv[i+1]);
+            try{
+                refinement_threshold = std::stod(arg1);
+            }
+            catch(const std::invalid_argument&){
+                std::cerr << "Error - the refinement threshold has had incorrect inputs!" << std::endl;
+                HelpMessage();
+                return 1;
+            }
+        }
+        else if (arg == "-b"){
+            if (pruning_threshold){
+                std::cerr << "Error - Cannot set the pruning threshold twice!" << std::endl;
+                HelpMessage();
+                return 1;
+            }
+            std::string arg1(argv[i+1]);
+            try{
+                pruning_threshold = std::stod(arg1);
+            }
+            catch(const std::invalid_argument&){
+                std::cerr << "Error - the pruning threshold has had incorrect inputs!" << std::endl;
+                HelpMessage();
+                return 1;
+            }
+        }
+        else if (arg == "--shard"){
+            if (shard){
+                std::cerr << "Error - Cannot set the shard twice!" << std::endl;
+                HelpMessage();
+                return 1;
+            }
+            std::string arg1(argv[i+1]);
+            try{
+                shard = split_shard(arg1);
+            }
+            catch(const std::exception&){
+                std::cerr << "Error - the shard has had incorrect inputs!" << std::endl;
+                HelpMessage();
+                return 1;
+            }
+        }
+        else if (arg == "-o"){
+            if (shard_output_set){
+                std::cerr << "Error - Cannot set the shard file twice!" << std::endl;
+                HelpMessage();
+                return 1;
+            }
+            std::string arg1(argv[i+1]);
+            shard_output = arg1;
+            shard_output_set = true;
+        }
+        else if (arg == "--merge"){
+            if (!merge_files.empty()){
+                std::cerr << "Error - Cannot set the shard files to merge twice!" << std::endl;
+                HelpMessage();
+                return 1;
+            }
+            std::string arg1(argv[i+1]);
+            merge_files = split_list(arg1);
+            if (merge_files.empty()){
+                std::cerr << "Error - please input the shard files to merge!" << std::endl;
+                HelpMessage();
+                return 1;
+            }
+        }
+        else if (arg == "-k"){
+            if (checkpoint_file_set){
+                std::cerr << "Error - Cannot set the checkpoint file twice!" << std::endl;
+                HelpMessage();
+                return 1;
+            }
+            std::string arg1(argv[i+1]);
+            checkpoint_file = arg1;
+            checkpoint_file_set = true;
+        }
+        else if (arg == "-ki"){
+            if (checkpoint_interval_set){
+                std::cerr << "Error - Cannot set the checkpoint interval twice!" << std::endl;
+                HelpMessage();
+                return 1;
+            }
+            std::string arg1(argv[i+1]);
+            try{
+                checkpoint_interval = std::stod(arg1);
+            }
+            catch(const std::invalid_argument&){
+                std::cerr << "Error - the checkpoint interval has had incorrect inputs!" << std::endl;
+                HelpMessage();
+                return 1;
+            }
+            checkpoint_interval_set = true;
+        }
+        else if (arg == "-c"){
+            if (num_chains_set){
+                std::cerr << "Error - Cannot set the number of chains twice!" << std::endl;
+                HelpMessage();
+                return 1;
+            }
+            std::string arg1(argv[i+1]);
+            num_chains = std::atoi(arg1.c_str());
+            num_chains_set = true;
+        }
+        else if (arg == "-ad"){
+            if (adaptation_iterations_set){
+                std::cerr << "Error - Cannot set the number of adaptation iterations twice!" << std::endl;
+                HelpMessage();
+                return 1;
+            }
+            std::string arg1(argv[i+1]);
+            adaptation_iterations = std::atoi(arg1.c_str());
+            adaptation_iterations_set = true;
+        }
+        else if (arg == "-bi"){
+            if (burn_in_set){
+                std::cerr << "Error - Cannot set the burn in twice!" << std::endl;
+                HelpMessage();
+                return 1;
+            }
+            std::string arg1(argv[i+1]);
+            burn_in = std::atoi(arg1.c_str());
+            burn_in_set = true;
+        }
+        else if (arg == "-th"){
+            if (thinning_set){
+                std::cerr << "Error - Cannot set the thinning twice!" << std::endl;
+                HelpMessage();
+                return 1;
+            }
+            std::string arg1(argv[i+1]);
+            thinning = std::atoi(arg1.c_str());
+            thinning_set = true;
+        }
+        else if (arg == "-m"){
+            if (model_text){
+                std::cerr << "Error - Cannot set the model twice!" << std::endl;
+                HelpMessage();
+                return 1;
+            }
+            model_text = argv[i+1];
+        }
+        else if (arg == "-tr"){
+            if (!trace_path.empty()){
+                std::cerr << "Error - Cannot set the trace file twice!" << std::endl;
+                HelpMessage();
+                return 1;
+            }
+            trace_path = argv[i+1];
+        }
+        else if (arg == "-ess"){
+            if (target_ess_set){
+                std::cerr << "Error - Cannot set the target effective sample size twice!" << std::endl;
+                HelpMessage();
+                return 1;
+            }
+            std::string arg1(argv[i+1]);
+            target_ess = std::atof(arg1.c_str());
+            target_ess_set = true;
+        }
+        else if (arg == "-mb"){
+            if (minibatch_size_set){
+                std::cerr << "Error - Cannot set the minibatch size twice!" << std::endl;
+                HelpMessage();
+                return 1;
+            }
+            std::string arg1(argv[i+1]);
+            minibatch_size = std::atoi(arg1.c_str());
+            minibatch_size_set = true;
+        }
+        else if (arg == "-pt"){
+            if (num_temperatures_set){
+                std::cerr << "Error - Cannot set the number of temperatures twice!" << std::endl;
+                HelpMessage();
+                return 1;
+            }
+            std::string arg1(argv[i+1]);
+            num_temperatures = std::atoi(arg1.c_str());
+            num_temperatures_set = true;
+        }
+        else if (arg == "-e"){
+            if (num_walkers_set){
+                std::cerr << "Error - Cannot set the number of walkers twice!" << std::endl;
+                HelpMessage();
+                return 1;
+            }
+            std::string arg1(argv[i+1]);
+            num_walkers = std::atoi(arg1.c_str());
+            num_walkers_set = true;
+        }
+        else if (arg == "-nuts"){
+            if (nuts_warm_up){
+                std::cerr << "Error - Cannot set the number of warm up iterations twice!" << std::endl;
+                HelpMessage();
+                return 1;
+            }
+            std::string arg1(argv[i+1]);
+            nuts_warm_up = std::atoi(arg1.c_str());
+        }
+        else if (arg == "-ns"){
+            if (num_live_points_set){
+                std::cerr << "Error - Cannot set the number of live points twice!" << std::endl;
+                HelpMessage();
+                return 1;
+            }
+            std::string arg1(argv[i+1]);
+            num_live_points = std::atoi(arg1.c_str());
+            num_live_points_set = true;
+        }
+        else if (arg == "-nb"){
+            if (nested_batch_size_set){
+                std::cerr << "Error - Cannot set the nested sampling batch size twice!" << std::endl;
+                HelpMessage();
+                return 1;
+            }
+            std::string arg1(argv[i+1]);
+            nested_batch_size = std::atoi(arg1.c_str());
+            nested_batch_size_set = true;
+        }
+        else if (arg == "-t"){
+            if (num_threads_set){
+                std::cerr << "Error - Cannot set the number of threads twice!" << std::endl;
+                HelpMessage();
+                return 1;
+            }
+            std::string arg1(argv[i+1]);
+            num_threads = std::atoi(arg1.c_str());
+            num_threads_set = true;
+        }
         else{
             std::cerr << "Invalid Flag Detected: " << arg << std::endl; // outlier flags.
             return 1;
         }
     }// checking for invalid flags or insufficient flags
-    if (!(num_bins_set && filepath_set && number_samples_set)){
+    if (num_temperatures_set + num_walkers_set + nuts_warm_up.has_value() + num_live_points_set > 1){
+        std::cerr << "Error - Choose only one of parallel tempering, the ensemble sampler, the Hamiltonian sampler and nested sampling!" << std::endl;
+        HelpMessage();
+        return 1;
+    }
+    bool metropolis_hastings_flag_set = num_chains_set || adaptation_iterations_set || target_ess_set || burn_in_set || thinning_set || !trace_path.empty() || minibatch_size_set;
+    if (metropolis_hastings_flag_set && num_temperatures_set + num_walkers_set + nuts_warm_up.has_value() + num_live_points_set > 0){
+        std::cerr << "Error - -c, -ad, -ess, -bi, -th, -tr and -mb only apply to the Metropolis Hastings Sampler and cannot be combined with -pt, -e, -nuts or -ns!" << std::endl;
+        HelpMessage();
+        return 1;
+    }
+    if (tensor_storage_set && (metropolis_hastings_flag_set || num_temperatures_set + num_walkers_set + nuts_warm_up.has_value() + num_live_points_set > 0)){
+        std::cerr << "Error - -d only applies to the Uniform Sampler and cannot be combined with the MCMC options!" << std::endl;
+        HelpMessage();
+        return 1;
+    }
+    if (nested_batch_size_set && !num_live_points_set){
+        std::cerr << "Error - -nb only applies to nested sampling and needs -ns!" << std::endl;
+        HelpMessage();
+        return 1;
+    }
+    if (minibatch_size_set && !model_text){
+        std::cerr << "Error - -mb needs a model given with -m: the cubic is linear in its parameters, so its full likelihood is already cheaper than a minibatch estimate!" << std::endl;
+        HelpMessage();
+        return 1;
+    }
+    if (shard && !merge_files.empty()){
+        std::cerr << "Error - A shard cannot be sampled and merged at the same time!" << std::endl;
+        HelpMessage();
+        return 1;
+    }
+    if (!(num_bins_set && filepath_set && (number_samples_set || shard || !merge_files.empty()))){ // sharded runs always use the Uniform Sampler so need no samples.
         std::cerr << "Please enter the number of bins, filepath and the number of parameters to sample!" << std::endl;
         HelpMessage();
         return 1;
     }
 
-    if (filepath.empty() || num_bins <= 0){
+    if (filepath.empty() || num_bins <= 0 || num_threads <= 0 || num_chains <= 0 || (adaptation_iterations_set && adaptation_iterations <= 0) || (target_ess_set && !(target_ess > 0)) || burn_in < 0 || (burn_in_set && static_cast<uint>(burn_in) >= num_samples) || thinning <= 0 || (minibatch_size_set && minibatch_size < 2) || (num_temperatures_set && num_temperatures < 2) || (num_walkers_set && num_walkers <= 0) || (num_live_points_set && (num_live_points < 2 || nested_batch_size <= 0 || 2 * nested_batch_size > num_live_points))){
         std::cout << "Invalid or Invalid Arguments" << std::endl;
         HelpMessage();
         return 1;
@@ -309,9 +729,19 @@ int main(int argc, char** argv)
     }
 
     std::unique_ptr<Sampler<double, 4>> sampler_ptr;
+    std::optional<BytecodeModel<double, 4>> model;
 
     try{
-        sampler_ptr = SamplerGen<double, 4>(filepath,polynomial<double>,names, min_vals, max_vals, num_bins, 0.01, num_samples,rigidity); // use of factory method which returns value which is assigned to unique pointer for Sampler base class. Example of polymorphism.
+        if (model_text){
+            model.emplace(model_text.value(), names);
+            for (std::size_t i = 0; i < 4; i++){
+                if (!model->uses_param(i)){
+                    std::cerr << "Warning: Parameter " << names[i] << " does not appear in the model." << std::endl;
+                }
+            }
+        }
+        std::function<double(double, std::array<double, 4>&)> func = model ? std::function<double(double, std::array<double, 4>&)>(model.value()) : polynomial<double>;
+        sampler_ptr = SamplerGen<double, 4>(filepath,func,names, min_vals, max_vals, num_bins, 0.01, num_samples,rigidity,num_threads,refinement_threshold,pruning_threshold,shard.has_value() || !merge_files.empty(),num_temperatures,num_walkers,nuts_warm_up,num_live_points,nested_batch_size); // use of factory method which returns value which is assigned to unique pointer for Sampler base class. Example of polymorphism.
     }
     catch(const std::exception &e){
         std::cerr << e.what() << std::endl;
@@ -319,20 +749,141 @@ int main(int argc, char** argv)
         return 1;
     }
 
-    sampler_ptr->sample();
+    MetropolisHastingSampler<double, 4>* mcmc_sampler_ptr = dynamic_cast<MetropolisHastingSampler<double, 4>*>(sampler_ptr.get()); // only MCMC has chains to run.
+    if (mcmc_sampler_ptr){
+        mcmc_sampler_ptr->set_num_chains(num_chains);
+        if (adaptation_iterations_set){
+            mcmc_sampler_ptr->use_adaptive_proposal(adaptation_iterations);
+        }
+        if (target_ess_set){
+            mcmc_sampler_ptr->stop_at_effective_sample_size(target_ess);
+        }
+        mcmc_sampler_ptr->set_burn_in(burn_in);
+        mcmc_sampler_ptr->set_thinning(thinning);
+        if (!trace_path.empty()){
+            mcmc_sampler_ptr->stream_trace(trace_path);
+        }
+        if (minibatch_size_set){
+            mcmc_sampler_ptr->use_minibatch_likelihood(minibatch_size);
+        }
+    }
+
+    if (tensor_storage_set){
+        UniformSampler<double, 4>* uniform_sampler_ptr = dynamic_cast<UniformSampler<double, 4>*>(sampler_ptr.get()); // only the grid scan has a dense tensor to store.
+        if (!uniform_sampler_ptr){
+            std::cerr << "Error - -d only applies to the Uniform Sampler, which is only chosen when -s is at least the number of grid points!" << std::endl;
+            return 1;
+        }
+        uniform_sampler_ptr->use_dense_storage(tensor_storage == "mem" ? "" : tensor_storage);
+    }
+
+    if (shard || !merge_files.empty()){
+        UniformSampler<double, 4>* uniform_sampler_ptr = dynamic_cast<UniformSampler<double, 4>*>(sampler_ptr.get()); // SamplerGen always gives a Uniform Sampler for sharded runs.
+        try{
+            if (shard){
+                if (!shard_output_set){
+                    shard_output = "shard_" + std::to_string(shard.value()[0]) + "_of_" + std::to_string(shard.value()[1]) + ".bin";
+                }
+                uniform_sampler_ptr->set_shard(shard.value()[0], shard.value()[1], shard_output);
+            }
+            else{
+                uniform_sampler_ptr->merge_shards(merge_files);
+            }
+        }
+        catch(const std::exception &e){
+            std::cerr << e.what() << std::endl;
+            HelpMessage();
+            return 1;
+        }
+    }
+
+    sampler_ptr->set_model_name(model_text ? model_text.value() : "cubic"); // checkpoints and shard files record the model, so they cannot be resumed or merged under another one.
+    if (model){ // the bytecode model evaluates many rows per call and also serves as the interval and gradient model, its x independent part run once per box or parameter vector.
+        sampler_ptr->set_block_model([bytecode = model.value()](const std::array<double, 4> &params, const double *inputs, double *outputs, std::size_t count){
+            bytecode.evaluate(params, inputs, outputs, count);
+        });
+        sampler_ptr->set_interval_model(model.value());
+        sampler_ptr->set_gradient_model(model.value());
+    }
+    else{
+        sampler_ptr->set_linear_model(polynomial_basis<double>()); // cubic is linear in a, b, c and d so the likelihood only needs the sufficient statistics of the data.
+        sampler_ptr->set_interval_model(polynomial<Interval<double>>); // bounds the likelihood over a box of parameters for branch and bound.
+        sampler_ptr->set_gradient_model(polynomial<Dual<double, 4>>); // differentiates the likelihood for the Hamiltonian sampler and linearises it for the minibatch likelihood.
+    }
+    if (merge_files.empty()){
+        try{
+            if (checkpoint_file_set){
+                sampler_ptr->enable_checkpoints(checkpoint_file, checkpoint_interval);
+                std::signal(SIGTERM, CheckpointSignalHandler);
+                std::signal(SIGINT, CheckpointSignalHandler);
+            }
+            sampler_ptr->sample();
+        }
+        catch(const SamplingInterrupted &e){
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+        catch(const std::exception &e){
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+        if (sampler_ptr->resumed_from_checkpoint()){
+            std::cout << "Resumed from checkpoint " << checkpoint_file << std::endl;
+        }
+    }
+    if (shard){ // a single shard only holds part of the posterior so it is not summarised.
+        std::cout << "Shard " << shard.value()[0] << "/" << shard.value()[1] << " written to " << shard_output << std::endl;
+        return 0;
+    }
     sampler_ptr->summarise();
 
     std::string sample_mode; // so files sent to correct folder based off sampling technique.
-    if (num_samples >= std::pow(num_bins, 4)){
+    UniformSampler<double, 4>* uniform_sampler_ptr = dynamic_cast<UniformSampler<double, 4>*>(sampler_ptr.get());
+    if (uniform_sampler_ptr){
         sample_mode = "Uniform";
+        if (uniform_sampler_ptr->uses_multiresolution()){
+            std::cout << "Multiresolution grid made " << uniform_sampler_ptr->get_num_likelihood_evaluations() << " likelihood evaluations" << std::endl;
+        }
+        if (uniform_sampler_ptr->uses_branch_and_bound()){
+            std::cout << "Branch and bound pruned " << uniform_sampler_ptr->get_num_pruned_cells() << " cells" << std::endl;
+        }
     }
-    else{
+    else if (mcmc_sampler_ptr){
         sample_mode = "MHS";
+        std::cout << "Iterations - " << mcmc_sampler_ptr->get_num_iterations() << std::endl;
+        if (mcmc_sampler_ptr->uses_minibatch_likelihood()){
+            std::cout << "Minibatch estimate variance - " << mcmc_sampler_ptr->get_minibatch_variance() << std::endl;
+        }
+    }
+    else if (HamiltonianSampler<double, 4>* hamiltonian_sampler_ptr = dynamic_cast<HamiltonianSampler<double, 4>*>(sampler_ptr.get())){
+        sample_mode = "NUTS";
+        std::cout << "Step size - " << hamiltonian_sampler_ptr->get_step_size() << ", mean tree depth - " << hamiltonian_sampler_ptr->get_mean_tree_depth()
+                  << ", gradient evaluations - " << hamiltonian_sampler_ptr->get_num_gradient_evaluations() << ", divergences - " << hamiltonian_sampler_ptr->get_num_divergences() << std::endl;
+    }
+    else if (NestedSampler<double, 4>* nested_sampler_ptr = dynamic_cast<NestedSampler<double, 4>*>(sampler_ptr.get())){
+        sample_mode = "Nested";
+        std::cout << "Log evidence - " << nested_sampler_ptr->get_log_evidence() << " +/- " << nested_sampler_ptr->get_log_evidence_error() << ", information - " << nested_sampler_ptr->get_information()
+                  << " nats, iterations - " << nested_sampler_ptr->get_num_iterations() << ", likelihood evaluations - " << nested_sampler_ptr->get_num_likelihood_evaluations() << std::endl;
+    }
+    else if (EnsembleSampler<double, 4>* ensemble_sampler_ptr = dynamic_cast<EnsembleSampler<double, 4>*>(sampler_ptr.get())){
+        sample_mode = "Ensemble";
+        std::cout << "Acceptance rate - " << ensemble_sampler_ptr->get_acceptance_rate() << std::endl;
+    }
+    else{
+        sample_mode = "PT";
+        ParallelTemperingSampler<double, 4>* tempering_sampler_ptr = dynamic_cast<ParallelTemperingSampler<double, 4>*>(sampler_ptr.get());
+        std::cout << "Swap acceptance rates -";
+        for (double rate: tempering_sampler_ptr->get_swap_acceptance_rates()){
+            std::cout << " " << rate;
+        }
+        std::cout << std::endl;
     }
 
     if (plot_condition){
-        sampler_ptr->plot_histograms("cubic","Sample4D/" + sample_mode);
-        sampler_ptr->plot_best_fit("cubic", "Sample4D/" + sample_mode);
+        std::string func_desc = model_text ? "y=" + model_text.value() : "cubic";
+        std::replace(func_desc.begin(), func_desc.end(), '/', '_'); // func_desc is part of the plot file names, where / would start a directory
+        sampler_ptr->plot_histograms(func_desc,"Sample4D/" + sample_mode);
+        sampler_ptr->plot_best_fit(func_desc, "Sample4D/" + sample_mode);
     }
     
     return 0;
@@ -3,6 +3,10 @@
 #include "UniformSampler.hpp"
 #include "ModelFunctions.hpp"
 #include <memory>
+#include <optional>
+#include <vector>
+#include <algorithm>
+#include <csignal>
 /**
  * @brief: This function prints out a help message that helps the user use the Sample2D application.
 */
@@ -16,6 +20,16 @@ void HelpMessage(){
               << "  -ar <upper,lower> Range for parameter a             (optional: default = 0,5)\n"
               << "  -br <upper,lower> Range for parameter b             (optional: default = 0,5)\n"
               << "  -p  <plot>        Plot condition (Y/N)              (optional: default = Y)\n"
+              << "  -t  <threads>     Number of threads for sampling    (optional: default = 1)\n"
+              << "  -d  <mem|path>    Store likelihoods in a dense tensor, in memory or memory mapped to path (optional)\n"
+              << "  -r  <log_threshold> Multiresolution grid refining cells within log_threshold of the best (optional)\n"
+              << "  -b  <log_threshold> Branch and bound pruning cells bounded more than log_threshold below the best (optional)\n"
+              << "  --shard <i/k>     Only sample shard i of k of the grid and write it to a shard file (optional)\n"
+              << "  -o  <path>        Shard file written by --shard     (optional: default = shard_<i>_of_<k>.bin)\n"
+              << "  --merge <f1,f2,...> Merge the shard files of every shard instead of sampling (optional)\n"
+              << "  -k  <path>        Checkpoint file, resumed from if it exists (optional)\n"
+              << "  -ki <seconds>     Time between checkpoints          (optional: default = 600)\n"
+              << "  -m  <expression>  Model of x, a and b fitted instead of ax^b, e.g. \"a*exp(-x/b)\" (optional)\n"
               << "  -g  <rigidity>    Strictness when Reading Data File (optional: default = false)" << std::endl;
 }
 // finds index of comma in string and then uses it as delimiter to split into two substrings. Converts string to double after.
@@ -42,6 +56,36 @@ std::array<double,2> split(std::string ranges){
     return {std::stod(lower), std::stod(upper)};
 }
 
+/**
+ * @brief: Parses a shard given as index/count, e.g. 2/8.
+*/
+std::array<uint,2> split_shard(const std::string &shard){
+    std::size_t idx_slash = shard.find('/');
+    if (idx_slash == std::string::npos){
+        throw std::invalid_argument("Missing / in shard.");
+    }
+    return {static_cast<uint>(std::stoul(shard.substr(0, idx_slash))), static_cast<uint>(std::stoul(shard.substr(idx_slash + 1)))};
+}
+
+// splits a comma separated list of file paths.
+std::vector<std::string> split_list(const std::string &list){
+    std::vector<std::string> items;
+    std::size_t start = 0;
+    while (start <= list.size()){
+        std::size_t idx_comma = std::min(list.find(',', start), list.size());
+        if (idx_comma > start){
+            items.push_back(list.substr(start, idx_comma - start));
+        }
+        start = idx_comma + 1;
+    }
+    return items;
+}
+
+// SIGTERM / SIGINT handler: the sampler writes a checkpoint at its next opportunity and stops.
+extern "C" void CheckpointSignalHandler(int){
+    request_checkpoint_stop();
+}
+
 
 int main(int argc, char** argv)
 {
@@ -55,6 +99,21 @@ int main(int argc, char** argv)
     bool rigidity_set = false;
     bool plot_condition = true;
     bool plot_condition_set = false;
+    uint num_threads = 1;
+    bool num_threads_set = false;
+    std::string tensor_storage;
+    bool tensor_storage_set = false;
+    std::optional<double> refinement_threshold;
+    std::optional<double> pruning_threshold;
+    std::optional<std::array<uint,2>> shard;
+    std::string shard_output;
+    bool shard_output_set = false;
+    std::vector<std::string> merge_files;
+    std::string checkpoint_file;
+    bool checkpoint_file_set = false;
+    double checkpoint_interval = 600;
+    bool checkpoint_interval_set = false;
+    std::optional<std::string> model_text;
     std::array<double,2> a_range;
     std::array<double, 2> b_range;
 
@@ -161,6 +220,133 @@ int main(int argc, char** argv)
                 return 1;
             }
         }
+        else if (arg == "-d"){
+            if (tensor_storage_set){
+                std::cerr << "Error - Cannot set the dense likelihood storage twice!" << std::endl;
+                HelpMessage();
+                return 1;
+            }
+            std::string arg1(argv[i+1]);
+            tensor_storage = arg1;
+            tensor_storage_set = true;
+        }
+        else if (arg == "-r"){
+            if (refinement_threshold){
+                std::cerr << "Error - Cannot set the refinement threshold twice!" << std::endl;
+                HelpMessage();
+                return 1;
+            }
+            std::string arg1(argv[i+1]);
+            try{
+                refinement_threshold = std::stod(arg1);
+            }
+            catch(const std::invalid_argument&){
+                std::cerr << "Error - the refinement threshold has had incorrect inputs!" << std::endl;
+                HelpMessage();
+                return 1;
+            }
+        }
+        else if (arg == "-b"){
+            if (pruning_threshold){
+                std::cerr << "Error - Cannot set the pruning threshold twice!" << std::endl;
+                HelpMessage();
+                return 1;
+            }
+            std::string arg1(argv[i+1]);
+            try{
+                pruning_threshold = std::stod(arg1);
+            }
+            catch(const std::invalid_argument&){
+                std::cerr << "Error - the pruning threshold has had incorrect inputs!" << std::endl;
+                HelpMessage();
+                return 1;
+            }
+        }
+        else if (arg == "--shard"){
+            if (shard){
+                std::cerr << "Error - Cannot set the shard twice!" << std::endl;
+                HelpMessage();
+                return 1;
+            }
+            std::string arg1(argv[i+1]);
+            try{
+                shard = split_shard(arg1);
+            }
+            catch(const std::exception&){
+                std::cerr << "Error - the shard has had incorrect inputs!" << std::endl;
+                HelpMessage();
+                return 1;
+            }
+        }
+        else if (arg == "-o"){
+            if (shard_output_set){
+                std::cerr << "Error - Cannot set the shard file twice!" << std::endl;
+                HelpMessage();
+                return 1;
+            }
+            std::string arg1(argv[i+1]);
+            shard_output = arg1;
+            shard_output_set = true;
+        }
+        else if (arg == "--merge"){
+            if (!merge_files.empty()){
+                std::cerr << "Error - Cannot set the shard files to merge twice!" << std::endl;
+                HelpMessage();
+                return 1;
+            }
+            std::string arg1(argv[i+1]);
+            merge_files = split_list(arg1);
+            if (merge_files.empty()){
+                std::cerr << "Error - please input the shard files to merge!" << std::endl;
+                HelpMessage();
+                return 1;
+            }
+        }
+        else if (arg == "-m"){
+            if (model_text){
+                std::cerr << "Error - Cannot set the model twice!" << std::endl;
+                HelpMessage();
+                return 1;
+            }
+            model_text = argv[i+1];
+        }
+        else if (arg == "-k"){
+            if (checkpoint_file_set){
+                std::cerr << "Error - Cannot set the checkpoint file twice!" << std::endl;
+                HelpMessage();
+                return 1;
+            }
+            std::string arg1(argv[i+1]);
+            checkpoint_file = arg1;
+            checkpoint_file_set = true;
+        }
+        else if (arg == "-ki"){
+            if (checkpoint_interval_set){
+                std::cerr << "Error - Cannot set the checkpoint interval twice!" << std::endl;
+                HelpMessage();
+                return 1;
+            }
+            std::string arg1(argv[i+1]);
+            try{
+                checkpoint_interval = std::stod(arg1);
+            }
+            catch(const std::invalid_argument&){
+                std::cerr << "Error - the checkpoint interval has had incorrect inputs!" << std::endl;
+                HelpMessage();
+                return 1;
+            }
+            checkpoint_interval_set = true;
+        }
+        else if (arg == "-t"){
+            if (num_threads_set){
+                std::cerr << "Error - Cannot set the number of threads twice!" << std::endl;
+                HelpMessage();
+                return 1;
+            }
+            std::string arg1(argv[i+1]);
+            num_threads = std::atoi(arg1.c_str());
+            num_threads_set = true;
+        }
         else{ // extra error handling
             std::cerr << "Invalid Flag Detected: " << arg << std::endl;
             return 1;
@@ -172,7 +358,23 @@ int main(int argc, char** argv)
         return 1;
     }
 
-    if (filepath.empty() || num_bins <= 0){
+    if (shard && !merge_files.empty()){
+        std::cerr << "Error - A shard cannot be sampled and merged at the same time!" << std::endl;
+        HelpMessage();
+        return 1;
+    }
+    if (tensor_storage_set + refinement_threshold.has_value() + pruning_threshold.has_value() > 1){
+        std::cerr << "Error - Choose only one of dense storage, the multiresolution grid and branch and bound!" << std::endl;
+        HelpMessage();
+        return 1;
+    }
+    if ((tensor_storage_set || refinement_threshold || pruning_threshold) && (checkpoint_file_set || shard || !merge_files.empty())){
+        std::cerr << "Error - -d, -r and -b cannot be combined with -k, --shard or --merge, which only cover the full scan stored in the likelihood map!" << std::endl;
+        HelpMessage();
+        return 1;
+    }
+
+    if (filepath.empty() || num_bins <= 0 || num_threads <= 0){
         std::cout << "Invalid or Invalid Arguments" << std::endl;
         HelpMessage();
         return 1;
@@ -201,7 +403,50 @@ int main(int argc, char** argv)
     std::unique_ptr<UniformSampler<double, 2>> uniform_sampler_ptr;
 
     try{
-        uniform_sampler_ptr = std::make_unique<UniformSampler<double, 2>>(filepath,param_2_model_func<double>,names, min_vals, max_vals, num_bins,rigidity); // declared before so it exists outside of try scope. Use smart pointers for delayed construction of object
+        if (model_text){ // parsed once into bytecode, which serves as the model function, the block model evaluating many rows per call and the interval model, whose x independent part runs once per box.
+            BytecodeModel<double, 2> model(model_text.value(), names);
+            for (std::size_t i = 0; i < 2; i++){
+                if (!model.uses_param(i)){
+                    std::cerr << "Warning: Parameter " << names[i] << " does not appear in the model." << std::endl;
+                }
+            }
+            uniform_sampler_ptr = std::make_unique<UniformSampler<double, 2>>(filepath, model, names, min_vals, max_vals, num_bins, rigidity);
+            uniform_sampler_ptr->set_block_model([model](const std::array<double, 2> &params, const double *inputs, double *outputs, std::size_t count){
+                model.evaluate(params, inputs, outputs, count);
+            });
+            uniform_sampler_ptr->set_interval_model(model);
+        }
+        else{
+            uniform_sampler_ptr = std::make_unique<UniformSampler<double, 2>>(filepath,param_2_model_func<double>,names, min_vals, max_vals, num_bins,rigidity); // declared before so it exists outside of try scope. Use smart pointers for delayed construction of object
+            uniform_sampler_ptr->set_staged_model(param_2_staged_model<double>()); // x^b is computed once per sweep of a rather than for every grid point.
+            uniform_sampler_ptr->set_interval_model(param_2_model_func<Interval<double>>);
+            try{
+                uniform_sampler_ptr->set_vector_model(VectorModel::power_law); // full likelihood evaluations, e.g. when refining cells, run on the SIMD kernel.
+            }
+            catch(const std::domain_error &){ // data with non-positive x uses the same model compiled into the likelihood loop.
+                uniform_sampler_ptr->set_compiled_model(model_expression::power_law_model);
+            }
+        }
+        uniform_sampler_ptr->set_num_threads(num_threads);
+        uniform_sampler_ptr->set_model_name(model_text ? model_text.value() : "y=ax^b"); // checkpoints and shard files record the model, so they cannot be resumed or merged under another one.
+        if (tensor_storage_set){
+            uniform_sampler_ptr->use_dense_storage(tensor_storage == "mem" ? "" : tensor_storage);
+        }
+        if (refinement_threshold){
+            uniform_sampler_ptr->use_multiresolution(refinement_threshold.value());
+        }
+        if (pruning_threshold){
+            uniform_sampler_ptr->use_branch_and_bound(pruning_threshold.value());
+        }
+        if (shard){
+            if (!shard_output_set){
+                shard_output = "shard_" + std::to_string(shard.value()[0]) + "_of_" + std::to_string(shard.value()[1]) + ".bin";
+            }
+            uniform_sampler_ptr->set_shard(shard.value()[0], shard.value()[1], shard_output);
+        }
+        if (checkpoint_file_set){
+            uniform_sampler_ptr->enable_checkpoints(checkpoint_file, checkpoint_interval);
+        }
     }
     catch(const std::exception &e){
         std::cerr << e.what() << std::endl;
@@ -209,12 +454,52 @@ int main(int argc, char** argv)
         return 1;
     }
 
-    uniform_sampler_ptr->sample();
+    if (!merge_files.empty()){
+        try{
+            uniform_sampler_ptr->merge_shards(merge_files);
+        }
+        catch(const std::exception &e){
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+    }
+    else{
+        if (checkpoint_file_set){
+            std::signal(SIGTERM, CheckpointSignalHandler);
+            std::signal(SIGINT, CheckpointSignalHandler);
+        }
+        try{
+            uniform_sampler_ptr->sample();
+        }
+        catch(const SamplingInterrupted &e){
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+        catch(const std::exception &e){
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+        if (uniform_sampler_ptr->resumed_from_checkpoint()){
+            std::cout << "Resumed from checkpoint " << checkpoint_file << std::endl;
+        }
+    }
+    if (shard){ // a single shard only holds part of the posterior so it is not summarised.
+        std::cout << "Shard " << shard.value()[0] << "/" << shard.value()[1] << " written to " << shard_output << std::endl;
+        return 0;
+    }
+    if (uniform_sampler_ptr->uses_multiresolution()){
+        std::cout << "Multiresolution grid made " << uniform_sampler_ptr->get_num_likelihood_evaluations() << " likelihood evaluations" << std::endl;
+    }
+    if (uniform_sampler_ptr->uses_branch_and_bound()){
+        std::cout << "Branch and bound pruned " << uniform_sampler_ptr->get_num_pruned_cells() << " cells" << std::endl;
+    }
     uniform_sampler_ptr->summarise();
 
     if (plot_condition){
-        uniform_sampler_ptr->plot_histograms();
-        uniform_sampler_ptr->plot_best_fit();
+        std::string func_desc = model_text ? "y=" + model_text.value() : "y=ax^b";
+        std::replace(func_desc.begin(), func_desc.end(), '/', '_'); // func_desc is part of the plot file names, where / would start a directory
+        uniform_sampler_ptr->plot_histograms(func_desc);
+        uniform_sampler_ptr->plot_best_fit(func_desc);
     }
     
     return 0;
@@ -1,16 +1,21 @@
 #include "ModelFunctions.hpp"
+#include "Interval.hpp"
+#include "Dual.hpp"
 #define _USE_MATH_DEFINES
 #include <cmath>
 
+// pow is called unqualified in the model functions so that argument dependent lookup picks up the overloads of non built in REAL types such as Interval and Dual.
+using std::pow;
+
 
 template <typename REAL>
 REAL param_2_model_func(REAL x, std::array<REAL, 2> &params){
-    return params[0] * std::pow(x,params[1]);
+    return params[0] * pow(x,params[1]);
 }
 
 template <typename REAL>
 REAL param_1_model_func(REAL x, std::array<REAL, 1> &params){
-    return std::pow(x,params[0]);
+    return pow(x,params[0]);
 }
 
 template <typename REAL>
@@ -33,16 +38,75 @@ REAL polynomial(REAL x, std::array<REAL, 4> &params){
     return params[0] * x * x * x + params[1] * x * x + params[2] * x + params[3];
 }
 
+template <typename REAL>
+std::array<std::function<REAL(REAL)>, 2> param_test_basis(){
+    return {[](REAL x){return x;}, [](REAL){return REAL(1);}};
+}
+
+template <typename REAL>
+std::array<std::function<REAL(REAL)>, 3> param_3_test_basis(){
+    return {[](REAL x){return x * x;}, [](REAL x){return x;}, [](REAL){return REAL(1);}};
+}
+
+template <typename REAL>
+std::array<std::function<REAL(REAL)>, 4> polynomial_basis(){
+    return {[](REAL x){return x * x * x;}, [](REAL x){return x * x;}, [](REAL x){return x;}, [](REAL){return REAL(1);}};
+}
+
+template <typename REAL>
+StagedModel<REAL, 2> param_2_staged_model(){
+    return {0, [](REAL x, std::array<REAL, 2> &params){return pow(x,params[1]);}, [](REAL partial, REAL, REAL a){return a * partial;}};
+}
+
+template <typename REAL>
+StagedModel<REAL, 4> polynomial_staged_model(){
+    return {3, [](REAL x, std::array<REAL, 4> &params){return params[0] * x * x * x + params[1] * x * x + params[2] * x;}, [](REAL partial, REAL, REAL d){return partial + d;}};
+}
+
 template double param_2_model_func<double>(double, std::array<double, 2>&);
 template double param_1_model_func<double>(double, std::array<double, 1>&);
 template double param_test_model_func<double>(double, std::array<double, 2>&);
 template double param_3_test_model_func<double>(double, std::array<double, 3>&);
 template double gaussian_func<double>(double, double, double);
 template double polynomial<double>(double, std::array<double, 4>&);
+template std::array<std::function<double(double)>, 2> param_test_basis<double>();
+template std::array<std::function<double(double)>, 3> param_3_test_basis<double>();
+template std::array<std::function<double(double)>, 4> polynomial_basis<double>();
+template StagedModel<double, 2> param_2_staged_model<double>();
+template StagedModel<double, 4> polynomial_staged_model<double>();
 
 template float param_2_model_func<float>(float, std::array<float, 2>&);
 template float param_1_model_func<float>(float, std::array<float, 1>&);
 template float param_test_model_func<float>(float, std::array<float, 2>&);
 template float param_3_test_model_func<float>(float, std::array<float, 3>&);
 template float gaussian_func<float>(float, float, float);
-template float polynomial<float>(float, std::array<float,4>&); // manual instantiation
\ No newline at end of file
+template float polynomial<float>(float, std::array<float,4>&); // manual instantiation
+template std::array<std::function<float(float)>, 2> param_test_basis<float>();
+template std::array<std::function<float(float)>, 3> param_3_test_basis<float>();
+template std::array<std::function<float(float)>, 4> polynomial_basis<float>();
+template StagedModel<float, 2> param_2_staged_model<float>();
+template StagedModel<float, 4> polynomial_staged_model<float>();
+
+template Interval<double> param_2_model_func<Interval<double>>(Interval<double>, std::array<Interval<double>, 2>&);
+template Interval<double> param_1_model_func<Interval<double>>(Interval<double>, std::array<Interval<double>, 1>&);
+template Interval<double> param_test_model_func<Interval<double>>(Interval<double>, std::array<Interval<double>, 2>&);
+template Interval<double> param_3_test_model_func<Interval<double>>(Interval<double>, std::array<Interval<double>, 3>&);
+template Interval<double> polynomial<Interval<double>>(Interval<double>, std::array<Interval<double>, 4>&);
+
+template Interval<float> param_2_model_func<Interval<float>>(Interval<float>, std::array<Interval<float>, 2>&);
+template Interval<float> param_1_model_func<Interval<float>>(Interval<float>, std::array<Interval<float>, 1>&);
+template Interval<float> param_test_model_func<Interval<float>>(Interval<float>, std::array<Interval<float>, 2>&);
+template Interval<float> param_3_test_model_func<Interval<float>>(Interval<float>, std::array<Interval<float>, 3>&);
+template Interval<float> polynomial<Interval<float>>(Interval<float>, std::array<Interval<float>, 4>&); // interval instantiations bound the model over a parameter box
+
+template Dual<double, 2> param_2_model_func<Dual<double, 2>>(Dual<double, 2>, std::array<Dual<double, 2>, 2>&);
+template Dual<double, 1> param_1_model_func<Dual<double, 1>>(Dual<double, 1>, std::array<Dual<double, 1>, 1>&);
+template Dual<double, 2> param_test_model_func<Dual<double, 2>>(Dual<double, 2>, std::array<Dual<double, 2>, 2>&);
+template Dual<double, 3> param_3_test_model_func<Dual<double, 3>>(Dual<double, 3>, std::array<Dual<double, 3>, 3>&);
+template Dual<double, 4> polynomial<Dual<double, 4>>(Dual<double, 4>, std::array<Dual<double, 4>, 4>&);
+
+template Dual<float, 2> param_2_model_func<Dual<float, 2>>(Dual<float, 2>, std::array<Dual<float, 2>, 2>&);
+template Dual<float, 1> param_1_model_func<Dual<float, 1>>(Dual<float, 1>, std::array<Dual<float, 1>, 1>&);
+template Dual<float, 2> param_test_model_func<Dual<float, 2>>(Dual<float, 2>, std::array<Dual<float, 2>, 2>&);
+template Dual<float, 3> param_3_test_model_func<Dual<float, 3>>(Dual<float, 3>, std::array<Dual<float, 3>, 3>&);
+template Dual<float, 4> polynomial<Dual<float, 4>>(Dual<float, 4>, std::array<Dual<float, 4>, 4>&); // dual instantiations give the gradient with respect to the parameters
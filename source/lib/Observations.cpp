@@ -96,6 +96,10 @@ void Observations<REAL>::loadData(const std::string& filename, const bool rigidi
     }
     filestream.close();
     num_points = sigmas.size();
+    inverse_double_variances.resize(num_points);
+    for (uint i = 0; i < num_points; i++){
+        inverse_double_variances[i] = 1 / (2 * sigmas[i] * sigmas[i]);
+    }
 }
 
 template void Observations<double>::loadData(const std::string&, const bool);
@@ -6,13 +6,22 @@
 #include "Observations.hpp"
 #include "ModelFunctions.hpp"
 #include "MetropolisHastingsSampler.hpp"
+#include "ParallelTemperingSampler.hpp"
+#include "EnsembleSampler.hpp"
+#include "HamiltonianSampler.hpp"
+#include "NestedSampler.hpp"
 #include "UniformSampler.hpp"
+#include "Random.hpp"
+#include "BatchMeans.hpp"
+#include "TraceFile.hpp"
 #include <iostream>
 #include <fstream>
 #include <vector>
 #include <string>
 #include <sstream>
+#include <cstring>
 #include <filesystem>
+#include <atomic>
 
 using namespace Catch::Matchers;
 
@@ -64,6 +73,62 @@ void check_sampled_points(std::map<std::array<REAL, num_params>, REAL>& myMap, s
     }
 }
 
+/**
+ * @brief: Checks that a sampler using a faster likelihood path agrees with one evaluating the model function directly at every point: the log likelihood, the batched log likelihood and,
+ * when the sampler has them, the gradient and the upper bound over a box around the point.
+*/
+template<typename REAL, std::size_t num_params>
+void check_likelihoods_match(UniformSampler<REAL, num_params> &sampler, UniformSampler<REAL, num_params> &direct_sampler, const std::vector<std::array<REAL, num_params>> &points, REAL tolerance){
+    std::vector<REAL> log_likelihoods;
+    sampler.batch_log_likelihood(points, log_likelihoods);
+    REQUIRE(log_likelihoods.size() == points.size());
+    for (std::size_t k = 0; k < points.size(); k++){
+        std::array<REAL, num_params> point = points[k];
+        REAL direct_log_likelihood = direct_sampler.log_likelihood(point);
+        CHECK_THAT(sampler.log_likelihood(point), WithinRel(direct_log_likelihood, tolerance));
+        CHECK_THAT(log_likelihoods[k], WithinRel(direct_log_likelihood, tolerance));
+        if (sampler.has_gradient_model()){
+            std::array<REAL, num_params> gradient;
+            std::array<REAL, num_params> direct_gradient;
+            CHECK_THAT(sampler.log_likelihood_gradient(point, gradient), WithinRel(direct_sampler.log_likelihood_gradient(point, direct_gradient), tolerance));
+            for (std::size_t i = 0; i < num_params; i++){
+                CHECK_THAT(gradient[i], WithinRel(direct_gradient[i], tolerance));
+            }
+        }
+        if (sampler.has_interval_model()){
+            std::array<Interval<REAL>, num_params> box;
+            for (std::size_t i = 0; i < num_params; i++){
+                box[i] = Interval<REAL>(point[i] - REAL(0.1), point[i] + REAL(0.1));
+            }
+            CHECK_THAT(sampler.log_likelihood_upper_bound(box), WithinRel(direct_sampler.log_likelihood_upper_bound(box), tolerance));
+        }
+    }
+}
+
+/**
+ * @brief: Metropolis Hastings sampler of the power law example data over a, b in [0, 5] with step size 0.01 and 50 bins, the set up the Metropolis Hastings tests compare against each other.
+*/
+MetropolisHastingSampler<double, 2> power_law_mcmc_sampler(uint num_sample_points, const std::function<double(double, std::array<double, 2>&)> &model = param_2_model_func<double>){
+    std::array<std::string, 2> names = {"a", "b"};
+    std::array<double, 2> min_vals = {0, 0};
+    std::array<double, 2> max_vals = {5, 5};
+    return MetropolisHastingSampler<double, 2>("data/problem_data_2D.txt", model, names, min_vals, max_vals, num_sample_points, 0.01, 50);
+}
+
+/**
+ * @brief: Samples with both samplers and checks that their marginal distributions agree.
+*/
+template<typename REAL, std::size_t num_params>
+void check_marginals_match(UniformSampler<REAL, num_params> &sampler, UniformSampler<REAL, num_params> &direct_sampler, uint num_bins){
+    sampler.sample();
+    direct_sampler.sample();
+    for (std::size_t i = 0; i < num_params; i++){
+        for (uint j = 0; j < num_bins; j++){
+            CHECK_THAT(sampler.get_marginal_distribution()[i][j], WithinAbs(direct_sampler.get_marginal_distribution()[i][j], 1e-9));
+        }
+    }
+}
+
 template<typename REAL, std::size_t num_rows>
 void checkFileContents1(const Observations<REAL> &obs,const std::array<REAL, num_rows> &in_check,const std::array<REAL, num_rows> &out_check,const std::array<REAL, num_rows> &sig_check){
     REQUIRE(obs.inputs.size() == num_rows);
@@ -316,6 +381,202 @@ TEST_CASE("Test likelihood function","[Likelihood_Calc]"){
     }
 }
 
+TEST_CASE("Linear model likelihood matches direct evaluation","[Likelihood_Calc][Linear_Model]"){
+    std::array<std::string, 4> names = {"a", "b", "c", "d"};
+    std::array<double, 4> min_vals = {-3, -3, -3, -3};
+    std::array<double, 4> max_vals = {3, 3, 3, 3};
+    UniformSampler<double, 4> direct_sampler("data/problem_data_4D.txt", polynomial<double>, names, min_vals, max_vals, 10);
+    UniformSampler<double, 4> linear_sampler("data/problem_data_4D.txt", polynomial<double>, names, min_vals, max_vals, 10);
+    linear_sampler.set_linear_model(polynomial_basis<double>());
+    REQUIRE(linear_sampler.uses_linear_model());
+    std::vector<std::array<double, 4>> points = {{0, 0, 0, 0}, {-0.9, 1.8, 0.05, 1.0}, {2.5, -1.5, 0.3, -2.9}, {-3, 3, -3, 3}};
+    for (const std::array<double, 4> &point: points){
+        CHECK_THAT(linear_sampler.log_likelihood(point), WithinRel(direct_sampler.log_likelihood(point), 1e-9));
+    }
+    linear_sampler.sample();
+    direct_sampler.sample();
+    for (std::size_t i = 0; i < 4; i++){
+        for (uint j = 0; j < 10; j++){
+            CHECK_THAT(linear_sampler.get_marginal_distribution()[i][j], WithinAbs(direct_sampler.get_marginal_distribution()[i][j], 1e-9));
+        }
+    }
+}
+
+TEST_CASE("Vectorised likelihood kernels match direct evaluation","[Likelihood_Calc][Vector_Model]"){
+    std::array<std::string, 4> names = {"a", "b", "c", "d"};
+    std::array<double, 4> min_vals = {-3, -3, -3, -3};
+    std::array<double, 4> max_vals = {3, 3, 3, 3};
+    UniformSampler<double, 4> direct_sampler("data/problem_data_4D.txt", polynomial<double>, names, min_vals, max_vals, 10);
+    UniformSampler<double, 4> vector_sampler("data/problem_data_4D.txt", polynomial<double>, names, min_vals, max_vals, 10);
+    REQUIRE_THROWS_AS(vector_sampler.set_vector_model(VectorModel::power_law), std::domain_error);
+    vector_sampler.set_vector_model(VectorModel::polynomial);
+    REQUIRE(vector_sampler.uses_vector_model());
+    CHECK(vector_sampler.get_simd_level() == detected_simd_level());
+
+    std::array<std::string, 2> power_names = {"a", "b"};
+    std::array<double, 2> power_min_vals = {0, 0};
+    std::array<double, 2> power_max_vals = {5, 5};
+    UniformSampler<double, 2> direct_power_sampler("data/problem_data_2D.txt", param_2_model_func<double>, power_names, power_min_vals, power_max_vals, 10);
+    UniformSampler<double, 2> vector_power_sampler("data/problem_data_2D.txt", param_2_model_func<double>, power_names, power_min_vals, power_max_vals, 10);
+    vector_power_sampler.set_vector_model(VectorModel::power_law);
+    std::array<float, 2> float_min_vals = {0, 0};
+    std::array<float, 2> float_max_vals = {5, 5};
+    UniformSampler<float, 2> direct_float_sampler("data/problem_data_2D.txt", param_2_model_func<float>, power_names, float_min_vals, float_max_vals, 10);
+    UniformSampler<float, 2> vector_float_sampler("data/problem_data_2D.txt", param_2_model_func<float>, power_names, float_min_vals, float_max_vals, 10);
+    vector_float_sampler.set_vector_model(VectorModel::power_law);
+
+    std::vector<std::array<double, 4>> points = {{0, 0, 0, 0}, {-0.9, 1.8, 0.05, 1.0}, {2.5, -1.5, 0.3, -2.9}, {-3, 3, -3, 3}};
+    std::vector<std::array<double, 2>> power_points = {{2.5, 4.3}, {0.1, 0.01}, {5, 5}, {1.7, 0.6}};
+    for (SimdLevel level: {SimdLevel::scalar, SimdLevel::avx2, SimdLevel::avx512}){
+        if (level > detected_simd_level()){
+            REQUIRE_THROWS_AS(vector_sampler.set_simd_level(level), std::domain_error);
+            continue;
+        }
+        vector_sampler.set_simd_level(level);
+        vector_power_sampler.set_simd_level(level);
+        vector_float_sampler.set_simd_level(level);
+        for (const std::array<double, 4> &point: points){
+            CHECK_THAT(vector_sampler.log_likelihood(point), WithinRel(direct_sampler.log_likelihood(point), 1e-12));
+        }
+        for (const std::array<double, 2> &point: power_points){
+            CHECK_THAT(vector_power_sampler.log_likelihood(point), WithinRel(direct_power_sampler.log_likelihood(point), 1e-12));
+            std::array<float, 2> float_point = {static_cast<float>(point[0]), static_cast<float>(point[1])};
+            CHECK_THAT(vector_float_sampler.log_likelihood(float_point), WithinRel(direct_float_sampler.log_likelihood(float_point), 1e-4f));
+        }
+    }
+
+    vector_sampler.set_simd_level(detected_simd_level());
+    vector_sampler.sample();
+    direct_sampler.sample();
+    for (std::size_t i = 0; i < 4; i++){
+        for (uint j = 0; j < 10; j++){
+            CHECK_THAT(vector_sampler.get_marginal_distribution()[i][j], WithinAbs(direct_sampler.get_marginal_distribution()[i][j], 1e-9));
+        }
+    }
+}
+
+TEST_CASE("Batched likelihood matches one evaluation at a time","[Likelihood_Calc][Batch]"){
+    std::array<std::string,2> names = {"a", "b"};
+    std::array<double, 2> min_vals = {0, 0};
+    std::array<double, 2> max_vals = {5, 5};
+    {
+        std::ofstream data_file("test_batch_data.txt"); // several tiles of observations with a partial one at the end
+        Xoshiro256 generator(11);
+        data_file.precision(17);
+        for (int i = 0; i < 2500; i++){
+            double x = 0.5 + 1.5 * unit_uniform<double>(generator);
+            data_file << x << " " << 1.5 * std::pow(x, 2.3) + 0.5 * ziggurat_normal<double>(generator) << " " << 0.5 << "\n";
+        }
+    }
+    UniformSampler<double, 2> sampler("test_batch_data.txt", param_2_model_func<double>, names, min_vals, max_vals, 10);
+    std::vector<std::array<double, 2>> points = {{1.5, 2.3}, {2.5, 4.3}, {0.1, 0.01}, {5, 5}, {1.7, 0.6}};
+    std::vector<double> log_likelihoods;
+    sampler.batch_log_likelihood({}, log_likelihoods);
+    CHECK(log_likelihoods.empty());
+    sampler.batch_log_likelihood(points, log_likelihoods);
+    REQUIRE(log_likelihoods.size() == points.size());
+    for (std::size_t k = 0; k < points.size(); k++){
+        CHECK(log_likelihoods[k] == sampler.log_likelihood(points[k])); // same order of summation as the model function path
+    }
+    sampler.set_vector_model(VectorModel::power_law);
+    sampler.batch_log_likelihood(points, log_likelihoods);
+    for (std::size_t k = 0; k < points.size(); k++){
+        CHECK_THAT(log_likelihoods[k], WithinRel(sampler.log_likelihood(points[k]), 1e-12));
+    }
+
+    std::array<std::string, 4> cubic_names = {"a", "b", "c", "d"};
+    std::array<double, 4> cubic_min_vals = {-3, -3, -3, -3};
+    std::array<double, 4> cubic_max_vals = {3, 3, 3, 3};
+    UniformSampler<double, 4> cubic_sampler("data/problem_data_4D.txt", polynomial<double>, cubic_names, cubic_min_vals, cubic_max_vals, 10);
+    cubic_sampler.set_linear_model(polynomial_basis<double>());
+    std::vector<std::array<double, 4>> cubic_points = {{0, 0, 0, 0}, {-0.9, 1.8, 0.05, 1.0}};
+    cubic_sampler.batch_log_likelihood(cubic_points, log_likelihoods);
+    for (std::size_t k = 0; k < cubic_points.size(); k++){
+        CHECK(log_likelihoods[k] == cubic_sampler.log_likelihood(cubic_points[k]));
+    }
+    std::filesystem::remove("test_batch_data.txt");
+}
+
+TEST_CASE("Compiled models match the model function","[Likelihood_Calc][Compiled_Model]"){
+    using namespace model_expression;
+    std::array<double, 2> point = {1.3, 0.7};
+    auto expression = exp(-x / param<0>) * param<1> + pow<2>(x) - 1.5 * log(x + 2);
+    CHECK_THAT(expression(0.4, point), WithinRel(std::exp(-0.4 / 1.3) * 0.7 + 0.4 * 0.4 - 1.5 * std::log(2.4), 1e-15));
+
+    std::array<std::string,2> names = {"a", "b"};
+    std::array<double, 2> min_vals = {0, 0};
+    std::array<double, 2> max_vals = {5, 5};
+    UniformSampler<double, 2> direct_sampler("data/problem_data_2D.txt", param_2_model_func<double>, names, min_vals, max_vals, 10);
+    UniformSampler<double, 2> compiled_sampler("data/problem_data_2D.txt", param_2_model_func<double>, names, min_vals, max_vals, 10);
+    UniformSampler<double, 2> functor_sampler("data/problem_data_2D.txt", param_2_model_func<double>, names, min_vals, max_vals, 10);
+    compiled_sampler.set_compiled_model(power_law_model);
+    functor_sampler.set_compiled_model([](double input, const std::array<double, 2> &params){ return params[0] * std::pow(input, params[1]); });
+    REQUIRE(compiled_sampler.uses_compiled_model());
+    direct_sampler.set_gradient_model(param_2_model_func<Dual<double, 2>>);
+    compiled_sampler.set_gradient_model(power_law_model); // the same expression differentiates the model
+    direct_sampler.set_interval_model(param_2_model_func<Interval<double>>);
+    compiled_sampler.set_interval_model(power_law_model); // and bounds it
+    std::vector<std::array<double, 2>> points = {{2.5, 4.3}, {0.1, 0.01}, {5, 5}, {1.7, 0.6}};
+    check_likelihoods_match(compiled_sampler, direct_sampler, points, 1e-12);
+    check_likelihoods_match(functor_sampler, direct_sampler, points, 1e-12);
+
+    std::array<std::string, 4> cubic_names = {"a", "b", "c", "d"};
+    std::array<float, 4> cubic_min_vals = {-3, -3, -3, -3};
+    std::array<float, 4> cubic_max_vals = {3, 3, 3, 3};
+    UniformSampler<float, 4> direct_cubic_sampler("data/problem_data_4D.txt", polynomial<float>, cubic_names, cubic_min_vals, cubic_max_vals, 10);
+    UniformSampler<float, 4> compiled_cubic_sampler("data/problem_data_4D.txt", polynomial<float>, cubic_names, cubic_min_vals, cubic_max_vals, 10);
+    compiled_cubic_sampler.set_compiled_model(polynomial_model);
+    check_likelihoods_match(compiled_cubic_sampler, direct_cubic_sampler, {{-0.9f, 1.8f, 0.05f, 1.0f}}, 1e-5f);
+    compiled_cubic_sampler.set_vector_model(VectorModel::polynomial);
+    CHECK_FALSE(compiled_cubic_sampler.uses_compiled_model());
+
+    check_marginals_match(compiled_sampler, direct_sampler, 10);
+}
+
+TEST_CASE("Bytecode models parsed at run time match the model functions","[Likelihood_Calc][Bytecode_Model]"){
+    std::array<std::string,2> names = {"a", "b"};
+    for (std::string invalid: {"", "a*x^^b", "a*(x + b", "a*q", "exp x", "2x", "a*x)"}){
+        REQUIRE_THROWS_AS((BytecodeModel<double, 2>(invalid, names)), std::domain_error);
+    }
+    BytecodeModel<double, 2> expression("a*exp(-x/b) + sqrt(x) - 3*log(x + 2) + x^3 - (-a)^2/b + 2^-1", names);
+    std::array<double, 2> point = {1.3, 0.7};
+    double x = 0.4;
+    CHECK_THAT(expression(x, point), WithinRel(1.3 * std::exp(-x / 0.7) + std::sqrt(x) - 3 * std::log(x + 2) + x * x * x - 1.3 * 1.3 / 0.7 + 0.5, 1e-14));
+    std::vector<double> inputs(600);
+    std::vector<double> outputs(600);
+    for (std::size_t i = 0; i < inputs.size(); i++){
+        inputs[i] = 0.01 * i + 0.005;
+    }
+    expression.evaluate(point, inputs.data(), outputs.data(), inputs.size()); // more than one block of rows
+    for (std::size_t i = 0; i < inputs.size(); i++){
+        CHECK(outputs[i] == expression(inputs[i], point));
+    }
+    auto prepared = expression.prepare(point); // runs the scalar program once, then only the block program per observation
+    CHECK(prepared(x) == expression(x, point));
+    CHECK(prepared(inputs[599]) == outputs[599]);
+    BytecodeModel<double, 2> hoisted("exp(a) * log(b + 1) * x", names);
+    CHECK(hoisted.get_num_block_instructions() == 1); // exp(a) * log(b + 1) is computed once per parameter vector
+    BytecodeModel<double, 2> partial("a * x", names);
+    CHECK(partial.uses_param(0));
+    CHECK_FALSE(partial.uses_param(1));
+
+    std::array<double, 2> min_vals = {0, 0};
+    std::array<double, 2> max_vals = {5, 5};
+    BytecodeModel<double, 2> power_law("a * x^b", names);
+    UniformSampler<double, 2> direct_sampler("data/problem_data_2D.txt", param_2_model_func<double>, names, min_vals, max_vals, 10);
+    UniformSampler<double, 2> bytecode_sampler("data/problem_data_2D.txt", power_law, names, min_vals, max_vals, 10);
+    bytecode_sampler.set_block_model([power_law](const std::array<double, 2> &params, const double *block_inputs, double *block_outputs, std::size_t count){
+        power_law.evaluate(params, block_inputs, block_outputs, count);
+    });
+    REQUIRE(bytecode_sampler.uses_block_model());
+    bytecode_sampler.set_gradient_model(power_law); // the same program differentiates the model
+    bytecode_sampler.set_interval_model(power_law); // and bounds it
+    direct_sampler.set_gradient_model(param_2_model_func<Dual<double, 2>>);
+    direct_sampler.set_interval_model(param_2_model_func<Interval<double>>);
+    check_likelihoods_match(bytecode_sampler, direct_sampler, {{2.5, 4.3}, {0.1, 0.01}, {5, 5}, {1.7, 0.6}}, 1e-12);
+    check_marginals_match(bytecode_sampler, direct_sampler, 10);
+}
+
 TEST_CASE("Sampling Statistics","[Uniform_Sampler][Summarise]"){
     //  Made a python file to curve fit the same data to y = ax^b. Testing against parameters found using scipy.optimise.curve_fit
     std::array<std::string,2> names = {"a", "b"};
@@ -338,6 +599,813 @@ TEST_CASE("Sampling Statistics","[Uniform_Sampler][Summarise]"){
     REQUIRE_NOTHROW(uniform_sampler.plot_best_fit());
 }
 
+TEST_CASE("Parallel uniform sampling matches single threaded sampling","[Uniform_Sampler][Parallel]"){
+    std::array<std::string, 3> names = {"a","b","c"};
+    std::array<double, 3> min_vals = {0,0,0};
+    std::array<double, 3> max_vals = {1,1,1};
+    UniformSampler<double, 3> serial_sampler("test/test_data/testing_data_2D.txt", param_3_test_model_func<double>, names, min_vals, max_vals, 30);
+    UniformSampler<double, 3> parallel_sampler("test/test_data/testing_data_2D.txt", param_3_test_model_func<double>, names, min_vals, max_vals, 30);
+    parallel_sampler.set_num_threads(4);
+    REQUIRE_THROWS_AS(parallel_sampler.set_num_threads(0), std::domain_error);
+    serial_sampler.sample();
+    parallel_sampler.sample();
+
+    REQUIRE(parallel_sampler.get_param_likelihood().size() == 27000);
+    REQUIRE(parallel_sampler.get_param_likelihood() == serial_sampler.get_param_likelihood());
+    for (std::size_t i = 0; i < 3; i++){
+        for (uint j = 0; j < 30; j++){
+            CHECK_THAT(parallel_sampler.get_marginal_distribution()[i][j], WithinRel(serial_sampler.get_marginal_distribution()[i][j], 1e-9));
+        }
+    }
+}
+
+TEST_CASE("Dense likelihood storage matches map storage","[Uniform_Sampler][Dense_Storage]"){
+    std::array<std::string, 3> names = {"a","b","c"};
+    std::array<double, 3> min_vals = {0,0,0};
+    std::array<double, 3> max_vals = {1,1,1};
+    UniformSampler<double, 3> map_sampler("test/test_data/testing_data_2D.txt", param_3_test_model_func<double>, names, min_vals, max_vals, 20);
+    UniformSampler<double, 3> dense_sampler("test/test_data/testing_data_2D.txt", param_3_test_model_func<double>, names, min_vals, max_vals, 20);
+    UniformSampler<double, 3> mapped_sampler("test/test_data/testing_data_2D.txt", param_3_test_model_func<double>, names, min_vals, max_vals, 20);
+    dense_sampler.use_dense_storage();
+    mapped_sampler.use_dense_storage("test_likelihood_tensor.bin");
+    mapped_sampler.set_num_threads(3);
+    REQUIRE_THROWS_AS(dense_sampler.get_log_likelihood({0, 0, 0}), std::logic_error);
+    map_sampler.sample();
+    dense_sampler.sample();
+    mapped_sampler.sample();
+
+    CHECK(dense_sampler.get_param_likelihood().empty());
+    CHECK(mapped_sampler.get_likelihood_tensor().is_memory_mapped());
+    CHECK(std::filesystem::file_size("test_likelihood_tensor.bin") == 8000 * sizeof(double));
+    for (const auto& pair: map_sampler.get_param_likelihood()){
+        std::array<uint, 3> combination;
+        for (std::size_t i = 0; i < 3; i++){
+            combination[i] = static_cast<uint>(pair.first[i] * 20);
+        }
+        CHECK(dense_sampler.get_log_likelihood(combination) == pair.second);
+        CHECK(mapped_sampler.get_log_likelihood(combination) == pair.second);
+    }
+    REQUIRE_THROWS_AS(dense_sampler.get_log_likelihood({0, 20, 0}), std::domain_error);
+    for (std::size_t i = 0; i < 3; i++){
+        for (uint j = 0; j < 20; j++){
+            CHECK_THAT(dense_sampler.get_marginal_distribution()[i][j], WithinRel(map_sampler.get_marginal_distribution()[i][j], 1e-9));
+            CHECK_THAT(mapped_sampler.get_marginal_distribution()[i][j], WithinRel(map_sampler.get_marginal_distribution()[i][j], 1e-9));
+        }
+    }
+    std::filesystem::remove("test_likelihood_tensor.bin");
+
+    UniformSampler<double, 3> unusable_sampler("test/test_data/testing_data_2D.txt", [](double, std::array<double, 3>&){ return std::numeric_limits<double>::infinity(); }, names, min_vals, max_vals, 5);
+    unusable_sampler.use_dense_storage(); // every log likelihood is -infinity
+    REQUIRE_THROWS_AS(unusable_sampler.sample(), std::runtime_error);
+}
+
+TEST_CASE("Multiresolution grid matches the full scan","[Uniform_Sampler][Multiresolution]"){
+    std::array<std::string,2> names = {"a", "b"};
+    std::array<double, 2> min_vals = {0, 0};
+    std::array<double, 2> max_vals = {5, 5};
+    UniformSampler<double, 2> full_sampler("data/problem_data_2D.txt", param_2_model_func<double>, names, min_vals, max_vals, 200);
+    UniformSampler<double, 2> exhaustive_sampler("data/problem_data_2D.txt", param_2_model_func<double>, names, min_vals, max_vals, 200);
+    UniformSampler<double, 2> refined_sampler("data/problem_data_2D.txt", param_2_model_func<double>, names, min_vals, max_vals, 200);
+    REQUIRE_THROWS_AS(refined_sampler.use_multiresolution(-1), std::domain_error);
+    exhaustive_sampler.use_multiresolution(1e30); // every cell is refined down to single bins
+    refined_sampler.use_multiresolution(20, 5);
+    refined_sampler.set_num_threads(2);
+    full_sampler.sample();
+    exhaustive_sampler.sample();
+    refined_sampler.sample();
+    full_sampler.summarise(false);
+    exhaustive_sampler.summarise(false);
+    refined_sampler.summarise(false);
+
+    CHECK(exhaustive_sampler.get_param_likelihood() == full_sampler.get_param_likelihood());
+    CHECK(refined_sampler.get_num_likelihood_evaluations() < 40000 / 10); // centre and face evaluations together, against 40000 for the full scan
+    for (std::size_t i = 0; i < 2; i++){
+        for (uint j = 0; j < 200; j++){
+            CHECK_THAT(exhaustive_sampler.get_marginal_distribution()[i][j], WithinAbs(full_sampler.get_marginal_distribution()[i][j], 1e-12));
+        }
+        CHECK_THAT(refined_sampler.get_params_info()[i].mean_parameter, WithinRel(full_sampler.get_params_info()[i].mean_parameter, 1e-4));
+        CHECK_THAT(refined_sampler.get_params_info()[i].standard_deviation, WithinRel(full_sampler.get_params_info()[i].standard_deviation, 1e-3));
+    }
+}
+
+TEST_CASE("Branch and bound keeps every grid point near the peak","[Uniform_Sampler][Branch_And_Bound]"){
+    std::array<std::string,2> names = {"a", "b"};
+    std::array<double, 2> min_vals = {0, 0};
+    std::array<double, 2> max_vals = {5, 5};
+    UniformSampler<double, 2> full_sampler("data/problem_data_2D.txt", param_2_model_func<double>, names, min_vals, max_vals, 200);
+    UniformSampler<double, 2> pruned_sampler("data/problem_data_2D.txt", param_2_model_func<double>, names, min_vals, max_vals, 200);
+    REQUIRE_THROWS_AS(pruned_sampler.use_branch_and_bound(0), std::domain_error);
+    pruned_sampler.use_branch_and_bound(30);
+    REQUIRE_THROWS_AS(pruned_sampler.sample(), std::logic_error); // no interval model yet
+    pruned_sampler.set_interval_model(param_2_model_func<Interval<double>>);
+    pruned_sampler.set_num_threads(2);
+    full_sampler.sample();
+    pruned_sampler.sample();
+    full_sampler.summarise(false);
+    pruned_sampler.summarise(false);
+
+    CHECK(pruned_sampler.get_num_pruned_cells() > 0);
+    CHECK(pruned_sampler.get_num_pruned_cells() + pruned_sampler.get_param_likelihood().size() == 40000);
+    double max_log_likelihood = -std::numeric_limits<double>::infinity();
+    for (const auto& pair: full_sampler.get_param_likelihood()){
+        max_log_likelihood = std::max(max_log_likelihood, pair.second);
+    }
+    for (const auto& pair: full_sampler.get_param_likelihood()){
+        auto pruned_point = pruned_sampler.get_param_likelihood().find(pair.first);
+        if (pruned_point == pruned_sampler.get_param_likelihood().end()){
+            CHECK(pair.second < max_log_likelihood - 30);
+        }
+        else{
+            CHECK(pruned_point -> second == pair.second);
+        }
+    }
+    for (std::size_t i = 0; i < 2; i++){
+        for (uint j = 0; j < 200; j++){
+            CHECK_THAT(pruned_sampler.get_marginal_distribution()[i][j], WithinAbs(full_sampler.get_marginal_distribution()[i][j], 1e-9));
+        }
+        CHECK_THAT(pruned_sampler.get_params_info()[i].mean_parameter, WithinRel(full_sampler.get_params_info()[i].mean_parameter, 1e-9));
+    }
+}
+
+TEST_CASE("Staged model evaluation matches direct evaluation","[Uniform_Sampler][Staged_Model]"){
+    std::array<std::string,2> names = {"a", "b"};
+    std::array<double, 2> min_vals = {0, 0};
+    std::array<double, 2> max_vals = {5, 5};
+    UniformSampler<double, 2> direct_sampler("data/problem_data_2D.txt", param_2_model_func<double>, names, min_vals, max_vals, 50);
+    UniformSampler<double, 2> staged_sampler("data/problem_data_2D.txt", param_2_model_func<double>, names, min_vals, max_vals, 50);
+    UniformSampler<double, 2> staged_dense_sampler("data/problem_data_2D.txt", param_2_model_func<double>, names, min_vals, max_vals, 50);
+    staged_sampler.set_staged_model(param_2_staged_model<double>());
+    staged_sampler.set_num_threads(3);
+    staged_dense_sampler.set_staged_model(param_2_staged_model<double>()); // rows sweep a, the first axis, so the tensor is written with a stride
+    staged_dense_sampler.use_dense_storage();
+    REQUIRE(staged_sampler.uses_staged_model());
+    direct_sampler.sample();
+    staged_sampler.sample();
+    staged_dense_sampler.sample();
+    CHECK(staged_sampler.get_param_likelihood() == direct_sampler.get_param_likelihood());
+    for (uint j = 0; j < 50; j++){
+        for (uint k = 0; k < 50; k++){
+            std::array<double, 2> params = {min_vals[0] + (j + 0.5) * 5 / 50, min_vals[1] + (k + 0.5) * 5 / 50};
+            CHECK(staged_dense_sampler.get_log_likelihood({j, k}) == direct_sampler.get_param_likelihood().at(params));
+        }
+    }
+    for (std::size_t i = 0; i < 2; i++){
+        for (uint j = 0; j < 50; j++){
+            CHECK_THAT(staged_sampler.get_marginal_distribution()[i][j], WithinRel(direct_sampler.get_marginal_distribution()[i][j], 1e-12));
+        }
+    }
+
+    std::array<std::string,4> poly_names = {"a", "b", "c", "d"};
+    std::array<double, 4> poly_min_vals = {-3, -3, -3, -3};
+    std::array<double, 4> poly_max_vals = {3, 3, 3, 3};
+    UniformSampler<double, 4> direct_poly_sampler("data/problem_data_4D.txt", polynomial<double>, poly_names, poly_min_vals, poly_max_vals, 12);
+    UniformSampler<double, 4> staged_poly_sampler("data/problem_data_4D.txt", polynomial<double>, poly_names, poly_min_vals, poly_max_vals, 12);
+    REQUIRE_THROWS_AS(staged_poly_sampler.set_staged_model({4, nullptr, nullptr}), std::domain_error);
+    direct_poly_sampler.use_dense_storage();
+    staged_poly_sampler.use_dense_storage();
+    staged_poly_sampler.set_staged_model(polynomial_staged_model<double>());
+    direct_poly_sampler.sample();
+    staged_poly_sampler.sample();
+    for (std::uint64_t i = 0; i < direct_poly_sampler.get_likelihood_tensor().size(); i++){
+        CHECK(staged_poly_sampler.get_likelihood_tensor()[i] == direct_poly_sampler.get_likelihood_tensor()[i]);
+    }
+}
+
+TEST_CASE("Merged shards match the full scan","[Uniform_Sampler][Shards]"){
+    std::array<std::string,3> names = {"a", "b", "c"};
+    std::array<double, 3> min_vals = {-3, -3, -3};
+    std::array<double, 3> max_vals = {3, 3, 3};
+    UniformSampler<double, 3> full_sampler("data/problem_data_4D.txt", param_3_test_model_func<double>, names, min_vals, max_vals, 30);
+    full_sampler.sample();
+    std::vector<std::string> shard_files;
+    for (uint i = 0; i < 3; i++){
+        UniformSampler<double, 3> shard_sampler("data/problem_data_4D.txt", param_3_test_model_func<double>, names, min_vals, max_vals, 30);
+        REQUIRE_THROWS_AS(shard_sampler.set_shard(3, 3, "test_shard.bin"), std::domain_error);
+        shard_files.push_back("test_shard_" + std::to_string(i) + ".bin");
+        shard_sampler.set_shard(i, 3, shard_files.back());
+        shard_sampler.set_num_threads(i + 1);
+        shard_sampler.sample();
+        CHECK(shard_sampler.get_param_likelihood().size() == 900 * (i + 1) / 3 * 30 - 900 * i / 3 * 30);
+    }
+
+    UniformSampler<double, 3> partial_sampler("data/problem_data_4D.txt", param_3_test_model_func<double>, names, min_vals, max_vals, 30);
+    REQUIRE_THROWS_AS(partial_sampler.merge_shards({shard_files[0], shard_files[2]}), std::runtime_error);
+    UniformSampler<double, 3> other_model_sampler("data/problem_data_4D.txt", param_3_test_model_func<double>, names, min_vals, max_vals, 30);
+    other_model_sampler.set_model_name("a*x^2 + b*x + c");
+    REQUIRE_THROWS_AS(other_model_sampler.merge_shards(shard_files), std::runtime_error);
+    UniformSampler<double, 3> merged_sampler("data/problem_data_4D.txt", param_3_test_model_func<double>, names, min_vals, max_vals, 30);
+    merged_sampler.merge_shards({shard_files[2], shard_files[0], shard_files[1]});
+    for (std::size_t i = 0; i < 3; i++){
+        for (uint j = 0; j < 30; j++){
+            CHECK_THAT(merged_sampler.get_marginal_distribution()[i][j], WithinRel(full_sampler.get_marginal_distribution()[i][j], 1e-9));
+        }
+    }
+    for (const std::string &shard_file: shard_files){
+        std::filesystem::remove(shard_file);
+    }
+}
+
+TEST_CASE("Resumed Metropolis Hastings run matches an uninterrupted run","[Metropolis_Hastings][Checkpoint]"){
+    long model_calls = 0;
+    std::function<double(double, std::array<double, 2>&)> interrupting_model = [&](double x, std::array<double, 2> &params){
+        if (++model_calls == 100 * 7000){ // 100 observations per likelihood
+            request_checkpoint_stop();
+        }
+        return param_2_model_func<double>(x, params);
+    };
+    MetropolisHastingSampler<double, 2> uninterrupted_sampler = power_law_mcmc_sampler(20000);
+    uninterrupted_sampler.enable_trace(15000);
+    uninterrupted_sampler.sample();
+
+    MetropolisHastingSampler<double, 2> interrupted_sampler = power_law_mcmc_sampler(20000, interrupting_model);
+    interrupted_sampler.enable_checkpoints("test_chain_checkpoint.bin", 0, 4096);
+    interrupted_sampler.enable_trace(15000);
+    REQUIRE_THROWS_AS(interrupted_sampler.sample(), SamplingInterrupted);
+    REQUIRE(std::filesystem::exists("test_chain_checkpoint.bin"));
+
+    MetropolisHastingSampler<double, 2> resumed_sampler = power_law_mcmc_sampler(20000);
+    resumed_sampler.enable_checkpoints("test_chain_checkpoint.bin", 0, 4096);
+    resumed_sampler.enable_trace(15000);
+    resumed_sampler.sample();
+    CHECK(resumed_sampler.resumed_from_checkpoint());
+    CHECK_FALSE(std::filesystem::exists("test_chain_checkpoint.bin"));
+    CHECK(resumed_sampler.get_marginal_distribution() == uninterrupted_sampler.get_marginal_distribution());
+    const TraceBuffer<double, 2> &resumed_trace = resumed_sampler.get_trace();
+    const TraceBuffer<double, 2> &uninterrupted_trace = uninterrupted_sampler.get_trace();
+    REQUIRE(resumed_trace.total_recorded() == uninterrupted_trace.total_recorded());
+    for (std::size_t i = 0; i < uninterrupted_trace.size(); i++){
+        CHECK(resumed_trace[i].params == uninterrupted_trace[i].params);
+        CHECK(resumed_trace[i].log_likelihood == uninterrupted_trace[i].log_likelihood);
+    }
+}
+
+TEST_CASE("Burn in, thinning and streamed trace files","[Metropolis_Hastings][Trace]"){
+    long model_calls = 0;
+    std::function<double(double, std::array<double, 2>&)> interrupting_model = [&](double x, std::array<double, 2> &params){
+        if (++model_calls == 100 * 7000){ // 100 observations per likelihood
+            request_checkpoint_stop();
+        }
+        return param_2_model_func<double>(x, params);
+    };
+    MetropolisHastingSampler<double, 2> uninterrupted_sampler = power_law_mcmc_sampler(20000);
+    REQUIRE_THROWS_AS(uninterrupted_sampler.set_thinning(0), std::domain_error);
+    uninterrupted_sampler.set_burn_in(20000);
+    REQUIRE_THROWS_AS(uninterrupted_sampler.sample(), std::domain_error); // would keep no draw
+    uninterrupted_sampler.set_burn_in(1000);
+    uninterrupted_sampler.set_thinning(10);
+    uninterrupted_sampler.enable_trace(5000);
+    uninterrupted_sampler.stream_trace("test_trace_uninterrupted.bin");
+    uninterrupted_sampler.sample();
+    {
+        MappedTrace<double, 2> streamed("test_trace_uninterrupted.bin");
+        const TraceBuffer<double, 2> &trace = uninterrupted_sampler.get_trace();
+        REQUIRE(streamed.size() == (20000 - 1000) / 10 + 1); // draws 1000, 1010, ..., 20000
+        CHECK(streamed.get_thinning() == 10);
+        REQUIRE(trace.size() == streamed.size());
+        for (std::size_t i = 0; i < streamed.size(); i++){
+            CHECK(streamed[i].params == trace[i].params);
+            CHECK(streamed[i].log_likelihood == trace[i].log_likelihood);
+        }
+        REQUIRE_THROWS_AS((MappedTrace<double, 3>("test_trace_uninterrupted.bin")), std::runtime_error);
+    }
+
+    MetropolisHastingSampler<double, 2> interrupted_sampler = power_law_mcmc_sampler(20000, interrupting_model);
+    MetropolisHastingSampler<double, 2> resumed_sampler = power_law_mcmc_sampler(20000);
+    for (MetropolisHastingSampler<double, 2> *sampler: {&interrupted_sampler, &resumed_sampler}){
+        sampler -> set_burn_in(1000);
+        sampler -> set_thinning(10);
+        sampler -> enable_checkpoints("test_thinned_checkpoint.bin", 0, 4096);
+        sampler -> stream_trace("test_trace_resumed.bin");
+    }
+    REQUIRE_THROWS_AS(interrupted_sampler.sample(), SamplingInterrupted);
+    resumed_sampler.sample();
+    CHECK(resumed_sampler.resumed_from_checkpoint());
+    CHECK(resumed_sampler.get_marginal_distribution() == uninterrupted_sampler.get_marginal_distribution());
+    {
+        MappedTrace<double, 2> uninterrupted("test_trace_uninterrupted.bin");
+        MappedTrace<double, 2> resumed("test_trace_resumed.bin");
+        REQUIRE(resumed.size() == uninterrupted.size());
+        CHECK(std::memcmp(resumed.data(), uninterrupted.data(), resumed.size() * sizeof(resumed[0])) == 0);
+    }
+    std::filesystem::remove("test_trace_uninterrupted.bin");
+    std::filesystem::remove("test_trace_resumed.bin");
+}
+
+TEST_CASE("Metropolis Hastings trace keeps a bounded record of the chain","[Metropolis_Hastings][Trace]"){
+    MetropolisHastingSampler<double, 2> ring_sampler = power_law_mcmc_sampler(5000);
+    MetropolisHastingSampler<double, 2> fixed_sampler = power_law_mcmc_sampler(5000);
+    MetropolisHastingSampler<double, 2> full_sampler = power_law_mcmc_sampler(5000);
+    REQUIRE_THROWS_AS(ring_sampler.enable_trace(0), std::domain_error);
+    REQUIRE_THROWS_AS(ring_sampler.get_trace(), std::logic_error);
+    ring_sampler.enable_trace(1000);
+    fixed_sampler.enable_trace(1000, TraceMode::fixed);
+    full_sampler.enable_trace(5001);
+    ring_sampler.sample();
+    fixed_sampler.sample();
+    full_sampler.sample();
+
+    CHECK(ring_sampler.get_param_likelihood().empty());
+    CHECK(ring_sampler.get_marginal_distribution() == full_sampler.get_marginal_distribution());
+    const TraceBuffer<double, 2> &full_trace = full_sampler.get_trace();
+    const TraceBuffer<double, 2> &ring_trace = ring_sampler.get_trace();
+    const TraceBuffer<double, 2> &fixed_trace = fixed_sampler.get_trace();
+    REQUIRE(full_trace.size() == 5001); // the initial point and one per iteration
+    REQUIRE(ring_trace.size() == 1000);
+    REQUIRE(fixed_trace.size() == 1000);
+    CHECK(ring_trace.total_recorded() == 5001);
+    for (std::size_t i = 0; i < 1000; i++){
+        CHECK(ring_trace[i].params == full_trace[4001 + i].params);
+        CHECK(fixed_trace[i].params == full_trace[i].params);
+    }
+    for (std::size_t i = 0; i < full_trace.size(); i += 500){
+        std::array<double, 2> params = full_trace[i].params;
+        CHECK(full_trace[i].log_likelihood == full_sampler.log_likelihood(params));
+    }
+}
+
+TEST_CASE("Resumed grid scan matches an uninterrupted run","[Uniform_Sampler][Checkpoint]"){
+    std::array<std::string,2> names = {"a", "b"};
+    std::array<double, 2> min_vals = {0, 0};
+    std::array<double, 2> max_vals = {5, 5};
+    std::atomic<long> model_calls(0);
+    std::function<double(double, std::array<double, 2>&)> interrupting_model = [&](double x, std::array<double, 2> &params){
+        if (++model_calls == 100 * 100000){
+            request_checkpoint_stop();
+        }
+        return param_2_model_func<double>(x, params);
+    };
+    for (uint threads: {1u, 3u}){
+        UniformSampler<double, 2> uninterrupted_sampler("data/problem_data_2D.txt", param_2_model_func<double>, names, min_vals, max_vals, 600);
+        uninterrupted_sampler.set_num_threads(threads);
+        uninterrupted_sampler.enable_checkpoints("test_grid_checkpoint.bin", 0, 0); // never due, but the scan is still sampled in checkpoint blocks
+        uninterrupted_sampler.sample();
+
+        UniformSampler<double, 2> interrupted_sampler("data/problem_data_2D.txt", interrupting_model, names, min_vals, max_vals, 600);
+        interrupted_sampler.set_num_threads(threads);
+        interrupted_sampler.enable_checkpoints("test_grid_checkpoint.bin", 0, 50000); // several checkpoints each append to the likelihood journal
+        model_calls = 0;
+        REQUIRE_THROWS_AS(interrupted_sampler.sample(), SamplingInterrupted);
+        {
+            std::ofstream journal("test_grid_checkpoint.bin.likelihoods", std::ios::binary | std::ios::app);
+            journal << "entries of a checkpoint that never completed";
+        }
+
+        UniformSampler<double, 2> resumed_sampler("data/problem_data_2D.txt", param_2_model_func<double>, names, min_vals, max_vals, 600);
+        resumed_sampler.set_num_threads(threads);
+        resumed_sampler.enable_checkpoints("test_grid_checkpoint.bin", 0, 0);
+        resumed_sampler.sample();
+        CHECK(resumed_sampler.resumed_from_checkpoint());
+        CHECK(resumed_sampler.get_marginal_distribution() == uninterrupted_sampler.get_marginal_distribution());
+        CHECK(resumed_sampler.get_param_likelihood() == uninterrupted_sampler.get_param_likelihood());
+        CHECK_FALSE(std::filesystem::exists("test_grid_checkpoint.bin.likelihoods"));
+    }
+    UniformSampler<double, 2> plain_sampler("data/problem_data_2D.txt", param_2_model_func<double>, names, min_vals, max_vals, 600);
+    UniformSampler<double, 2> checkpointed_sampler("data/problem_data_2D.txt", param_2_model_func<double>, names, min_vals, max_vals, 600);
+    checkpointed_sampler.enable_checkpoints("test_grid_checkpoint.bin", 0, 0);
+    plain_sampler.sample();
+    checkpointed_sampler.sample();
+    CHECK(checkpointed_sampler.get_marginal_distribution() == plain_sampler.get_marginal_distribution()); // a single thread takes the same path with or without checkpoints
+
+    UniformSampler<double, 2> long_sampler("test/test_data/testing_data_2D.txt", param_2_model_func<double>, names, min_vals, max_vals, 1200);
+    long_sampler.sample();
+    std::function<double(double, std::array<double, 2>&)> twice_interrupting_model = [&](double x, std::array<double, 2> &params){
+        long calls = ++model_calls;
+        if (calls == 1500000 || calls == 3600000){
+            request_checkpoint_stop();
+        }
+        return param_2_model_func<double>(x, params);
+    };
+    model_calls = 0;
+    for (int run = 0; run < 3; run++){ // stopped twice, so the journal is appended to after a resume as well
+        UniformSampler<double, 2> journalled_sampler("test/test_data/testing_data_2D.txt", twice_interrupting_model, names, min_vals, max_vals, 1200);
+        journalled_sampler.enable_checkpoints("test_grid_checkpoint.bin", 0, 1); // a checkpoint after every block
+        if (run < 2){
+            REQUIRE_THROWS_AS(journalled_sampler.sample(), SamplingInterrupted);
+            continue;
+        }
+        UniformSampler<double, 2> other_model_sampler("test/test_data/testing_data_2D.txt", param_2_model_func<double>, names, min_vals, max_vals, 1200);
+        other_model_sampler.set_model_name("a*x^b + 1");
+        other_model_sampler.enable_checkpoints("test_grid_checkpoint.bin", 0, 1);
+        REQUIRE_THROWS_AS(other_model_sampler.sample(), std::runtime_error); // the checkpoint was written for another model
+        journalled_sampler.sample();
+        CHECK(journalled_sampler.get_param_likelihood() == long_sampler.get_param_likelihood());
+        CHECK(journalled_sampler.get_marginal_distribution() == long_sampler.get_marginal_distribution());
+    }
+}
+
+TEST_CASE("Multiple Metropolis Hastings chains converge and are reproducible","[Metropolis_Hastings][Chains]"){
+    std::array<std::string,2> names = {"a", "b"};
+    MetropolisHastingSampler<double, 2> single_sampler = power_law_mcmc_sampler(20000);
+    MetropolisHastingSampler<double, 2> chain_sampler = power_law_mcmc_sampler(20000);
+    MetropolisHastingSampler<double, 2> repeat_sampler = power_law_mcmc_sampler(20000);
+    REQUIRE_THROWS_AS(chain_sampler.set_num_chains(0), std::domain_error);
+    chain_sampler.set_num_chains(4);
+    repeat_sampler.set_num_chains(4);
+    single_sampler.sample();
+    chain_sampler.sample();
+    repeat_sampler.sample();
+    single_sampler.summarise(false);
+    chain_sampler.summarise(false);
+
+    CHECK(chain_sampler.get_marginal_distribution() == repeat_sampler.get_marginal_distribution());
+    CHECK(chain_sampler.get_marginal_distribution() != single_sampler.get_marginal_distribution());
+    for (std::size_t i = 0; i < 2; i++){
+        CHECK_FALSE(single_sampler.get_params_info()[i].r_hat.has_value());
+        REQUIRE(chain_sampler.get_params_info()[i].r_hat.has_value());
+        CHECK(chain_sampler.get_params_info()[i].r_hat.value() < 1.1);
+        CHECK_THAT(chain_sampler.get_params_info()[i].mean_parameter, WithinRel(single_sampler.get_params_info()[i].mean_parameter, 0.01));
+    }
+
+    std::function<double(double, std::array<double, 2>&)> rejecting_model = [](double, std::array<double, 2>&){ return std::numeric_limits<double>::quiet_NaN(); };
+    MetropolisHastingSampler<double, 2> stuck_sampler = power_law_mcmc_sampler(2000, rejecting_model);
+    stuck_sampler.set_num_chains(4); // every proposal is rejected, so each chain stays at its own starting point
+    stuck_sampler.sample();
+    stuck_sampler.summarise(false);
+    for (std::size_t i = 0; i < 2; i++){
+        REQUIRE(stuck_sampler.get_params_info()[i].r_hat.has_value());
+        CHECK(std::isinf(stuck_sampler.get_params_info()[i].r_hat.value()));
+    }
+    std::array<double, 2> point_vals = {2.5, 4.1};
+    MetropolisHastingSampler<double, 2> agreeing_sampler("data/problem_data_2D.txt", rejecting_model, names, point_vals, point_vals, 2000, 0.01, 50);
+    agreeing_sampler.set_num_chains(4); // every chain starts and stays at the one point of the range
+    agreeing_sampler.sample();
+    agreeing_sampler.summarise(false);
+    for (std::size_t i = 0; i < 2; i++){
+        REQUIRE(agreeing_sampler.get_params_info()[i].r_hat.has_value());
+        CHECK(agreeing_sampler.get_params_info()[i].r_hat.value() == 1);
+    }
+}
+
+TEST_CASE("Adaptive Metropolis proposal targets its acceptance rate","[Metropolis_Hastings][Adaptive]"){
+    MetropolisHastingSampler<double, 2> fixed_sampler = power_law_mcmc_sampler(20000);
+    MetropolisHastingSampler<double, 2> adaptive_sampler = power_law_mcmc_sampler(20000);
+    MetropolisHastingSampler<double, 2> repeat_sampler = power_law_mcmc_sampler(20000);
+    REQUIRE_THROWS_AS(adaptive_sampler.use_adaptive_proposal(0), std::domain_error);
+    adaptive_sampler.use_adaptive_proposal(10000);
+    repeat_sampler.use_adaptive_proposal(10000);
+    fixed_sampler.sample();
+    adaptive_sampler.sample();
+    repeat_sampler.sample();
+    fixed_sampler.summarise(false);
+    adaptive_sampler.summarise(false);
+
+    CHECK(adaptive_sampler.get_marginal_distribution() == repeat_sampler.get_marginal_distribution());
+    CHECK(adaptive_sampler.get_acceptance_rate() > 0.15);
+    CHECK(adaptive_sampler.get_acceptance_rate() < 0.35);
+    for (std::size_t i = 0; i < 2; i++){
+        CHECK_THAT(adaptive_sampler.get_params_info()[i].mean_parameter, WithinRel(fixed_sampler.get_params_info()[i].mean_parameter, 0.01));
+    }
+}
+
+TEST_CASE("Batch means diagnostics and early stopping on the effective sample size","[Metropolis_Hastings][Diagnostics]"){
+    Xoshiro256 generator(3);
+    NormalBlock<double> normals;
+    BatchMeans<double, 2> independent;
+    BatchMeans<double, 2> correlated;
+    double x = 0;
+    const int n = 1000000;
+    for (int k = 0; k < n; k++){
+        x = 0.9 * x + normals(generator); // AR(1) with integrated autocorrelation time (1 + 0.9) / (1 - 0.9) = 19
+        independent.add({normals(generator), normals(generator)});
+        correlated.add({x, 2 * x});
+    }
+    REQUIRE(correlated.ready());
+    for (std::size_t i = 0; i < 2; i++){
+        CHECK_THAT(independent.autocorrelation_times()[i], WithinRel(1.0, 0.25));
+        CHECK_THAT(correlated.autocorrelation_times()[i], WithinRel(19.0, 0.25));
+        CHECK_THAT(correlated.effective_sample_sizes()[i], WithinRel(n / 19.0, 0.25));
+    }
+    CHECK_THAT(correlated.standard_errors()[0], WithinRel(std::sqrt(19.0 / (1 - 0.81) / n), 0.25));
+    BatchMeans<double, 2> stuck; // a chain that never moves has not mixed, however long it is
+    for (int k = 0; k < 1000; k++){
+        stuck.add({1.5, 2.5});
+    }
+    CHECK(std::isinf(stuck.autocorrelation_times()[0]));
+    CHECK(stuck.effective_sample_sizes()[1] == 0);
+
+    MetropolisHastingSampler<double, 2> fixed_sampler = power_law_mcmc_sampler(200000);
+    MetropolisHastingSampler<double, 2> stopping_sampler = power_law_mcmc_sampler(1000000);
+    REQUIRE_THROWS_AS(stopping_sampler.stop_at_effective_sample_size(0), std::domain_error);
+    stopping_sampler.stop_at_effective_sample_size(500);
+    stopping_sampler.set_num_chains(2);
+    fixed_sampler.sample();
+    stopping_sampler.sample();
+    fixed_sampler.summarise(false);
+    stopping_sampler.summarise(false);
+
+    CHECK(fixed_sampler.get_num_iterations() == 200000);
+    CHECK(fixed_sampler.get_params_info()[0].effective_sample_size);
+    CHECK(stopping_sampler.get_num_iterations() < 2 * 1000000);
+    for (std::size_t i = 0; i < 2; i++){
+        CHECK(stopping_sampler.get_effective_sample_sizes()[i] >= 500);
+        CHECK(stopping_sampler.get_params_info()[i].effective_sample_size.value() == stopping_sampler.get_effective_sample_sizes()[i]);
+        CHECK(stopping_sampler.get_params_info()[i].r_hat.value() < 1.1);
+        CHECK_THAT(stopping_sampler.get_params_info()[i].mean_parameter, WithinRel(fixed_sampler.get_params_info()[i].mean_parameter, 0.01));
+    }
+}
+
+TEST_CASE("Delayed acceptance keeps the posterior and saves full evaluations","[Metropolis_Hastings][Delayed_Acceptance]"){
+    MetropolisHastingSampler<double, 2> plain_sampler = power_law_mcmc_sampler(20000);
+    MetropolisHastingSampler<double, 2> exact_screen_sampler = power_law_mcmc_sampler(20000);
+    MetropolisHastingSampler<double, 2> subset_sampler = power_law_mcmc_sampler(20000);
+    MetropolisHastingSampler<double, 2> oversized_sampler = power_law_mcmc_sampler(20000);
+    REQUIRE_THROWS_AS(subset_sampler.use_delayed_acceptance(0), std::domain_error);
+    oversized_sampler.use_delayed_acceptance(100);
+    REQUIRE_THROWS_AS(oversized_sampler.sample(), std::domain_error);
+    exact_screen_sampler.use_delayed_acceptance([&](std::array<double, 2> &params){
+        return plain_sampler.log_likelihood(params);
+    });
+    subset_sampler.use_delayed_acceptance(30);
+    plain_sampler.sample();
+    exact_screen_sampler.sample();
+    subset_sampler.sample();
+    plain_sampler.summarise(false);
+    subset_sampler.summarise(false);
+
+    // a screen equal to the full likelihood makes the same decisions as the plain chain, only ever evaluating the full likelihood for proposals that are accepted
+    CHECK(exact_screen_sampler.get_marginal_distribution() == plain_sampler.get_marginal_distribution());
+    CHECK(plain_sampler.get_num_full_evaluations() == 20000);
+    CHECK(plain_sampler.get_num_screened_out() == 0);
+    CHECK(exact_screen_sampler.get_num_full_evaluations() == static_cast<std::uint64_t>(std::llround(exact_screen_sampler.get_acceptance_rate() * 20000)));
+
+    CHECK(subset_sampler.get_num_screened_out() > 0);
+    CHECK(subset_sampler.get_num_full_evaluations() + subset_sampler.get_num_screened_out() == 20000);
+    for (std::size_t i = 0; i < 2; i++){
+        CHECK_THAT(subset_sampler.get_params_info()[i].mean_parameter, WithinRel(plain_sampler.get_params_info()[i].mean_parameter, 0.01));
+    }
+}
+
+TEST_CASE("Parallel tempering matches Metropolis Hastings and does not depend on the thread count","[Parallel_Tempering]"){
+    std::array<std::string,2> names = {"a", "b"};
+    std::array<double, 2> min_vals = {0, 0};
+    std::array<double, 2> max_vals = {5, 5};
+    REQUIRE_THROWS_AS((ParallelTemperingSampler<double, 2>("data/problem_data_2D.txt", param_2_model_func<double>, names, min_vals, max_vals, 20000, 0.01, 1)), std::domain_error);
+    REQUIRE_THROWS_AS((ParallelTemperingSampler<double, 2>("data/problem_data_2D.txt", param_2_model_func<double>, names, min_vals, max_vals, 20000, 0.01, 4, 1)), std::domain_error);
+    REQUIRE_THROWS_AS((ParallelTemperingSampler<double, 2>("data/problem_data_2D.txt", param_2_model_func<double>, names, min_vals, max_vals, 20000, 0.01, 4, 100, 0)), std::domain_error);
+    MetropolisHastingSampler<double, 2> mcmc_sampler = power_law_mcmc_sampler(20000);
+    ParallelTemperingSampler<double, 2> serial_sampler("data/problem_data_2D.txt", param_2_model_func<double>, names, min_vals, max_vals, 20000, 0.01, 4, 100, 100, 50);
+    ParallelTemperingSampler<double, 2> parallel_sampler("data/problem_data_2D.txt", param_2_model_func<double>, names, min_vals, max_vals, 20000, 0.01, 4, 100, 100, 50);
+    serial_sampler.set_num_threads(1);
+    CHECK(parallel_sampler.get_num_threads() == 4);
+    CHECK(parallel_sampler.get_temperatures().front() == 1);
+    CHECK_THAT(parallel_sampler.get_temperatures().back(), WithinRel(100.0, 1e-12));
+    mcmc_sampler.sample();
+    serial_sampler.sample();
+    parallel_sampler.sample();
+    mcmc_sampler.summarise(false);
+    parallel_sampler.summarise(false);
+
+    CHECK(parallel_sampler.get_marginal_distribution() == serial_sampler.get_marginal_distribution());
+    REQUIRE(parallel_sampler.get_swap_acceptance_rates().size() == 3);
+    for (double rate: parallel_sampler.get_swap_acceptance_rates()){
+        CHECK(rate > 0);
+        CHECK(rate < 1);
+    }
+    for (std::size_t i = 0; i < 2; i++){
+        CHECK_THAT(parallel_sampler.get_params_info()[i].mean_parameter, WithinRel(mcmc_sampler.get_params_info()[i].mean_parameter, 0.01));
+    }
+}
+
+TEST_CASE("Ensemble sampler matches Metropolis Hastings and does not depend on the thread count","[Ensemble]"){
+    std::array<std::string,2> names = {"a", "b"};
+    std::array<double, 2> min_vals = {0, 0};
+    std::array<double, 2> max_vals = {5, 5};
+    REQUIRE_THROWS_AS((EnsembleSampler<double, 2>("data/problem_data_2D.txt", param_2_model_func<double>, names, min_vals, max_vals, 20000, 3)), std::domain_error);
+    REQUIRE_THROWS_AS((EnsembleSampler<double, 2>("data/problem_data_2D.txt", param_2_model_func<double>, names, min_vals, max_vals, 20000, 2)), std::domain_error);
+    REQUIRE_THROWS_AS((EnsembleSampler<double, 2>("data/problem_data_2D.txt", param_2_model_func<double>, names, min_vals, max_vals, 20000, 16, 1)), std::domain_error);
+    MetropolisHastingSampler<double, 2> mcmc_sampler = power_law_mcmc_sampler(20000);
+    EnsembleSampler<double, 2> serial_sampler("data/problem_data_2D.txt", param_2_model_func<double>, names, min_vals, max_vals, 32000, 16, 2, 50);
+    EnsembleSampler<double, 2> parallel_sampler("data/problem_data_2D.txt", param_2_model_func<double>, names, min_vals, max_vals, 32000, 16, 2, 50);
+    parallel_sampler.set_num_threads(3);
+    mcmc_sampler.sample();
+    serial_sampler.sample();
+    parallel_sampler.sample();
+    mcmc_sampler.summarise(false);
+    parallel_sampler.summarise(false);
+
+    CHECK(parallel_sampler.get_marginal_distribution() == serial_sampler.get_marginal_distribution());
+    CHECK(parallel_sampler.get_acceptance_rate() > 0.2);
+    CHECK(parallel_sampler.get_acceptance_rate() < 0.9);
+    for (std::size_t i = 0; i < 2; i++){
+        CHECK_THAT(parallel_sampler.get_params_info()[i].mean_parameter, WithinRel(mcmc_sampler.get_params_info()[i].mean_parameter, 0.01));
+    }
+}
+
+TEST_CASE("Dual number gradient of the log likelihood matches finite differences","[Likelihood_Calc][Dual]"){
+    std::array<std::string,4> names = {"a", "b", "c", "d"};
+    std::array<double, 4> min_vals = {-3, -3, -3, -3};
+    std::array<double, 4> max_vals = {3, 3, 3, 3};
+    MetropolisHastingSampler<double, 4> sampler("data/problem_data_4D.txt", polynomial<double>, names, min_vals, max_vals);
+    std::array<double, 4> params = {0.5, -1.2, 0.3, 2.0};
+    std::array<double, 4> gradient;
+    REQUIRE_THROWS_AS(sampler.log_likelihood_gradient(params, gradient), std::logic_error);
+    sampler.set_gradient_model(polynomial<Dual<double, 4>>);
+    CHECK_THAT(sampler.log_likelihood_gradient(params, gradient), WithinRel(sampler.log_likelihood(params), 1e-12));
+    for (std::size_t i = 0; i < 4; i++){
+        std::array<double, 4> upper = params;
+        std::array<double, 4> lower = params;
+        upper[i] += 1e-6;
+        lower[i] -= 1e-6;
+        CHECK_THAT(gradient[i], WithinRel((sampler.log_likelihood(upper) - sampler.log_likelihood(lower)) / 2e-6, 1e-5));
+    }
+
+    Dual<double, 2> x(2.0);
+    std::array<Dual<double, 2>, 2> dual_params = {Dual<double, 2>::variable(1.5, 0), Dual<double, 2>::variable(3.0, 1)};
+    Dual<double, 2> output = param_2_model_func<Dual<double, 2>>(x, dual_params); // a x^b
+    CHECK_THAT(output.value, WithinRel(12.0, 1e-12));
+    CHECK_THAT(output.gradient[0], WithinRel(8.0, 1e-12));
+    CHECK_THAT(output.gradient[1], WithinRel(12.0 * std::log(2.0), 1e-12));
+}
+
+TEST_CASE("No-U-Turn Hamiltonian sampler matches the grid","[Hamiltonian]"){
+    std::array<std::string,2> names = {"a", "b"};
+    std::array<double, 2> min_vals = {0, 0};
+    std::array<double, 2> max_vals = {5, 5};
+    REQUIRE_THROWS_AS((HamiltonianSampler<double, 2>("data/problem_data_2D.txt", param_2_model_func<double>, names, min_vals, max_vals, 2000, 500, 1)), std::domain_error);
+    UniformSampler<double, 2> uniform_sampler("data/problem_data_2D.txt", param_2_model_func<double>, names, min_vals, max_vals, 200);
+    HamiltonianSampler<double, 2> hamiltonian_sampler("data/problem_data_2D.txt", param_2_model_func<double>, names, min_vals, max_vals, 2000, 500, 0.8, 10, 200);
+    REQUIRE_THROWS_AS(hamiltonian_sampler.sample(), std::logic_error);
+    hamiltonian_sampler.set_gradient_model(param_2_model_func<Dual<double, 2>>);
+    uniform_sampler.sample();
+    hamiltonian_sampler.sample();
+    uniform_sampler.summarise(false);
+    hamiltonian_sampler.summarise(false);
+
+    CHECK(hamiltonian_sampler.get_step_size() > 0);
+    CHECK(hamiltonian_sampler.get_num_gradient_evaluations() < 20000 * 10); // far fewer evaluations than the random walk needs
+    for (std::size_t i = 0; i < 2; i++){
+        CHECK_THAT(hamiltonian_sampler.get_params_info()[i].mean_parameter, WithinRel(uniform_sampler.get_params_info()[i].mean_parameter, 0.01));
+        CHECK_THAT(hamiltonian_sampler.get_params_info()[i].standard_deviation, WithinRel(uniform_sampler.get_params_info()[i].standard_deviation, 0.15));
+    }
+}
+
+TEST_CASE("Xoshiro generator streams and normal blocks","[Random]"){
+    Xoshiro256 raw({1, 2, 3, 4});
+    CHECK(raw() == 41943041); // rotl(1 + 4, 23) + 1, the first xoshiro256++ output from this state
+
+    Xoshiro256 first(42);
+    Xoshiro256 second(42);
+    for (int k = 0; k < 100; k++){
+        REQUIRE(first() == second());
+    }
+    Xoshiro256 jumped(42);
+    jumped.jump();
+    CHECK(Xoshiro256::stream(42, 0) == Xoshiro256(42));
+    CHECK(Xoshiro256::stream(42, 1) == jumped);
+    CHECK(Xoshiro256::stream(42, 1) != Xoshiro256::stream(42, 2));
+    CHECK(Xoshiro256::stream(42, 1) != Xoshiro256(43));
+    std::vector<Xoshiro256> streams = Xoshiro256::streams(42, 4);
+    REQUIRE(streams.size() == 4);
+    for (std::uint64_t k = 0; k < 4; k++){
+        CHECK(streams[k] == Xoshiro256::stream(42, k));
+    }
+
+    Xoshiro256 generator(7);
+    NormalBlock<double> normals;
+    double sum = 0;
+    double sum_squares = 0;
+    double uniform_sum = 0;
+    const int n = 1000000;
+    for (int k = 0; k < n; k++){
+        double x = normals(generator);
+        sum += x;
+        sum_squares += x * x;
+        double u = unit_uniform<double>(generator);
+        REQUIRE(u >= 0);
+        REQUIRE(u < 1);
+        uniform_sum += u;
+    }
+    CHECK_THAT(sum / n, WithinAbs(0, 0.005));
+    CHECK_THAT(sum_squares / n, WithinAbs(1, 0.005));
+    CHECK_THAT(uniform_sum / n, WithinAbs(0.5, 0.002));
+
+    Xoshiro256 saved_generator = generator; // a copy of the generator and block carries on identically, as a restored checkpoint does
+    NormalBlock<double> saved_normals = normals;
+    for (int k = 0; k < 1000; k++){
+        REQUIRE(normals(generator) == saved_normals(saved_generator));
+    }
+}
+
+TEST_CASE("Nested sampling evidence and posterior match the grid","[Nested]"){
+    std::array<std::string,2> names = {"a", "b"};
+    std::array<double, 2> min_vals = {0, 0};
+    std::array<double, 2> max_vals = {5, 5};
+    UniformSampler<double, 2> uniform_sampler("data/problem_data_2D.txt", param_2_model_func<double>, names, min_vals, max_vals, 200);
+    NestedSampler<double, 2> nested_sampler("data/problem_data_2D.txt", param_2_model_func<double>, names, min_vals, max_vals, 500, 0.01, 1000000, 200);
+    NestedSampler<double, 2> batch_sampler("data/problem_data_2D.txt", param_2_model_func<double>, names, min_vals, max_vals, 500, 0.01, 1000000, 200);
+    NestedSampler<double, 2> threaded_batch_sampler("data/problem_data_2D.txt", param_2_model_func<double>, names, min_vals, max_vals, 500, 0.01, 1000000, 200);
+    REQUIRE_THROWS_AS(batch_sampler.set_batch_size(251), std::domain_error);
+    batch_sampler.set_batch_size(8);
+    threaded_batch_sampler.set_batch_size(8);
+    threaded_batch_sampler.set_num_threads(4);
+    uniform_sampler.sample();
+    nested_sampler.sample();
+    batch_sampler.sample();
+    threaded_batch_sampler.sample();
+    uniform_sampler.summarise(false);
+    nested_sampler.summarise(false);
+
+    // evidence of the uniform prior over the box by a fine grid, Z = mean of L over the box
+    const int grid_points = 1000;
+    std::vector<double> grid_log_likelihoods;
+    for (int i = 0; i < grid_points; i++){
+        for (int j = 0; j < grid_points; j++){
+            std::array<double, 2> params = {5.0 * (i + 0.5) / grid_points, 5.0 * (j + 0.5) / grid_points};
+            grid_log_likelihoods.push_back(uniform_sampler.log_likelihood(params));
+        }
+    }
+    double max_log_likelihood = *std::max_element(grid_log_likelihoods.begin(), grid_log_likelihoods.end());
+    double grid_sum = 0;
+    for (double log_likelihood: grid_log_likelihoods){
+        grid_sum += std::exp(log_likelihood - max_log_likelihood);
+    }
+    double grid_log_evidence = max_log_likelihood + std::log(grid_sum / grid_log_likelihoods.size());
+
+    CHECK(nested_sampler.get_log_evidence_error() > 0);
+    CHECK(std::abs(nested_sampler.get_log_evidence() - grid_log_evidence) < 3 * nested_sampler.get_log_evidence_error());
+    CHECK(std::abs(batch_sampler.get_log_evidence() - grid_log_evidence) < 3 * batch_sampler.get_log_evidence_error());
+    CHECK(batch_sampler.get_marginal_distribution() == threaded_batch_sampler.get_marginal_distribution());
+    double total_weight = 0;
+    for (const auto &sample: nested_sampler.get_posterior_samples()){
+        total_weight += sample.posterior_weight;
+    }
+    CHECK_THAT(total_weight, WithinAbs(1, 1e-9));
+    for (std::size_t i = 0; i < 2; i++){
+        CHECK_THAT(nested_sampler.get_params_info()[i].mean_parameter, WithinRel(uniform_sampler.get_params_info()[i].mean_parameter, 0.01));
+        CHECK_THAT(nested_sampler.get_params_info()[i].standard_deviation, WithinRel(uniform_sampler.get_params_info()[i].standard_deviation, 0.15));
+    }
+}
+
+TEST_CASE("Minibatch likelihood with control variates matches the Laplace posterior","[Metropolis_Hastings][Minibatch]"){
+    std::array<std::string,2> names = {"a", "b"};
+    std::array<double, 2> min_vals = {1, 2};
+    std::array<double, 2> max_vals = {2, 3};
+    const int num_rows = 100000;
+    {
+        std::ofstream data_file("test_minibatch_data.txt");
+        Xoshiro256 generator(7);
+        data_file.precision(17);
+        for (int i = 0; i < num_rows; i++){
+            double x = 0.5 + 1.5 * unit_uniform<double>(generator);
+            data_file << x << " " << 1.5 * std::pow(x, 2.3) + 0.5 * ziggurat_normal<double>(generator) << " " << 0.5 << "\n";
+        }
+    }
+    long model_calls = 0;
+    std::function<double(double, std::array<double, 2>&)> counting_model = [&](double x, std::array<double, 2> &params){
+        model_calls++;
+        return param_2_model_func<double>(x, params);
+    };
+    MetropolisHastingSampler<double, 2> sampler("test_minibatch_data.txt", counting_model, names, min_vals, max_vals, 60000, 0.0005, 50);
+    REQUIRE_THROWS_AS(sampler.use_minibatch_likelihood(1), std::domain_error);
+    sampler.use_minibatch_likelihood(num_rows);
+    REQUIRE_THROWS_AS(sampler.sample(), std::logic_error); // no gradient model
+    sampler.set_gradient_model(param_2_model_func<Dual<double, 2>>);
+    REQUIRE_THROWS_AS(sampler.sample(), std::domain_error);
+    sampler.use_minibatch_likelihood(100);
+    sampler.use_adaptive_proposal(5000);
+    sampler.set_burn_in(5000);
+    sampler.enable_trace(60000);
+    sampler.sample();
+    CHECK(model_calls == 2 * 100 * 60000); // two model evaluations per minibatch row, none over the full data
+    CHECK(sampler.get_num_full_evaluations() == 0);
+    CHECK(sampler.get_minibatch_variance() > 0);
+    CHECK(sampler.get_minibatch_variance() < 1);
+
+    // Laplace approximation of the posterior around the least squares fit, with the Gauss-Newton curvature of chi^2 / 2
+    std::array<double, 2> mode = sampler.get_minibatch_reference();
+    Observations<double> observations;
+    observations.loadData("test_minibatch_data.txt");
+    double faa = 0, fab = 0, fbb = 0;
+    for (uint i = 0; i < observations.num_points; i++){
+        double power = std::pow(observations.inputs[i], mode[1]);
+        double da = power / observations.sigmas[i];
+        double db = mode[0] * power * std::log(observations.inputs[i]) / observations.sigmas[i];
+        faa += da * da;
+        fab += da * db;
+        fbb += db * db;
+    }
+    double determinant = faa * fbb - fab * fab;
+    std::array<double, 2> laplace_sds = {std::sqrt(fbb / determinant), std::sqrt(faa / determinant)};
+    CHECK(std::abs(mode[0] - 1.5) < 5 * laplace_sds[0]);
+    CHECK(std::abs(mode[1] - 2.3) < 5 * laplace_sds[1]);
+
+    const TraceBuffer<double, 2> &trace = sampler.get_trace();
+    std::array<double, 2> standard_errors = sampler.get_standard_errors();
+    for (std::size_t i = 0; i < 2; i++){
+        double mean = 0;
+        for (std::size_t k = 0; k < trace.size(); k++){
+            mean += trace[k].params[i] / trace.size();
+        }
+        double variance = 0;
+        for (std::size_t k = 0; k < trace.size(); k++){
+            variance += (trace[k].params[i] - mean) * (trace[k].params[i] - mean) / (trace.size() - 1);
+        }
+        CHECK(std::abs(mean - mode[i]) < 4 * standard_errors[i]);
+        CHECK_THAT(std::sqrt(variance), WithinRel(laplace_sds[i], 0.1));
+    }
+    std::filesystem::remove("test_minibatch_data.txt");
+}
+
 TEST_CASE("TEST PLOTTING","[Plotting]"){
     std::array<std::string,2> names = {"a", "b"};
     std::array<double, 2> min_vals = {1.9, 3.1};